@@ -0,0 +1,128 @@
+#include <MatrixMerchant/Core>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Compares NumberFormatter against the iostream path that the Writer used
+// before and checks that every formatted value reads back exactly.
+//
+// Usage: bench_format [count]
+
+using Clock = std::chrono::steady_clock;
+
+static double
+Seconds(
+    const Clock::time_point& begin,
+    const Clock::time_point& end)
+{
+    return std::chrono::duration<double>(end - begin).count();
+}
+
+int
+main(
+    int argc,
+    char* argv[])
+{
+    const std::size_t count = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) :
+        100000000;
+
+    // values are generated and formatted in batches to bound the memory
+
+    const std::size_t batchSize = 1 << 20;
+
+    std::mt19937_64 random(0);
+    std::uniform_real_distribution<double> distribution(-10.0, 10.0);
+
+    std::vector<double> values(batchSize);
+
+    double timeStream = 0;
+    double timeFormatter = 0;
+
+    std::size_t bytesStream = 0;
+    std::size_t bytesFormatter = 0;
+
+    std::size_t mismatches = 0;
+
+    std::ostringstream stream;
+    stream << std::setprecision(std::numeric_limits<double>::digits10 + 2);
+
+    std::string buffer(batchSize * MatrixMerchant::NumberFormatter::MaxLength,
+        '\0');
+
+    for (std::size_t offset = 0; offset < count; offset += batchSize) {
+        const std::size_t batch = std::min(batchSize, count - offset);
+
+        for (std::size_t i = 0; i < batch; i++) {
+            values[i] = distribution(random);
+        }
+
+        // --- iostream
+
+        stream.str("");
+
+        Clock::time_point begin = Clock::now();
+
+        for (std::size_t i = 0; i < batch; i++) {
+            stream << values[i] << "\n";
+        }
+
+        timeStream += Seconds(begin, Clock::now());
+
+        bytesStream += std::size_t(stream.tellp());
+
+        // --- NumberFormatter
+
+        begin = Clock::now();
+
+        char* pos = &buffer[0];
+
+        for (std::size_t i = 0; i < batch; i++) {
+            pos = MatrixMerchant::NumberFormatter::Format(pos, values[i]);
+            *pos++ = '\n';
+        }
+
+        timeFormatter += Seconds(begin, Clock::now());
+
+        bytesFormatter += pos - buffer.data();
+
+        // --- round trip
+
+        const char* line = buffer.data();
+
+        for (std::size_t i = 0; i < batch; i++) {
+            double value;
+
+            const char* end = MatrixMerchant::NumberParser::Parse(line, pos,
+                value);
+
+            if (value != values[i]) {
+                mismatches += 1;
+            }
+
+            line = end + 1;
+        }
+    }
+
+    std::printf("values:          %zu\n", count);
+    std::printf("iostream:        %8.3f s  %8.1f MB\n", timeStream,
+        bytesStream / 1e6);
+    std::printf("NumberFormatter: %8.3f s  %8.1f MB\n", timeFormatter,
+        bytesFormatter / 1e6);
+    std::printf("speedup:         %8.2fx\n", timeStream / timeFormatter);
+
+    if (mismatches != 0) {
+        std::printf("error: %zu values do not read back exactly\n",
+            mismatches);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,101 @@
+#include <MatrixMerchant/Core>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+// Compares NumberParser against the strtod path that TryParse used before.
+//
+// Usage: bench_parse [count]
+
+using Clock = std::chrono::steady_clock;
+
+static double
+Seconds(
+    const Clock::time_point& begin,
+    const Clock::time_point& end)
+{
+    return std::chrono::duration<double>(end - begin).count();
+}
+
+int
+main(
+    int argc,
+    char* argv[])
+{
+    const std::size_t count = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) :
+        10000000;
+
+    // --- generate values in the format written by the Writer
+
+    std::mt19937_64 random(0);
+    std::uniform_real_distribution<double> distribution(-10.0, 10.0);
+
+    std::string text;
+    std::vector<std::size_t> offsets;
+
+    offsets.reserve(count + 1);
+
+    char buffer[64];
+
+    for (std::size_t i = 0; i < count; i++) {
+        const int length = std::snprintf(buffer, sizeof(buffer), "%.16E",
+            distribution(random));
+
+        offsets.push_back(text.size());
+
+        text.append(buffer, length);
+        text += '\n';
+    }
+
+    offsets.push_back(text.size());
+
+    const std::size_t bytes = text.size();
+
+    // --- strtod
+
+    double sumStrtod = 0;
+
+    Clock::time_point begin = Clock::now();
+
+    for (std::size_t i = 0; i < count; i++) {
+        sumStrtod += std::strtod(text.c_str() + offsets[i], nullptr);
+    }
+
+    const double timeStrtod = Seconds(begin, Clock::now());
+
+    // --- NumberParser
+
+    double sumParser = 0;
+
+    begin = Clock::now();
+
+    for (std::size_t i = 0; i < count; i++) {
+        double value;
+
+        MatrixMerchant::NumberParser::Parse(text.data() + offsets[i],
+            text.data() + offsets[i + 1] - 1, value);
+
+        sumParser += value;
+    }
+
+    const double timeParser = Seconds(begin, Clock::now());
+
+    std::printf("values:       %zu (%.1f MB)\n", count, bytes / 1e6);
+    std::printf("strtod:       %8.3f s  %8.1f MB/s\n", timeStrtod,
+        bytes / 1e6 / timeStrtod);
+    std::printf("NumberParser: %8.3f s  %8.1f MB/s\n", timeParser,
+        bytes / 1e6 / timeParser);
+    std::printf("speedup:      %8.2fx\n", timeStrtod / timeParser);
+
+    if (sumStrtod != sumParser) {
+        std::printf("error: results differ\n");
+        return 1;
+    }
+
+    return 0;
+}
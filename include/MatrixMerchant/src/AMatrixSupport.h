@@ -28,6 +28,7 @@ struct MatrixBuilder<AMatrix::Matrix<TScalar, AMatrix::dynamic, AMatrix::dynamic
         const std::size_t& nonZeros)
     {
         m_matrix.resize(rows, cols);
+        m_matrix.setZero();
     }
 
     void
@@ -48,6 +49,13 @@ struct MatrixBuilder<AMatrix::Matrix<TScalar, AMatrix::dynamic, AMatrix::dynamic
     {
     }
 
+    void
+    MirrorTriangle(
+        const Symmetry symmetry)
+    {
+        MirrorLowerTriangle(m_matrix, m_matrix.size1(), symmetry);
+    }
+
     void
     SetValue(
         const std::size_t& row,
@@ -0,0 +1,250 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MappedFile.h"
+#include "OutputSink.h"
+
+namespace MatrixMerchant {
+
+// Identifies the version of a file that a sidecar was created from: its
+// size, its modification time in nanoseconds and a hash of its first and
+// last SampleSize bytes. The content is only sampled, so checking a sidecar
+// costs the same for any file size.
+struct SourceStamp
+{
+    static const std::size_t SampleSize = 64 << 10;
+
+    std::uint64_t size;
+    std::int64_t seconds;
+    std::int64_t nanoseconds;
+    std::uint64_t hash;
+
+    bool
+    operator==(
+        const SourceStamp& other) const
+    {
+        return size == other.size && seconds == other.seconds &&
+            nanoseconds == other.nanoseconds && hash == other.hash;
+    }
+
+    bool
+    operator!=(
+        const SourceStamp& other) const
+    {
+        return !(*this == other);
+    }
+};
+
+// Binary sidecar holding a matrix that has already been read from a text
+// file. Sparse matrices are stored in compressed row storage:
+//
+//   CacheHeader
+//   row offsets     std::uint64_t[rows + 1]
+//   column indices  std::uint32_t or std::uint64_t[nonZeros]
+//   values          scalar[nonZeros]
+//
+// Dense matrices store the values of all entries in column-major order
+// after the header. Every section starts at a multiple of 8 bytes. The
+// header identifies the source file by its SourceStamp, and the cache is
+// only used if it matches.
+struct CacheHeader
+{
+    static const std::uint32_t CurrentVersion = 2;
+    static const std::uint32_t ByteOrder = 0x01020304;
+
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byteOrder;
+
+    SourceStamp source;
+
+    // scalar type of the builder that wrote the cache
+    std::uint32_t scalarKind;
+    std::uint32_t scalarSize;
+
+    std::uint32_t sparse;
+    std::uint32_t indexSize;
+
+    std::uint64_t rows;
+    std::uint64_t cols;
+    std::uint64_t nonZeros;
+
+    CacheHeader()
+    {
+        std::memset(this, 0, sizeof(CacheHeader));
+        std::memcpy(magic, "MMCACHE", 8);
+
+        version = CurrentVersion;
+        byteOrder = ByteOrder;
+    }
+
+    bool
+    IsValid() const
+    {
+        return std::memcmp(magic, "MMCACHE", 8) == 0 &&
+            version == CurrentVersion && byteOrder == ByteOrder;
+    }
+};
+
+// A contiguous part of the cache file
+struct CacheSection
+{
+    const void* data;
+    std::size_t size;
+};
+
+static inline std::size_t
+CacheAlign(
+    const std::size_t size)
+{
+    return (size + 7) & ~std::size_t(7);
+}
+
+static inline std::string
+CachePath(
+    const std::string& filename)
+{
+    return filename + ".cache";
+}
+
+// Fast non-cryptographic 64-bit hash. Four independent lanes of 8-byte
+// words keep the multiplier busy, so hashing runs at memory speed.
+static inline std::uint64_t
+HashBytes(
+    const char* data,
+    const std::size_t size)
+{
+    const std::uint64_t prime = 0x9E3779B97F4A7C15ull;
+
+    std::uint64_t lanes[4] = {size, size ^ prime, ~size, size * prime};
+
+    std::size_t i = 0;
+
+    for (; i + 32 <= size; i += 32) {
+        for (int lane = 0; lane < 4; lane++) {
+            std::uint64_t word;
+
+            std::memcpy(&word, data + i + 8 * lane, 8);
+
+            lanes[lane] = (lanes[lane] ^ word) * prime;
+            lanes[lane] ^= lanes[lane] >> 29;
+        }
+    }
+
+    for (; i < size; i++) {
+        lanes[0] = (lanes[0] ^ std::uint8_t(data[i])) * prime;
+    }
+
+    std::uint64_t hash = 0;
+
+    for (int lane = 0; lane < 4; lane++) {
+        hash = (hash ^ lanes[lane]) * prime;
+        hash ^= hash >> 32;
+    }
+
+    return hash;
+}
+
+// Returns false if the file is not a regular file or its modification time
+// is not available
+static inline bool
+GetSourceStamp(
+    const std::string& filename,
+    SourceStamp& stamp)
+{
+#ifdef MATRIXMERCHANT_HAS_MMAP
+    struct stat info;
+
+    if (::stat(filename.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) {
+        return false;
+    }
+
+    stamp.size = std::uint64_t(info.st_size);
+    stamp.seconds = std::int64_t(info.st_mtime);
+#ifdef __APPLE__
+    stamp.nanoseconds = std::int64_t(info.st_mtimespec.tv_nsec);
+#else
+    stamp.nanoseconds = std::int64_t(info.st_mtim.tv_nsec);
+#endif
+
+    std::ifstream file(filename.c_str(), std::ios::binary);
+
+    const std::uint64_t limit = SourceStamp::SampleSize;
+    const std::size_t sampleSize = std::size_t(std::min(stamp.size, limit));
+
+    std::vector<char> sample(2 * sampleSize);
+
+    if (!file.read(sample.data(), sampleSize) ||
+        !file.seekg(std::streamoff(stamp.size - sampleSize)) ||
+        !file.read(sample.data() + sampleSize, sampleSize)) {
+        return false;
+    }
+
+    stamp.hash = HashBytes(sample.data(), sample.size());
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Writes sections to a temporary file that is renamed to the final path
+// once complete, so concurrent readers never see a partial file. Failures
+// are ignored: sidecar files are only an optimization.
+static inline bool
+WriteSidecarFile(
+    const std::string& path,
+    const std::vector<CacheSection>& sections)
+{
+    std::string temporary = path + ".tmp" + std::to_string(
+        std::hash<std::thread::id>()(std::this_thread::get_id()));
+
+#ifdef MATRIXMERCHANT_HAS_POSIX_WRITE
+    temporary += "." + std::to_string(::getpid());
+#endif
+
+    try {
+        FileTarget target(temporary);
+
+        const char padding[8] = {};
+
+        for (const CacheSection& section : sections) {
+            target.Write(static_cast<const char*>(section.data), section.size);
+            target.Write(padding, CacheAlign(section.size) - section.size);
+        }
+
+        target.Close();
+    } catch (...) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+static inline bool
+WriteCacheFile(
+    const std::string& path,
+    const CacheHeader& header,
+    std::vector<CacheSection> sections)
+{
+    sections.insert(sections.begin(), {&header, sizeof(header)});
+
+    return WriteSidecarFile(path, sections);
+}
+
+} // namespace MatrixMerchant
@@ -0,0 +1,616 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "MatrixMerchant.h"
+
+namespace MatrixMerchant {
+
+// Native binary format that can be used in place without parsing:
+//
+//   BinaryHeader       padded to BinaryHeader::Size bytes
+//   outer indices      index[outerSize + 1]     (sparse only)
+//   inner indices      index[nonZeros]          (sparse only)
+//   values             scalar[nonZeros] or scalar[rows * cols]
+//
+// Sparse matrices are stored in compressed column or compressed row storage
+// with signed 32-bit or 64-bit indices, dense matrices in column-major
+// order. Every array starts at a multiple of BinaryHeader::Alignment bytes,
+// so a mapping of the file can be used directly by SIMD code.
+struct BinaryHeader
+{
+    static const std::size_t Size = 128;
+    static const std::size_t Alignment = 64;
+
+    static const std::uint32_t CurrentVersion = 1;
+    static const std::uint32_t ByteOrder = 0x01020304;
+
+    enum Storage : std::uint32_t
+    {
+        Dense = 0,
+        CompressedColumn = 1,
+        CompressedRow = 2
+    };
+
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byteOrder;
+
+    std::uint32_t storage;
+    std::uint32_t indexSize;
+    std::uint32_t scalarKind;
+    std::uint32_t scalarSize;
+
+    std::uint64_t rows;
+    std::uint64_t cols;
+    std::uint64_t nonZeros;
+
+    // byte offsets of the arrays from the beginning of the file
+    std::uint64_t outerOffset;
+    std::uint64_t innerOffset;
+    std::uint64_t valueOffset;
+
+    BinaryHeader()
+    {
+        std::memset(this, 0, sizeof(BinaryHeader));
+        std::memcpy(magic, "MMBINARY", 8);
+
+        version = CurrentVersion;
+        byteOrder = ByteOrder;
+    }
+
+    bool
+    IsSparse() const
+    {
+        return storage != Dense;
+    }
+
+    std::uint64_t
+    OuterSize() const
+    {
+        return storage == CompressedRow ? rows : cols;
+    }
+};
+
+static inline std::uint64_t
+BinaryAlign(
+    const std::uint64_t offset)
+{
+    return (offset + BinaryHeader::Alignment - 1) &
+        ~std::uint64_t(BinaryHeader::Alignment - 1);
+}
+
+// Read-only mapping of a binary file. The arrays point directly into the
+// mapping and stay valid as long as the BinaryFile exists. Processes mapping
+// the same file share its pages.
+class BinaryFile
+{
+private:
+    MappedFile m_mapping;
+    BinaryHeader m_header;
+
+    static void
+    CheckArray(
+        const std::uint64_t offset,
+        const std::uint64_t count,
+        const std::size_t size,
+        const std::size_t fileSize)
+    {
+        if (offset % BinaryHeader::Alignment != 0 || offset > fileSize ||
+            count > (fileSize - offset) / size) {
+            throw std::runtime_error("Invalid binary file");
+        }
+    }
+
+public:
+    BinaryFile(
+        const std::string& path)
+        : m_mapping(path)
+    {
+        if (!m_mapping.IsMapped() ||
+            m_mapping.Size() < BinaryHeader::Size) {
+            throw std::runtime_error("Invalid binary file");
+        }
+
+        std::memcpy(&m_header, m_mapping.Data(), sizeof(BinaryHeader));
+
+        if (std::memcmp(m_header.magic, "MMBINARY", 8) != 0 ||
+            m_header.version != BinaryHeader::CurrentVersion ||
+            m_header.byteOrder != BinaryHeader::ByteOrder ||
+            m_header.storage > BinaryHeader::CompressedRow ||
+            m_header.scalarSize == 0) {
+            throw std::runtime_error("Invalid binary file");
+        }
+
+        const std::size_t size = m_mapping.Size();
+
+        if (m_header.IsSparse()) {
+            if (m_header.indexSize != 4 && m_header.indexSize != 8) {
+                throw std::runtime_error("Invalid binary file");
+            }
+
+            CheckArray(m_header.outerOffset, m_header.OuterSize() + 1,
+                m_header.indexSize, size);
+            CheckArray(m_header.innerOffset, m_header.nonZeros,
+                m_header.indexSize, size);
+            CheckArray(m_header.valueOffset, m_header.nonZeros,
+                m_header.scalarSize, size);
+        } else {
+            if (m_header.cols != 0 &&
+                m_header.rows > (size / m_header.scalarSize) / m_header.cols) {
+                throw std::runtime_error("Invalid binary file");
+            }
+
+            CheckArray(m_header.valueOffset, m_header.rows * m_header.cols,
+                m_header.scalarSize, size);
+        }
+    }
+
+    const BinaryHeader&
+    Header() const
+    {
+        return m_header;
+    }
+
+    std::size_t
+    Rows() const
+    {
+        return m_header.rows;
+    }
+
+    std::size_t
+    Cols() const
+    {
+        return m_header.cols;
+    }
+
+    std::size_t
+    NonZeros() const
+    {
+        return m_header.IsSparse() ? m_header.nonZeros :
+            m_header.rows * m_header.cols;
+    }
+
+    bool
+    IsSparse() const
+    {
+        return m_header.IsSparse();
+    }
+
+    bool
+    IsRowMajor() const
+    {
+        return m_header.storage == BinaryHeader::CompressedRow;
+    }
+
+    template <typename TIndex>
+    const TIndex*
+    OuterIndices() const
+    {
+        CheckIndexType<TIndex>();
+
+        return reinterpret_cast<const TIndex*>(m_mapping.Data() +
+            m_header.outerOffset);
+    }
+
+    template <typename TIndex>
+    const TIndex*
+    InnerIndices() const
+    {
+        CheckIndexType<TIndex>();
+
+        return reinterpret_cast<const TIndex*>(m_mapping.Data() +
+            m_header.innerOffset);
+    }
+
+    template <typename TScalar>
+    const TScalar*
+    Values() const
+    {
+        if (m_header.scalarKind != ScalarKind<TScalar>() ||
+            m_header.scalarSize != sizeof(TScalar)) {
+            throw std::runtime_error("Binary file has another scalar type");
+        }
+
+        return reinterpret_cast<const TScalar*>(m_mapping.Data() +
+            m_header.valueOffset);
+    }
+
+    template <typename TIndex>
+    void
+    CheckIndexType() const
+    {
+        if (!m_header.IsSparse() || m_header.indexSize != sizeof(TIndex)) {
+            throw std::runtime_error("Binary file has another index type");
+        }
+    }
+
+    // Checks that the outer indices start at 0, do not decrease and end at
+    // the number of entries, and that all inner indices are in range. The
+    // constructor only checks the sizes of the sections, so the indices
+    // have to be checked before they are followed.
+    template <typename TIndex>
+    void
+    CheckIndices() const
+    {
+        const TIndex* outer = OuterIndices<TIndex>();
+        const TIndex* inner = InnerIndices<TIndex>();
+
+        const std::uint64_t innerSize = IsRowMajor() ? m_header.cols :
+            m_header.rows;
+
+        if (outer[0] != 0 ||
+            std::uint64_t(outer[m_header.OuterSize()]) != m_header.nonZeros) {
+            throw std::runtime_error("Invalid binary file");
+        }
+
+        for (std::size_t i = 0; i < m_header.OuterSize(); i++) {
+            if (outer[i] > outer[i + 1]) {
+                throw std::runtime_error("Invalid binary file");
+            }
+        }
+
+        for (std::size_t j = 0; j < m_header.nonZeros; j++) {
+            if (inner[j] < 0 || std::uint64_t(inner[j]) >= innerSize) {
+                throw std::runtime_error("Invalid binary file");
+            }
+        }
+    }
+}; // class BinaryFile
+
+struct BinaryOptions
+{
+    // Store sparse matrices in compressed row instead of compressed column
+    // storage
+    bool rowMajor;
+
+    // Size of the indices in bytes: 4, 8 or 0 to use 32-bit indices if the
+    // matrix allows it
+    std::size_t indexSize;
+
+    BinaryOptions()
+        : rowMajor(false)
+        , indexSize(0)
+    {
+    }
+};
+
+class BinaryWriter
+{
+private:
+    // Sorts the stored entries into compressed storage with the requested
+    // orientation, independent of the storage order of the matrix
+    template <typename TMatrix, typename TIndex>
+    static void
+    WriteSparse(
+        const TMatrix& matrix,
+        FileTarget& target,
+        BinaryHeader header)
+    {
+        using Builder = MatrixBuilder<TMatrix>;
+        using ScalarType = typename Builder::ScalarType;
+
+        const bool rowMajor = (header.storage == BinaryHeader::CompressedRow);
+
+        const std::size_t matrixOuterSize = Builder::OuterSize(matrix);
+        const std::size_t outerSize = header.OuterSize();
+
+        std::vector<TIndex> outer(outerSize + 1, 0);
+
+        Builder::ForEachNonZero(matrix, 0, matrixOuterSize,
+            [&](const std::size_t row, const std::size_t col,
+                const ScalarType& /*value*/) {
+                outer[(rowMajor ? row : col) + 1] += 1;
+            });
+
+        for (std::size_t i = 0; i < outerSize; i++) {
+            outer[i + 1] += outer[i];
+        }
+
+        header.nonZeros = outer[outerSize];
+
+        std::vector<TIndex> inner(header.nonZeros);
+        std::vector<char> values(header.nonZeros * sizeof(ScalarType));
+
+        std::vector<TIndex> next(outer.begin(), outer.end() - 1);
+
+        Builder::ForEachNonZero(matrix, 0, matrixOuterSize,
+            [&](const std::size_t row, const std::size_t col,
+                const ScalarType& value) {
+                const std::size_t i = next[rowMajor ? row : col]++;
+
+                inner[i] = TIndex(rowMajor ? col : row);
+
+                std::memcpy(&values[i * sizeof(ScalarType)], &value,
+                    sizeof(ScalarType));
+            });
+
+        header.outerOffset = BinaryHeader::Size;
+        header.innerOffset = BinaryAlign(header.outerOffset + outer.size() *
+            sizeof(TIndex));
+        header.valueOffset = BinaryAlign(header.innerOffset + inner.size() *
+            sizeof(TIndex));
+
+        WriteHeader(target, header);
+        WritePadded(target, outer.data(), outer.size() * sizeof(TIndex));
+        WritePadded(target, inner.data(), inner.size() * sizeof(TIndex));
+        WritePadded(target, values.data(), values.size());
+    }
+
+    template <typename TMatrix>
+    static void
+    Write(
+        const TMatrix& matrix,
+        FileTarget& target,
+        BinaryHeader& header,
+        const BinaryOptions& options,
+        std::true_type)
+    {
+        header.storage = options.rowMajor ? BinaryHeader::CompressedRow :
+            BinaryHeader::CompressedColumn;
+
+        // the counts and offsets must fit as well, so the number of stored
+        // entries bounds the index size
+
+        const std::size_t largest = std::max(std::max(header.rows,
+            header.cols), std::uint64_t(MatrixBuilder<TMatrix>::NonZeros(
+            matrix)));
+
+        std::size_t indexSize = options.indexSize;
+
+        if (indexSize == 0) {
+            indexSize = (largest <= std::size_t(
+                std::numeric_limits<std::int32_t>::max())) ? 4 : 8;
+        }
+
+        if (indexSize == 4) {
+            if (largest > std::size_t(
+                std::numeric_limits<std::int32_t>::max())) {
+                throw std::runtime_error("Matrix too large for 32-bit "
+                    "indices");
+            }
+
+            header.indexSize = 4;
+
+            WriteSparse<TMatrix, std::int32_t>(matrix, target, header);
+        } else if (indexSize == 8) {
+            header.indexSize = 8;
+
+            WriteSparse<TMatrix, std::int64_t>(matrix, target, header);
+        } else {
+            throw std::runtime_error("Invalid index size");
+        }
+    }
+
+    template <typename TMatrix>
+    static void
+    Write(
+        const TMatrix& matrix,
+        FileTarget& target,
+        BinaryHeader& header,
+        const BinaryOptions& /*options*/,
+        std::false_type)
+    {
+        using Builder = MatrixBuilder<TMatrix>;
+        using ScalarType = typename Builder::ScalarType;
+
+        header.storage = BinaryHeader::Dense;
+        header.valueOffset = BinaryHeader::Size;
+
+        WriteHeader(target, header);
+
+        OutputSink<FileTarget> sink(target);
+
+        for (std::size_t col = 0; col < header.cols; col++) {
+            for (std::size_t row = 0; row < header.rows; row++) {
+                const ScalarType value = Builder::GetValue(matrix, row, col);
+
+                char* pos = sink.Reserve(sizeof(ScalarType));
+
+                std::memcpy(pos, &value, sizeof(ScalarType));
+
+                sink.Commit(pos + sizeof(ScalarType));
+            }
+        }
+
+        sink.Flush();
+    }
+
+    static void
+    WriteHeader(
+        FileTarget& target,
+        const BinaryHeader& header)
+    {
+        char block[BinaryHeader::Size] = {};
+
+        std::memcpy(block, &header, sizeof(BinaryHeader));
+
+        target.Write(block, BinaryHeader::Size);
+    }
+
+    static void
+    WritePadded(
+        FileTarget& target,
+        const void* data,
+        const std::size_t size)
+    {
+        const char padding[BinaryHeader::Alignment] = {};
+
+        target.Write(static_cast<const char*>(data), size);
+        target.Write(padding, BinaryAlign(size) - size);
+    }
+
+public:
+    template <typename TMatrix>
+    static void
+    WriteToFile(
+        const TMatrix& matrix,
+        const std::string& path,
+        const BinaryOptions& options)
+    {
+        using Builder = MatrixBuilder<TMatrix>;
+        using ScalarType = typename Builder::ScalarType;
+
+        BinaryHeader header;
+
+        header.scalarKind = ScalarKind<ScalarType>();
+        header.scalarSize = sizeof(ScalarType);
+        header.rows = Builder::Rows(matrix);
+        header.cols = Builder::Cols(matrix);
+
+        FileTarget target(path);
+
+        Write(matrix, target, header, options,
+            typename HasForEachNonZero<Builder>::type());
+
+        target.Close();
+    }
+
+    template <typename TMatrix>
+    static void
+    WriteToFile(
+        const TMatrix& matrix,
+        const std::string& path)
+    {
+        WriteToFile(matrix, path, BinaryOptions());
+    }
+}; // class BinaryWriter
+
+// Copies a binary file into any matrix with a MatrixBuilder. Use the views
+// of the backends to work on the file without a copy.
+class BinaryReader
+{
+private:
+    template <typename TBuilder, typename TIndex>
+    static void
+    FillSparse(
+        TBuilder& builder,
+        const BinaryFile& file,
+        std::true_type)
+    {
+        using ScalarType = typename TBuilder::ScalarType;
+
+        const BinaryHeader& header = file.Header();
+
+        const TIndex* outer = file.OuterIndices<TIndex>();
+        const TIndex* inner = file.InnerIndices<TIndex>();
+        const ScalarType* values = file.Values<ScalarType>();
+
+        const bool rowMajor = file.IsRowMajor();
+
+        builder.BeginCompressed(header.rows, header.cols, header.nonZeros);
+
+        for (std::size_t i = 0; i < header.OuterSize(); i++) {
+            for (std::size_t j = outer[i]; j < std::size_t(outer[i + 1]);
+                 j++) {
+                const std::size_t k = std::size_t(inner[j]);
+
+                builder.CountEntry(rowMajor ? i : k, rowMajor ? k : i);
+            }
+        }
+
+        builder.EndCount();
+
+        for (std::size_t i = 0; i < header.OuterSize(); i++) {
+            for (std::size_t j = outer[i]; j < std::size_t(outer[i + 1]);
+                 j++) {
+                const std::size_t k = std::size_t(inner[j]);
+
+                builder.FillEntry(rowMajor ? i : k, rowMajor ? k : i,
+                    values[j]);
+            }
+        }
+
+        builder.EndCompressed();
+    }
+
+    template <typename TBuilder, typename TIndex>
+    static void
+    FillSparse(
+        TBuilder& builder,
+        const BinaryFile& file,
+        std::false_type)
+    {
+        using ScalarType = typename TBuilder::ScalarType;
+
+        const BinaryHeader& header = file.Header();
+
+        const TIndex* outer = file.OuterIndices<TIndex>();
+        const TIndex* inner = file.InnerIndices<TIndex>();
+        const ScalarType* values = file.Values<ScalarType>();
+
+        const bool rowMajor = file.IsRowMajor();
+
+        builder.BeginCoordinate(header.rows, header.cols, header.nonZeros);
+
+        for (std::size_t i = 0; i < header.OuterSize(); i++) {
+            for (std::size_t j = outer[i]; j < std::size_t(outer[i + 1]);
+                 j++) {
+                const std::size_t k = std::size_t(inner[j]);
+
+                builder.SetValue(rowMajor ? i : k, rowMajor ? k : i,
+                    values[j]);
+            }
+        }
+
+        builder.EndCoordinate();
+    }
+
+    template <typename TBuilder, typename TIndex>
+    static void
+    ReadSparse(
+        TBuilder& builder,
+        const BinaryFile& file)
+    {
+        // the indices are checked once before they reach the builder
+
+        file.CheckIndices<TIndex>();
+
+        FillSparse<TBuilder, TIndex>(builder, file,
+            typename HasCompressedAssembly<TBuilder>::type());
+    }
+
+public:
+    template <typename TMatrix>
+    static void
+    ReadFromFile(
+        TMatrix& matrix,
+        const std::string& path)
+    {
+        using Builder = MatrixBuilder<TMatrix>;
+        using ScalarType = typename Builder::ScalarType;
+
+        const BinaryFile file(path);
+
+        const BinaryHeader& header = file.Header();
+
+        // checks the scalar type before the matrix is modified
+
+        const ScalarType* values = file.Values<ScalarType>();
+
+        Builder builder(matrix);
+
+        if (header.indexSize == 4 && file.IsSparse()) {
+            ReadSparse<Builder, std::int32_t>(builder, file);
+        } else if (header.indexSize == 8 && file.IsSparse()) {
+            ReadSparse<Builder, std::int64_t>(builder, file);
+        } else {
+            builder.BeginArray(header.rows, header.cols);
+
+            for (std::size_t col = 0; col < header.cols; col++) {
+                for (std::size_t row = 0; row < header.rows; row++) {
+                    builder.SetValue(row, col, *values++);
+                }
+            }
+
+            builder.EndArray();
+        }
+    }
+}; // class BinaryReader
+
+} // namespace MatrixMerchant
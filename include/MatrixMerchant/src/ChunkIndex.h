@@ -0,0 +1,252 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "BinaryCache.h"
+#include "MappedFile.h"
+
+namespace MatrixMerchant {
+
+// Sidecar index into the body of a coordinate file (filename.index). The
+// entries are grouped into chunks of consecutive lines. For every chunk the
+// index records the byte offset of its first line relative to the start of
+// the body, the number of entries before it, the position of its first
+// entry and the rows and columns covered by all of its entries:
+//
+//   IndexHeader
+//   IndexChunk[count]
+//
+// Readers split the body at the chunk offsets instead of scanning for
+// newlines, and skip the chunks that cannot contribute to a block. The
+// index identifies the file by its SourceStamp like the cache, and the body
+// by its size and number of entries.
+struct IndexHeader
+{
+    static const std::uint32_t CurrentVersion = 2;
+    static const std::uint32_t ByteOrder = 0x01020304;
+
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byteOrder;
+
+    SourceStamp source;
+
+    std::uint64_t bodySize;
+    std::uint64_t nonZeros;
+    std::uint64_t count;
+
+    IndexHeader()
+    {
+        std::memset(this, 0, sizeof(IndexHeader));
+        std::memcpy(magic, "MMINDEX", 8);
+
+        version = CurrentVersion;
+        byteOrder = ByteOrder;
+    }
+
+    bool
+    IsValid() const
+    {
+        return std::memcmp(magic, "MMINDEX", 8) == 0 &&
+            version == CurrentVersion && byteOrder == ByteOrder;
+    }
+};
+
+struct IndexChunk
+{
+    std::uint64_t offset;
+    std::uint64_t entry;
+
+    // zero-based position of the first entry
+    std::uint64_t row;
+    std::uint64_t col;
+
+    // all entries lie in [rowBegin, rowEnd) x [colBegin, colEnd)
+    std::uint64_t rowBegin;
+    std::uint64_t rowEnd;
+    std::uint64_t colBegin;
+    std::uint64_t colEnd;
+};
+
+static inline std::string
+IndexPath(
+    const std::string& filename)
+{
+    return filename + ".index";
+}
+
+// Collects the chunks while the entries of a body are written or read.
+// Entries are counted from the first entry added, offsets from the origin.
+class IndexRecorder
+{
+private:
+    std::vector<IndexChunk> m_chunks;
+    std::size_t m_stride;
+    std::size_t m_count;
+    std::size_t m_origin;
+
+public:
+    IndexRecorder(
+        const std::size_t stride)
+        : m_stride(std::max<std::size_t>(stride, 1))
+        , m_count(0)
+        , m_origin(0)
+    {
+    }
+
+    std::size_t
+    Stride() const
+    {
+        return m_stride;
+    }
+
+    // Sets the offset of the start of the body
+    void
+    SetOrigin(
+        const std::size_t origin)
+    {
+        m_origin = origin;
+    }
+
+    std::size_t
+    Origin() const
+    {
+        return m_origin;
+    }
+
+    void
+    Add(
+        const std::size_t offset,
+        const std::size_t row,
+        const std::size_t col)
+    {
+        if (m_count % m_stride == 0) {
+            const IndexChunk chunk = {offset - m_origin, m_count, row, col,
+                row, row + 1, col, col + 1};
+
+            m_chunks.push_back(chunk);
+        } else {
+            IndexChunk& chunk = m_chunks.back();
+
+            chunk.rowBegin = std::min<std::uint64_t>(chunk.rowBegin, row);
+            chunk.rowEnd = std::max<std::uint64_t>(chunk.rowEnd, row + 1);
+            chunk.colBegin = std::min<std::uint64_t>(chunk.colBegin, col);
+            chunk.colEnd = std::max<std::uint64_t>(chunk.colEnd, col + 1);
+        }
+
+        m_count += 1;
+    }
+
+    // Appends the chunks of a recorder whose entries follow the ones of this
+    // recorder, starting at the given offset. The chunks before can be
+    // shorter than the stride.
+    void
+    Append(
+        const IndexRecorder& other,
+        const std::size_t offset)
+    {
+        for (IndexChunk chunk : other.m_chunks) {
+            chunk.offset += offset - m_origin;
+            chunk.entry += m_count;
+
+            m_chunks.push_back(chunk);
+        }
+
+        m_count += other.m_count;
+    }
+
+    void
+    Clear()
+    {
+        m_chunks.clear();
+        m_count = 0;
+    }
+
+    const std::vector<IndexChunk>&
+    Chunks() const
+    {
+        return m_chunks;
+    }
+}; // class IndexRecorder
+
+// Writes the index of a file that is complete. Failures are ignored like
+// for the cache.
+static inline bool
+WriteIndexFile(
+    const std::string& filename,
+    const std::size_t nonZeros,
+    const std::size_t bodySize,
+    const std::vector<IndexChunk>& chunks)
+{
+    IndexHeader header;
+
+    if (!GetSourceStamp(filename, header.source)) {
+        return false;
+    }
+
+    header.bodySize = bodySize;
+    header.nonZeros = nonZeros;
+    header.count = chunks.size();
+
+    return WriteSidecarFile(IndexPath(filename), {
+        {&header, sizeof(header)},
+        {chunks.data(), chunks.size() * sizeof(IndexChunk)}});
+}
+
+// Returns false if there is no index or it belongs to another version of
+// the file. The chunks are only checked to be in order and inside of a body
+// of the given size.
+static inline bool
+ReadIndexFile(
+    const std::string& filename,
+    const std::size_t nonZeros,
+    const std::size_t bodySize,
+    std::vector<IndexChunk>& chunks)
+{
+    SourceStamp source;
+
+    if (!GetSourceStamp(filename, source)) {
+        return false;
+    }
+
+    MappedFile mapping(IndexPath(filename));
+
+    if (!mapping.IsMapped() || mapping.Size() < sizeof(IndexHeader)) {
+        return false;
+    }
+
+    IndexHeader header;
+
+    std::memcpy(&header, mapping.Data(), sizeof(IndexHeader));
+
+    if (!header.IsValid() || header.source != source ||
+        header.bodySize != bodySize || header.nonZeros != nonZeros ||
+        header.count > (mapping.Size() - sizeof(IndexHeader)) /
+            sizeof(IndexChunk)) {
+        return false;
+    }
+
+    chunks.resize(header.count);
+
+    std::memcpy(chunks.data(), mapping.Data() + sizeof(IndexHeader),
+        chunks.size() * sizeof(IndexChunk));
+
+    for (std::size_t i = 0; i < chunks.size(); i++) {
+        const IndexChunk& chunk = chunks[i];
+
+        if (chunk.offset >= bodySize || chunk.entry >= nonZeros ||
+            (i != 0 && (chunk.offset <= chunks[i - 1].offset ||
+                chunk.entry <= chunks[i - 1].entry))) {
+            chunks.clear();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+} // namespace MatrixMerchant
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace MatrixMerchant {
+
+// Building blocks for assembling compressed row or column storage in place.
+// The outer index array has outerSize + 1 entries.
+//
+// Usage:
+//   1. zero the outer index array and call Count for every entry
+//   2. CountsToOffsets, then allocate the inner index and value arrays
+//   3. Insert every entry
+//   4. Finish, which returns the final number of nonzeros
+//
+// Between steps 2 and 4 the outer index array is used as insertion cursor,
+// so no memory beyond the final matrix is needed.
+template <typename TIndex, typename TScalar>
+struct CompressedAssembly
+{
+    static void
+    Count(
+        TIndex* outerIndex,
+        const std::size_t outer)
+    {
+        outerIndex[outer + 1] += 1;
+    }
+
+    static void
+    CountsToOffsets(
+        TIndex* outerIndex,
+        const std::size_t outerSize)
+    {
+        for (std::size_t i = 0; i < outerSize; i++) {
+            outerIndex[i + 1] += outerIndex[i];
+        }
+    }
+
+    static void
+    Insert(
+        TIndex* outerIndex,
+        TIndex* innerIndex,
+        TScalar* values,
+        const std::size_t outer,
+        const std::size_t inner,
+        const TScalar& value)
+    {
+        const TIndex pos = outerIndex[outer]++;
+
+        innerIndex[pos] = TIndex(inner);
+        values[pos] = value;
+    }
+
+    // Restores the offsets, sorts every outer vector by inner index and sums
+    // duplicate entries.
+    static std::size_t
+    Finish(
+        TIndex* outerIndex,
+        TIndex* innerIndex,
+        TScalar* values,
+        const std::size_t outerSize)
+    {
+        // after insertion every cursor points to the begin of the next
+        // outer vector
+
+        for (std::size_t i = outerSize; i > 0; i--) {
+            outerIndex[i] = outerIndex[i - 1];
+        }
+
+        outerIndex[0] = 0;
+
+        std::vector<std::pair<TIndex, TScalar>> scratch;
+
+        std::size_t target = 0;
+
+        for (std::size_t i = 0; i < outerSize; i++) {
+            const std::size_t begin = std::size_t(outerIndex[i]);
+            const std::size_t end = std::size_t(outerIndex[i + 1]);
+
+            bool sorted = true;
+
+            for (std::size_t k = begin + 1; k < end && sorted; k++) {
+                sorted = innerIndex[k - 1] < innerIndex[k];
+            }
+
+            if (!sorted) {
+                scratch.clear();
+
+                for (std::size_t k = begin; k < end; k++) {
+                    scratch.emplace_back(innerIndex[k], values[k]);
+                }
+
+                std::stable_sort(scratch.begin(), scratch.end(),
+                    [](const std::pair<TIndex, TScalar>& a,
+                        const std::pair<TIndex, TScalar>& b) {
+                        return a.first < b.first;
+                    });
+
+                for (std::size_t k = begin; k < end; k++) {
+                    innerIndex[k] = scratch[k - begin].first;
+                    values[k] = scratch[k - begin].second;
+                }
+            }
+
+            // compact and sum duplicates
+
+            outerIndex[i] = TIndex(target);
+
+            for (std::size_t k = begin; k < end; k++) {
+                if (target > std::size_t(outerIndex[i]) &&
+                    innerIndex[target - 1] == innerIndex[k]) {
+                    values[target - 1] += values[k];
+                    continue;
+                }
+
+                innerIndex[target] = innerIndex[k];
+                values[target] = values[k];
+
+                target += 1;
+            }
+        }
+
+        outerIndex[outerSize] = TIndex(target);
+
+        return target;
+    }
+};
+
+// Value-free counterpart of CompressedAssembly for structure-only matrices.
+// The usage is the same, duplicate entries are merged.
+template <typename TIndex>
+struct PatternAssembly
+{
+    static void
+    Count(
+        TIndex* outerIndex,
+        const std::size_t outer)
+    {
+        outerIndex[outer + 1] += 1;
+    }
+
+    static void
+    CountsToOffsets(
+        TIndex* outerIndex,
+        const std::size_t outerSize)
+    {
+        for (std::size_t i = 0; i < outerSize; i++) {
+            outerIndex[i + 1] += outerIndex[i];
+        }
+    }
+
+    static void
+    Insert(
+        TIndex* outerIndex,
+        TIndex* innerIndex,
+        const std::size_t outer,
+        const std::size_t inner)
+    {
+        innerIndex[outerIndex[outer]++] = TIndex(inner);
+    }
+
+    // Restores the offsets, sorts every outer vector and removes duplicates
+    static std::size_t
+    Finish(
+        TIndex* outerIndex,
+        TIndex* innerIndex,
+        const std::size_t outerSize)
+    {
+        for (std::size_t i = outerSize; i > 0; i--) {
+            outerIndex[i] = outerIndex[i - 1];
+        }
+
+        outerIndex[0] = 0;
+
+        std::size_t target = 0;
+
+        for (std::size_t i = 0; i < outerSize; i++) {
+            TIndex* begin = innerIndex + outerIndex[i];
+            TIndex* end = innerIndex + outerIndex[i + 1];
+
+            if (!std::is_sorted(begin, end)) {
+                std::sort(begin, end);
+            }
+
+            end = std::unique(begin, end);
+
+            outerIndex[i] = TIndex(target);
+
+            target = std::size_t(std::copy(begin, end, innerIndex + target) -
+                innerIndex);
+        }
+
+        outerIndex[outerSize] = TIndex(target);
+
+        return target;
+    }
+};
+
+} // namespace MatrixMerchant
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+#ifdef MATRIXMERCHANT_USE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef MATRIXMERCHANT_USE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace MatrixMerchant {
+
+enum class Compression
+{
+    None,
+    Gzip,
+    Zstd
+};
+
+// A Matrix Market file starts with '%', so the first byte of the magic
+// numbers of gzip (1f 8b) and zstd (28 b5 2f fd) is enough to tell the
+// formats apart. The remaining bytes are validated by the decoder.
+static inline Compression
+DetectCompression(
+    const int firstByte)
+{
+    if (firstByte == 0x1f) {
+        return Compression::Gzip;
+    } else if (firstByte == 0x28) {
+        return Compression::Zstd;
+    } else {
+        return Compression::None;
+    }
+}
+
+// Decoders share a minimal streaming interface: Decode consumes input from
+// [input, inputEnd) and writes output to [output, outputEnd), advancing both
+// pointers. AtEnd tells whether the data decoded so far ends with a complete
+// frame.
+
+#ifdef MATRIXMERCHANT_USE_ZLIB
+class GzipDecoder
+{
+private:
+    z_stream m_stream;
+    bool m_end;
+
+public:
+    GzipDecoder()
+        : m_stream()
+        , m_end(false)
+    {
+        // 15 + 32 accepts gzip and zlib headers
+        if (inflateInit2(&m_stream, 15 + 32) != Z_OK) {
+            throw std::runtime_error("MatrixMarket gzip initialization failed");
+        }
+    }
+
+    GzipDecoder(const GzipDecoder&) = delete;
+
+    GzipDecoder&
+    operator=(const GzipDecoder&) = delete;
+
+    ~GzipDecoder()
+    {
+        inflateEnd(&m_stream);
+    }
+
+    void
+    Decode(
+        const char*& input,
+        const char* inputEnd,
+        char*& output,
+        char* outputEnd)
+    {
+        if (m_end) {
+            if (input == inputEnd) {
+                return;
+            }
+
+            // concatenated gzip members
+
+            inflateReset(&m_stream);
+            m_end = false;
+        }
+
+        m_stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input));
+        m_stream.avail_in = uInt(inputEnd - input);
+        m_stream.next_out = reinterpret_cast<Bytef*>(output);
+        m_stream.avail_out = uInt(outputEnd - output);
+
+        const int status = inflate(&m_stream, Z_NO_FLUSH);
+
+        if (status == Z_STREAM_END) {
+            m_end = true;
+        } else if (status != Z_OK && status != Z_BUF_ERROR) {
+            throw std::runtime_error("MatrixMarket gzip data invalid");
+        }
+
+        input = inputEnd - m_stream.avail_in;
+        output = outputEnd - m_stream.avail_out;
+    }
+
+    bool
+    AtEnd() const
+    {
+        return m_end;
+    }
+}; // class GzipDecoder
+#endif
+
+#ifdef MATRIXMERCHANT_USE_ZSTD
+class ZstdDecoder
+{
+private:
+    ZSTD_DStream* m_stream;
+    bool m_end;
+
+public:
+    ZstdDecoder()
+        : m_stream(ZSTD_createDStream())
+        , m_end(false)
+    {
+        if (m_stream == nullptr || ZSTD_isError(ZSTD_initDStream(m_stream))) {
+            ZSTD_freeDStream(m_stream);
+            throw std::runtime_error("MatrixMarket zstd initialization failed");
+        }
+    }
+
+    ZstdDecoder(const ZstdDecoder&) = delete;
+
+    ZstdDecoder&
+    operator=(const ZstdDecoder&) = delete;
+
+    ~ZstdDecoder()
+    {
+        ZSTD_freeDStream(m_stream);
+    }
+
+    void
+    Decode(
+        const char*& input,
+        const char* inputEnd,
+        char*& output,
+        char* outputEnd)
+    {
+        ZSTD_inBuffer in = {input, std::size_t(inputEnd - input), 0};
+        ZSTD_outBuffer out = {output, std::size_t(outputEnd - output), 0};
+
+        const std::size_t status = ZSTD_decompressStream(m_stream, &out, &in);
+
+        if (ZSTD_isError(status)) {
+            throw std::runtime_error(std::string("MatrixMarket zstd data "
+                "invalid: ") + ZSTD_getErrorName(status));
+        }
+
+        // 0 marks the end of a frame, further frames may follow
+
+        if (in.pos != 0 || out.pos != 0) {
+            m_end = (status == 0);
+        }
+
+        input += in.pos;
+        output += out.pos;
+    }
+
+    bool
+    AtEnd() const
+    {
+        return m_end;
+    }
+}; // class ZstdDecoder
+#endif
+
+} // namespace MatrixMerchant
@@ -3,6 +3,9 @@
 #include <Eigen/Core>
 #include <Eigen/Sparse>
 
+#include <algorithm>
+#include <vector>
+
 #include "MatrixMerchant.h"
 
 namespace MatrixMerchant {
@@ -29,6 +32,7 @@ struct MatrixBuilder<Eigen::Matrix<TScalar, Eigen::Dynamic, Eigen::Dynamic>>
         const std::size_t& nonZeros)
     {
         m_matrix.resize(rows, cols);
+        m_matrix.setZero();
     }
 
     void
@@ -49,6 +53,13 @@ struct MatrixBuilder<Eigen::Matrix<TScalar, Eigen::Dynamic, Eigen::Dynamic>>
     {
     }
 
+    void
+    MirrorTriangle(
+        const Symmetry symmetry)
+    {
+        MirrorLowerTriangle(m_matrix, m_matrix.rows(), symmetry);
+    }
+
     void
     SetValue(
         const std::size_t& row,
@@ -228,15 +239,22 @@ struct MatrixBuilder<Eigen::Matrix<TScalar, 1, Eigen::Dynamic>>
 };
 
 
-template <typename TScalar>
-struct MatrixBuilder<Eigen::SparseMatrix<TScalar>>
+template <typename TScalar, int TOptions, typename TStorageIndex>
+struct MatrixBuilder<Eigen::SparseMatrix<TScalar, TOptions, TStorageIndex>>
 {
-    using MatrixType = Eigen::SparseMatrix<TScalar>;
+    using MatrixType = Eigen::SparseMatrix<TScalar, TOptions, TStorageIndex>;
 
     using ScalarType = TScalar;
 
+    using TripletType = Eigen::Triplet<ScalarType,
+        typename MatrixType::StorageIndex>;
+
     MatrixType& m_matrix;
 
+    // Entries are collected and assembled at the end in O(nnz), independent
+    // of the order in which they are read
+    std::vector<TripletType> m_triplets;
+
     MatrixBuilder(
         MatrixType& matrix)
         : m_matrix(matrix)
@@ -250,12 +268,17 @@ struct MatrixBuilder<Eigen::SparseMatrix<TScalar>>
         const std::size_t& nonZeros)
     {
         m_matrix.resize(rows, cols);
-        m_matrix.reserve(nonZeros);
+
+        m_triplets.clear();
+        m_triplets.reserve(nonZeros);
     }
 
     void
     EndCoordinate()
     {
+        m_matrix.setFromTriplets(m_triplets.begin(), m_triplets.end());
+
+        std::vector<TripletType>().swap(m_triplets);
     }
 
     void
@@ -263,12 +286,13 @@ struct MatrixBuilder<Eigen::SparseMatrix<TScalar>>
         const std::size_t& rows,
         const std::size_t& cols)
     {
-        m_matrix.resize(rows, cols);
+        BeginCoordinate(rows, cols, rows * cols);
     }
 
     void
     EndArray()
     {
+        EndCoordinate();
     }
 
     void
@@ -277,10 +301,79 @@ struct MatrixBuilder<Eigen::SparseMatrix<TScalar>>
         const std::size_t& col,
         const ScalarType& value)
     {
-        m_matrix.insert(row, col) = value;
+        m_triplets.emplace_back(row, col, value);
     }
 
-    static inline const ScalarType&
+    // --- two-pass assembly directly into the compressed storage
+
+    using StorageIndex = typename MatrixType::StorageIndex;
+
+    using Assembly = CompressedAssembly<StorageIndex, ScalarType>;
+
+    static std::size_t
+    Outer(
+        const std::size_t& row,
+        const std::size_t& col)
+    {
+        return MatrixType::IsRowMajor ? row : col;
+    }
+
+    static std::size_t
+    Inner(
+        const std::size_t& row,
+        const std::size_t& col)
+    {
+        return MatrixType::IsRowMajor ? col : row;
+    }
+
+    void
+    BeginCompressed(
+        const std::size_t& rows,
+        const std::size_t& cols,
+        const std::size_t& /*nonZeros*/)
+    {
+        m_matrix.resize(rows, cols);
+    }
+
+    void
+    CountEntry(
+        const std::size_t& row,
+        const std::size_t& col)
+    {
+        Assembly::Count(m_matrix.outerIndexPtr(), Outer(row, col));
+    }
+
+    void
+    EndCount()
+    {
+        Assembly::CountsToOffsets(m_matrix.outerIndexPtr(),
+            m_matrix.outerSize());
+
+        m_matrix.resizeNonZeros(m_matrix.outerIndexPtr()[
+            m_matrix.outerSize()]);
+    }
+
+    void
+    FillEntry(
+        const std::size_t& row,
+        const std::size_t& col,
+        const ScalarType& value)
+    {
+        Assembly::Insert(m_matrix.outerIndexPtr(), m_matrix.innerIndexPtr(),
+            m_matrix.valuePtr(), Outer(row, col), Inner(row, col), value);
+    }
+
+    void
+    EndCompressed()
+    {
+        const std::size_t nonZeros = Assembly::Finish(
+            m_matrix.outerIndexPtr(), m_matrix.innerIndexPtr(),
+            m_matrix.valuePtr(), m_matrix.outerSize());
+
+        m_matrix.resizeNonZeros(nonZeros);
+    }
+
+    static inline ScalarType
     GetValue(
         const MatrixType& matrix,
         const std::size_t& row,
@@ -307,8 +400,157 @@ struct MatrixBuilder<Eigen::SparseMatrix<TScalar>>
     NonZeros(
         const MatrixType& matrix)
     {
-        return matrix.rows() * matrix.cols();
+        return matrix.nonZeros();
+    }
+
+    // --- iteration over the stored entries in storage order
+
+    static inline std::size_t
+    OuterSize(
+        const MatrixType& matrix)
+    {
+        return matrix.outerSize();
+    }
+
+    template <typename TFunction>
+    static void
+    ForEachNonZero(
+        const MatrixType& matrix,
+        const std::size_t outerBegin,
+        const std::size_t outerEnd,
+        TFunction function)
+    {
+        for (std::size_t outer = outerBegin; outer < outerEnd; outer++) {
+            for (typename MatrixType::InnerIterator it(matrix, outer); it;
+                 ++it) {
+                function(std::size_t(it.row()), std::size_t(it.col()),
+                    it.value());
+            }
+        }
+    }
+
+    // --- direct access to the stored values
+
+    static inline std::size_t
+    SlotCount(
+        const MatrixType& matrix)
+    {
+        return std::size_t(matrix.outerIndexPtr()[matrix.outerSize()]);
+    }
+
+    // Stored entries of an outer vector, also for uncompressed matrices
+    static inline std::size_t
+    SlotEnd(
+        const MatrixType& matrix,
+        const std::size_t& outer)
+    {
+        if (matrix.isCompressed()) {
+            return std::size_t(matrix.outerIndexPtr()[outer + 1]);
+        }
+
+        return std::size_t(matrix.outerIndexPtr()[outer] +
+            matrix.innerNonZeroPtr()[outer]);
+    }
+
+    static inline std::size_t
+    FindSlot(
+        const MatrixType& matrix,
+        const std::size_t& row,
+        const std::size_t& col)
+    {
+        const std::size_t outer = Outer(row, col);
+
+        const StorageIndex* begin = matrix.innerIndexPtr() +
+            matrix.outerIndexPtr()[outer];
+        const StorageIndex* end = matrix.innerIndexPtr() +
+            SlotEnd(matrix, outer);
+
+        const StorageIndex inner = StorageIndex(Inner(row, col));
+
+        const StorageIndex* pos = std::lower_bound(begin, end, inner);
+
+        if (pos == end || *pos != inner) {
+            return SlotCount(matrix);
+        }
+
+        return std::size_t(pos - matrix.innerIndexPtr());
+    }
+
+    static inline bool
+    IsSlot(
+        const MatrixType& matrix,
+        const std::size_t& slot,
+        const std::size_t& row,
+        const std::size_t& col)
+    {
+        const std::size_t outer = Outer(row, col);
+
+        return slot >= std::size_t(matrix.outerIndexPtr()[outer]) &&
+            slot < SlotEnd(matrix, outer) &&
+            std::size_t(matrix.innerIndexPtr()[slot]) == Inner(row, col);
+    }
+
+    static inline ScalarType*
+    ValuePtr(
+        MatrixType& matrix)
+    {
+        return matrix.valuePtr();
     }
 };
 
+// Views of a binary file without a copy. The views are read-only and refer
+// to the mapping, so the BinaryFile has to outlive them. The storage order
+// and index type of the sparse matrix have to match the file.
+//
+// MapSparseMatrixUnchecked does not look at the indices, so a corrupted
+// file can make the view read past the mapping. Use it only for files that
+// were written by BinaryWriter and checked before. MapSparseMatrix checks
+// them once, which touches every index of the file.
+template <typename TScalar, int TOptions = Eigen::ColMajor,
+    typename TIndex = int>
+static Eigen::Map<const Eigen::SparseMatrix<TScalar, TOptions, TIndex>>
+MapSparseMatrixUnchecked(
+    const BinaryFile& file)
+{
+    const bool rowMajor = (TOptions & Eigen::RowMajorBit) != 0;
+
+    if (!file.IsSparse() || file.IsRowMajor() != rowMajor) {
+        throw std::runtime_error("Binary file has another storage order");
+    }
+
+    return Eigen::Map<const Eigen::SparseMatrix<TScalar, TOptions, TIndex>>(
+        Eigen::Index(file.Rows()), Eigen::Index(file.Cols()),
+        Eigen::Index(file.NonZeros()), file.OuterIndices<TIndex>(),
+        file.InnerIndices<TIndex>(), file.Values<TScalar>());
+}
+
+template <typename TScalar, int TOptions = Eigen::ColMajor,
+    typename TIndex = int>
+static Eigen::Map<const Eigen::SparseMatrix<TScalar, TOptions, TIndex>>
+MapSparseMatrix(
+    const BinaryFile& file)
+{
+    const Eigen::Map<const Eigen::SparseMatrix<TScalar, TOptions, TIndex>>
+        view = MapSparseMatrixUnchecked<TScalar, TOptions, TIndex>(file);
+
+    file.CheckIndices<TIndex>();
+
+    return view;
+}
+
+template <typename TScalar>
+static Eigen::Map<const Eigen::Matrix<TScalar, Eigen::Dynamic, Eigen::Dynamic>,
+    Eigen::Aligned64>
+MapMatrix(
+    const BinaryFile& file)
+{
+    if (file.IsSparse()) {
+        throw std::runtime_error("Binary file has another storage order");
+    }
+
+    return Eigen::Map<const Eigen::Matrix<TScalar, Eigen::Dynamic,
+        Eigen::Dynamic>, Eigen::Aligned64>(file.Values<TScalar>(),
+        Eigen::Index(file.Rows()), Eigen::Index(file.Cols()));
+}
+
 } // namespace MatrixMerchant
\ No newline at end of file
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MATRIXMERCHANT_HAS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace MatrixMerchant {
+
+// Read-only memory mapping of a regular file. Mapping is not possible for
+// pipes, character devices, empty files or on platforms without mmap. In
+// these cases IsMapped returns false and the caller has to fall back to
+// stream based reading.
+class MappedFile
+{
+private:
+    const char* m_data;
+    std::size_t m_size;
+
+public:
+    MappedFile(
+        const std::string& path)
+        : m_data(nullptr)
+        , m_size(0)
+    {
+#ifdef MATRIXMERCHANT_HAS_MMAP
+        const int fd = ::open(path.c_str(), O_RDONLY);
+
+        if (fd < 0) {
+            return;
+        }
+
+        struct stat info;
+
+        if (::fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) ||
+            info.st_size <= 0) {
+            ::close(fd);
+            return;
+        }
+
+        void* data = ::mmap(nullptr, std::size_t(info.st_size), PROT_READ,
+            MAP_PRIVATE, fd, 0);
+
+        ::close(fd);
+
+        if (data == MAP_FAILED) {
+            return;
+        }
+
+        m_data = static_cast<const char*>(data);
+        m_size = std::size_t(info.st_size);
+
+        ::madvise(data, m_size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+        ::madvise(data, m_size, MADV_HUGEPAGE);
+#endif
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+
+    MappedFile&
+    operator=(const MappedFile&) = delete;
+
+    ~MappedFile()
+    {
+#ifdef MATRIXMERCHANT_HAS_MMAP
+        if (m_data != nullptr) {
+            ::munmap(const_cast<char*>(m_data), m_size);
+        }
+#endif
+    }
+
+    bool
+    IsMapped() const
+    {
+        return m_data != nullptr;
+    }
+
+    const char*
+    Data() const
+    {
+        return m_data;
+    }
+
+    std::size_t
+    Size() const
+    {
+        return m_size;
+    }
+}; // class MappedFile
+
+} // namespace MatrixMerchant
@@ -1,77 +1,168 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <complex>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
 #include <fstream>
-#include <iomanip>
+#include <iterator>
 #include <istream>
 #include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "BinaryCache.h"
+#include "ChunkIndex.h"
+#include "CompressedAssembly.h"
+#include "Decompression.h"
+#include "MappedFile.h"
+#include "NumberFormatter.h"
+#include "NumberParser.h"
+#include "OutputSink.h"
+#include "Parallel.h"
+#include "Statistics.h"
 
 namespace MatrixMerchant {
 
-static bool
-TryParse(
-    const std::string& text,
-    std::size_t& value)
+// A view into a line buffer. The referenced characters are owned by the
+// caller and are only valid until the buffer is modified.
+struct Token
 {
-    char* end;
+    const char* begin;
+    const char* end;
 
-    const std::size_t parsedValue = std::strtoull(text.c_str(), &end, 10);
+    std::size_t
+    Size() const
+    {
+        return end - begin;
+    }
 
-    const bool success = (end == &text[text.size()]);
+    std::string
+    ToString() const
+    {
+        return std::string(begin, end);
+    }
 
-    if (success) {
-        value = parsedValue;
+    bool
+    operator==(
+        const char* text) const
+    {
+        const std::size_t length = std::strlen(text);
+
+        return Size() == length && std::memcmp(begin, text, length) == 0;
     }
 
-    return success;
-}
+    bool
+    operator!=(
+        const char* text) const
+    {
+        return !(*this == text);
+    }
+};
 
-static bool
-TryParse(
-    const std::string& text,
-    int& value)
+// A fixed-capacity list of tokens. Tokens beyond the capacity are counted but
+// not stored, so a size check is still meaningful for overlong lines.
+class Tokens
 {
-    char* end;
+public:
+    static const std::size_t Capacity = 8;
 
-    const int parsedValue = (int)std::strtol(text.c_str(), &end, 10);
+private:
+    Token m_tokens[Capacity];
+    std::size_t m_size;
 
-    const bool success = (end == &text[text.size()]);
+public:
+    Tokens()
+        : m_size(0)
+    {
+    }
 
-    if (success) {
-        value = parsedValue;
+    std::size_t
+    Size() const
+    {
+        return m_size;
     }
 
-    return success;
+    const Token&
+    operator[](
+        const std::size_t index) const
+    {
+        return m_tokens[index];
+    }
+
+    void
+    Clear()
+    {
+        m_size = 0;
+    }
+
+    void
+    Add(
+        const char* begin,
+        const char* end)
+    {
+        if (m_size < Capacity) {
+            m_tokens[m_size].begin = begin;
+            m_tokens[m_size].end = end;
+        }
+
+        m_size += 1;
+    }
+};
+
+static inline bool
+IsDelimiter(
+    const char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
 }
 
-static bool
-TryParse(
-    const std::string& text,
-    float& value)
+static inline void
+Tokenize(
+    const char* begin,
+    const char* end,
+    Tokens& tokens)
 {
-    char* end;
+    tokens.Clear();
+
+    const char* pos = begin;
 
-    const float parsedValue = std::strtof(text.c_str(), &end);
+    while (true) {
+        while (pos != end && IsDelimiter(*pos)) {
+            pos += 1;
+        }
 
-    const bool success = (end == &text[text.size()]);
+        if (pos == end) {
+            break;
+        }
 
-    if (success) {
-        value = parsedValue;
-    }
+        const char* tokenBegin = pos;
 
-    return success;
+        while (pos != end && !IsDelimiter(*pos)) {
+            pos += 1;
+        }
+
+        tokens.Add(tokenBegin, pos);
+    }
 }
 
-static bool
+template <typename TValue>
+static inline bool
 TryParse(
-    const std::string& text,
-    double& value)
+    const Token& text,
+    TValue& value)
 {
-    char* end;
+    TValue parsedValue = TValue(0);
 
-    const double parsedValue = std::strtod(text.c_str(), &end);
+    const char* end = NumberParser::Parse(text.begin, text.end, parsedValue);
 
-    const bool success = (end == &text[text.size()]);
+    const bool success = (text.Size() != 0 && end == text.end);
 
     if (success) {
         value = parsedValue;
@@ -85,12 +176,12 @@ struct CoordEntry
 {
     static bool
     Read(
-        const std::vector<std::string>& tokens,
+        const Tokens& tokens,
         std::size_t& row,
         std::size_t& col,
         TScalar& value)
     {
-        if (tokens.size() != 3 ||
+        if (tokens.Size() != 3 ||
             !TryParse(tokens[0], row) ||
             !TryParse(tokens[1], col) ||
             !TryParse(tokens[2], value)) {
@@ -103,15 +194,36 @@ struct CoordEntry
         return true;
     }
 
+    static const std::size_t MaxLength = 3 * NumberFormatter::MaxLength;
+
+    static char*
+    Format(
+        char* pos,
+        const std::size_t row,
+        const std::size_t col,
+        const TScalar& value)
+    {
+        pos = NumberFormatter::Format(pos, row + 1);
+        *pos++ = ' ';
+        pos = NumberFormatter::Format(pos, col + 1);
+        *pos++ = ' ';
+        pos = NumberFormatter::Format(pos, value);
+        *pos++ = '\n';
+
+        return pos;
+    }
+
     template <typename TStream>
     static void
     Write(
         TStream& stream,
-        std::size_t& row,
-        std::size_t& col,
+        const std::size_t row,
+        const std::size_t col,
         const TScalar& value)
     {
-        stream << row << " " << col << " " << value << "\n";
+        char buffer[MaxLength];
+
+        stream.write(buffer, Format(buffer, row, col, value) - buffer);
     }
 };
 
@@ -120,7 +232,7 @@ struct CoordEntry<std::complex<TScalar>>
 {
     static bool
     Read(
-        const std::vector<std::string>& tokens,
+        const Tokens& tokens,
         std::size_t& row,
         std::size_t& col,
         std::complex<TScalar>& value)
@@ -128,7 +240,7 @@ struct CoordEntry<std::complex<TScalar>>
         TScalar real;
         TScalar imag;
 
-        if (tokens.size() != 4 ||
+        if (tokens.Size() != 4 ||
             !TryParse(tokens[0], row) ||
             !TryParse(tokens[1], col) ||
             !TryParse(tokens[2], real) ||
@@ -144,16 +256,38 @@ struct CoordEntry<std::complex<TScalar>>
         return true;
     }
 
+    static const std::size_t MaxLength = 4 * NumberFormatter::MaxLength;
+
+    static char*
+    Format(
+        char* pos,
+        const std::size_t row,
+        const std::size_t col,
+        const std::complex<TScalar>& value)
+    {
+        pos = NumberFormatter::Format(pos, row + 1);
+        *pos++ = ' ';
+        pos = NumberFormatter::Format(pos, col + 1);
+        *pos++ = ' ';
+        pos = NumberFormatter::Format(pos, value.real());
+        *pos++ = ' ';
+        pos = NumberFormatter::Format(pos, value.imag());
+        *pos++ = '\n';
+
+        return pos;
+    }
+
     template <typename TStream>
     static void
     Write(
         TStream& stream,
-        std::size_t& row,
-        std::size_t& col,
+        const std::size_t row,
+        const std::size_t col,
         const std::complex<TScalar>& value)
     {
-        stream << row << " " << col << " " << value.real() << " " <<
-            value.imag() << "\n";
+        char buffer[MaxLength];
+
+        stream.write(buffer, Format(buffer, row, col, value) - buffer);
     }
 };
 
@@ -162,10 +296,10 @@ struct ArrayEntry
 {
     static bool
     Read(
-        const std::vector<std::string>& tokens,
+        const Tokens& tokens,
         TScalar& value)
     {
-        if (tokens.size() != 1 ||
+        if (tokens.Size() != 1 ||
             !TryParse(tokens[0], value)) {
             return false;
         }
@@ -173,13 +307,28 @@ struct ArrayEntry
         return true;
     }
 
+    static const std::size_t MaxLength = NumberFormatter::MaxLength;
+
+    static char*
+    Format(
+        char* pos,
+        const TScalar& value)
+    {
+        pos = NumberFormatter::Format(pos, value);
+        *pos++ = '\n';
+
+        return pos;
+    }
+
     template <typename TStream>
     static void
     Write(
         TStream& stream,
         const TScalar& value)
     {
-        stream << value << "\n";
+        char buffer[MaxLength];
+
+        stream.write(buffer, Format(buffer, value) - buffer);
     }
 };
 
@@ -188,13 +337,13 @@ struct ArrayEntry<std::complex<TScalar>>
 {
     static bool
     Read(
-        const std::vector<std::string>& tokens,
+        const Tokens& tokens,
         std::complex<TScalar>& value)
     {
         TScalar real;
         TScalar imag;
 
-        if (tokens.size() != 2 ||
+        if (tokens.Size() != 2 ||
             !TryParse(tokens[0], real) ||
             !TryParse(tokens[1], imag)) {
             return false;
@@ -205,211 +354,303 @@ struct ArrayEntry<std::complex<TScalar>>
         return true;
     }
 
+    static const std::size_t MaxLength = 2 * NumberFormatter::MaxLength;
+
+    static char*
+    Format(
+        char* pos,
+        const std::complex<TScalar>& value)
+    {
+        pos = NumberFormatter::Format(pos, value.real());
+        *pos++ = ' ';
+        pos = NumberFormatter::Format(pos, value.imag());
+        *pos++ = '\n';
+
+        return pos;
+    }
+
     template <typename TStream>
     static void
     Write(
         TStream& stream,
         const std::complex<TScalar>& value)
     {
-        stream << value.real() << " " << value.imag() << "\n";
+        char buffer[MaxLength];
+
+        stream.write(buffer, Format(buffer, value) - buffer);
     }
 };
 
-template <typename TScalar>
-struct Precision;
-
-template <typename TScalar>
-struct Precision<typename std::complex<TScalar>>
+// Entry of a pattern matrix, which stores positions but no values
+struct PatternEntry
 {
-    static const size_t value = std::numeric_limits<TScalar>::digits10 + 2;
-};
+    static bool
+    Read(
+        const Tokens& tokens,
+        std::size_t& row,
+        std::size_t& col)
+    {
+        if (tokens.Size() != 2 ||
+            !TryParse(tokens[0], row) ||
+            !TryParse(tokens[1], col)) {
+            return false;
+        }
 
-template <typename TScalar>
-struct Precision
-{
-    static const size_t value = std::numeric_limits<TScalar>::digits10 + 2;
-};
+        row -= 1;
+        col -= 1;
 
-template <typename TMatrix>
-struct MatrixBuilder;
+        return true;
+    }
+
+    static const std::size_t MaxLength = 2 * NumberFormatter::MaxLength;
+
+    static char*
+    Format(
+        char* pos,
+        const std::size_t row,
+        const std::size_t col)
+    {
+        pos = NumberFormatter::Format(pos, row + 1);
+        *pos++ = ' ';
+        pos = NumberFormatter::Format(pos, col + 1);
+        *pos++ = '\n';
+
+        return pos;
+    }
 
-class Reader
-{
-private:
     template <typename TStream>
     static void
-    GetDataLine(
-        TStream& input,
-        std::string& line)
+    Write(
+        TStream& stream,
+        const std::size_t row,
+        const std::size_t col)
     {
-        do {
-            std::getline(input, line);
-        } while (line[0] == '%');
+        char buffer[MaxLength];
+
+        stream.write(buffer, Format(buffer, row, col) - buffer);
     }
+};
 
-    static std::vector<std::string>
-    GetTokens(
-        const std::string& line)
+// Structure-only matrices use bool as scalar type. Every stored entry of a
+// coordinate file is part of the structure, whatever its value.
+template <>
+struct CoordEntry<bool>
+{
+    static bool
+    Read(
+        const Tokens& tokens,
+        std::size_t& row,
+        std::size_t& col,
+        bool& value)
     {
-        const std::string& delimiters = "\n\r\t ";
-
-        std::vector<std::string> tokens;
+        if (tokens.Size() < 2 || tokens.Size() > 4 ||
+            !TryParse(tokens[0], row) ||
+            !TryParse(tokens[1], col)) {
+            return false;
+        }
 
-        std::string::size_type lastPos = line.find_first_not_of(delimiters, 0);
-        std::string::size_type pos = line.find_first_of(delimiters, lastPos);
+        row -= 1;
+        col -= 1;
 
-        while (std::string::npos != pos || std::string::npos != lastPos) {
-            const std::string token = line.substr(lastPos, pos - lastPos);
+        value = true;
 
-            tokens.push_back(token);
+        return true;
+    }
 
-            lastPos = line.find_first_not_of(delimiters, pos);
-            pos = line.find_first_of(delimiters, lastPos);
-        }
+    static const std::size_t MaxLength = PatternEntry::MaxLength;
 
-        return tokens;
+    static char*
+    Format(
+        char* pos,
+        const std::size_t row,
+        const std::size_t col,
+        const bool& /*value*/)
+    {
+        return PatternEntry::Format(pos, row, col);
     }
 
-public:
-    template <typename TMatrix, typename TStream>
+    template <typename TStream>
     static void
-    ReadFromStream(
-        TMatrix& matrix,
-        TStream& input)
+    Write(
+        TStream& stream,
+        const std::size_t row,
+        const std::size_t col,
+        const bool& /*value*/)
     {
-        std::string line;
-        std::vector<std::string> tokens;
-
-        // --- read banner
-
-        std::getline(input, line);
-
-        tokens = GetTokens(line);
-
-        if (tokens.size() != 5 || tokens[0] != "%%MatrixMarket" ||
-            tokens[1] != "matrix") {
-            throw std::runtime_error("MatrixMarket banner invalid");
-        }
-
-        const std::string storage = tokens[2];
-        const std::string type = tokens[3];
-        const std::string symmetry = tokens[4];
-
-        if (storage != "array" && storage != "coordinate") {
-            throw std::runtime_error("MatrixMarket storage format '" + storage
-                + "' invalid");
-        }
-
-        if (type != "pattern" && type != "integer" && type != "real"
-            && type != "complex") {
-            throw std::runtime_error("MatrixMarket data type '" + type +
-                "' invalid");
-        }
+        PatternEntry::Write(stream, row, col);
+    }
+};
 
-        if (symmetry != "general" && symmetry != "symmetric"
-            && symmetry != "hermitian" && symmetry != "skew-symmetric") {
-            throw std::runtime_error("MatrixMarket symmetry '" + symmetry
-                + "' invalid");
+// Entries of a dense array are part of the structure if they are nonzero
+template <>
+struct ArrayEntry<bool>
+{
+    static bool
+    Read(
+        const Tokens& tokens,
+        bool& value)
+    {
+        if (tokens.Size() != 1 && tokens.Size() != 2) {
+            return false;
         }
 
-        // --- read matrix size
-
-        GetDataLine(input, line);
+        value = false;
 
-        tokens = GetTokens(line);
+        for (std::size_t i = 0; i < tokens.Size(); i++) {
+            double component;
 
-        std::size_t rows;
-        std::size_t cols;
-        std::size_t nonZeros = 0;
-
-        if (storage == "array" && tokens.size() != 2) {
-            throw std::runtime_error("MatrixMarket matrix size invalid");
-        }
+            if (!TryParse(tokens[i], component)) {
+                return false;
+            }
 
-        if (storage == "coordinate" && tokens.size() != 3) {
-            throw std::runtime_error("MatrixMarket matrix size invalid");
+            value = value || component != 0;
         }
 
-        if (!TryParse(tokens[0], rows)) {
-            throw std::runtime_error("MatrixMarket matrix size invalid");
-        }
+        return true;
+    }
 
-        if (!TryParse(tokens[1], cols)) {
-            throw std::runtime_error("MatrixMarket matrix size invalid");
-        }
+    static const std::size_t MaxLength = 2;
 
-        if (storage == "coordinate" && !TryParse(tokens[2], nonZeros)) {
-            throw std::runtime_error("MatrixMarket matrix size invalid");
-        }
+    static char*
+    Format(
+        char* pos,
+        const bool& value)
+    {
+        *pos++ = value ? '1' : '0';
+        *pos++ = '\n';
 
-        // --- read entries
+        return pos;
+    }
 
-        MatrixBuilder<TMatrix> builder(matrix);
+    template <typename TStream>
+    static void
+    Write(
+        TStream& stream,
+        const bool& value)
+    {
+        char buffer[MaxLength];
 
-        using ScalarType = typename MatrixBuilder<TMatrix>::ScalarType;
+        stream.write(buffer, Format(buffer, value) - buffer);
+    }
+};
 
-        if (storage == "coordinate") {
-            builder.BeginCoordinate(rows, cols, nonZeros);
+// Metadata of a file as given by its banner and size line
+struct Header
+{
+    // "coordinate" or "array"
+    std::string storage;
 
-            std::size_t entries_read = 0;
+    // "real", "integer", "complex" or "pattern"
+    std::string type;
 
-            while (entries_read < nonZeros && !input.eof()) {
-                GetDataLine(input, line);
+    // "general", "symmetric", "skew-symmetric" or "hermitian"
+    std::string symmetry;
 
-                tokens = GetTokens(line);
+    std::size_t rows;
+    std::size_t cols;
 
-                std::size_t row;
-                std::size_t col;
-                ScalarType value;
+    // number of entries in a coordinate file, 0 for array storage
+    std::size_t nonZeros;
+};
 
-                if (!CoordEntry<ScalarType>::Read(tokens, row, col, value)) {
-                    throw std::runtime_error("MatrixMarket invalid value");
-                }
+enum class Symmetry
+{
+    General,
+    Symmetric,
+    SkewSymmetric,
+    Hermitian
+};
 
-                builder.SetValue(row, col, value);
+static inline Symmetry
+GetSymmetry(
+    const Header& header)
+{
+    if (header.symmetry == "symmetric") {
+        return Symmetry::Symmetric;
+    } else if (header.symmetry == "skew-symmetric") {
+        return Symmetry::SkewSymmetric;
+    } else if (header.symmetry == "hermitian") {
+        return Symmetry::Hermitian;
+    } else {
+        return Symmetry::General;
+    }
+}
 
-                entries_read += 1;
-            }
+template <typename TScalar>
+static inline TScalar
+Conjugate(
+    const TScalar& value)
+{
+    return value;
+}
 
-            builder.EndCoordinate();
-        } else { // storage == "array"
-            builder.BeginArray(rows, cols);
+template <typename TScalar>
+static inline std::complex<TScalar>
+Conjugate(
+    const std::complex<TScalar>& value)
+{
+    return std::conj(value);
+}
 
-            for (std::size_t col = 0; col < cols && !input.eof(); col++) {
-                for (std::size_t row = 0; row < rows && !input.eof(); row++) {
-                    GetDataLine(input, line);
+// Returns the value of the entry (j, i) given the entry (i, j)
+template <typename TScalar>
+static inline TScalar
+Mirror(
+    const TScalar& value,
+    const Symmetry symmetry)
+{
+    switch (symmetry) {
+    case Symmetry::SkewSymmetric:
+        return -value;
+    case Symmetry::Hermitian:
+        return Conjugate(value);
+    default:
+        return value;
+    }
+}
 
-                    tokens = GetTokens(line);
+// Completes a square dense matrix whose lower triangle is set by copying it
+// to the upper triangle. The matrix is processed in square blocks, so the
+// column-wise reads and row-wise writes of a block both stay in cache.
+template <typename TMatrix>
+static void
+MirrorLowerTriangle(
+    TMatrix& matrix,
+    const std::size_t size,
+    const Symmetry symmetry)
+{
+    const std::size_t blockSize = 64;
 
-                    ScalarType value;
+    for (std::size_t colBlock = 0; colBlock < size; colBlock += blockSize) {
+        const std::size_t colEnd = std::min(colBlock + blockSize, size);
 
-                    if (!ArrayEntry<ScalarType>::Read(tokens, value)) {
-                        throw std::runtime_error("MatrixMarket invalid value");
-                    }
+        for (std::size_t rowBlock = colBlock; rowBlock < size;
+             rowBlock += blockSize) {
+            const std::size_t rowEnd = std::min(rowBlock + blockSize, size);
 
-                    builder.SetValue(row, col, value);
+            for (std::size_t col = colBlock; col < colEnd; col++) {
+                for (std::size_t row = std::max(rowBlock, col + 1);
+                     row < rowEnd; row++) {
+                    matrix(col, row) = Mirror(matrix(row, col), symmetry);
                 }
             }
-
-            builder.EndArray();
         }
     }
 
-    template <typename TMatrix>
-    static void
-    ReadFromFile(
-        TMatrix& matrix,
-        const std::string& filename)
-    {
-        std::ifstream file(filename.c_str());
-
-        if (!file) {
-            throw std::runtime_error("Invalid file");
+    if (symmetry == Symmetry::SkewSymmetric) {
+        for (std::size_t i = 0; i < size; i++) {
+            matrix(i, i) = 0;
         }
-
-        ReadFromStream(matrix, file);
     }
-}; // class Reader
+}
+
+template <typename TScalar>
+struct CoordTriplet
+{
+    std::size_t row;
+    std::size_t col;
+    TScalar value;
+};
 
 template <class T>
 struct is_complex : public std::false_type { };
@@ -417,65 +658,3506 @@ struct is_complex : public std::false_type { };
 template <class T>
 struct is_complex<std::complex<T>> : public std::true_type { };
 
-class Writer
+// Identifies the kind of a scalar type in binary files: 0 real, 1 integer,
+// 2 complex and 3 pattern
+template <typename TScalar>
+static std::uint32_t
+ScalarKind()
 {
-public:
-    template <typename TMatrix, typename TStream>
-    static void
-    WriteToStream(
+    if (std::is_same<TScalar, bool>::value) {
+        return 3;
+    } else if (is_complex<TScalar>::value) {
+        return 2;
+    } else if (std::is_integral<TScalar>::value) {
+        return 1;
+    } else {
+        return 0;
+    }
+}
+
+template <typename TMatrix>
+struct MatrixBuilder;
+
+// Builders that can assemble compressed storage in two passes provide
+// BeginCompressed, CountEntry, EndCount, FillEntry and EndCompressed.
+template <typename TBuilder>
+struct HasCompressedAssembly
+{
+private:
+    template <typename T>
+    static std::true_type
+    Check(decltype(&T::CountEntry));
+
+    template <typename T>
+    static std::false_type
+    Check(...);
+
+public:
+    using type = decltype(Check<TBuilder>(nullptr));
+
+    static const bool value = type::value;
+};
+
+// Dense builders can provide MirrorTriangle to complete a matrix from its
+// lower triangle in a single pass at the end of the read.
+template <typename TBuilder>
+struct HasMirrorTriangle
+{
+private:
+    template <typename T>
+    static std::true_type
+    Check(decltype(&T::MirrorTriangle));
+
+    template <typename T>
+    static std::false_type
+    Check(...);
+
+public:
+    using type = decltype(Check<TBuilder>(nullptr));
+
+    static const bool value = type::value;
+};
+
+// Sparse builders provide OuterSize and ForEachNonZero(matrix, outerBegin,
+// outerEnd, function) to visit the stored entries of the outer vectors in
+// [outerBegin, outerEnd) in storage order.
+template <typename TBuilder>
+struct HasForEachNonZero
+{
+private:
+    template <typename T>
+    static std::true_type
+    Check(decltype(&T::OuterSize));
+
+    template <typename T>
+    static std::false_type
+    Check(...);
+
+public:
+    using type = decltype(Check<TBuilder>(nullptr));
+
+    static const bool value = type::value;
+};
+
+// Builders of matrices that can be written provide Rows, Cols and
+// GetValue. Only their matrices can be kept in the binary cache.
+template <typename TBuilder>
+struct HasGetValue
+{
+private:
+    template <typename T>
+    static std::true_type
+    Check(decltype(&T::GetValue));
+
+    template <typename T>
+    static std::false_type
+    Check(...);
+
+public:
+    using type = decltype(Check<TBuilder>(nullptr));
+
+    static const bool value = type::value;
+};
+
+// Forwards entries to a builder and expands symmetric, skew-symmetric and
+// hermitian storage. Builders with MirrorTriangle only receive entries of
+// the lower triangle and complete the matrix in End*. All other builders
+// receive every off-diagonal entry a second time at the mirrored position.
+template <typename TBuilder>
+class SymmetricBuilder
+{
+private:
+    using ScalarType = typename TBuilder::ScalarType;
+
+    TBuilder& m_builder;
+    Symmetry m_symmetry;
+
+    bool
+    MirrorsTriangle() const
+    {
+        return m_symmetry != Symmetry::General &&
+            HasMirrorTriangle<TBuilder>::value;
+    }
+
+    bool
+    MirrorsEntries() const
+    {
+        return m_symmetry != Symmetry::General &&
+            !HasMirrorTriangle<TBuilder>::value;
+    }
+
+    void
+    MirrorTriangle(
+        std::true_type)
+    {
+        m_builder.MirrorTriangle(m_symmetry);
+    }
+
+    void
+    MirrorTriangle(
+        std::false_type)
+    {
+    }
+
+public:
+    SymmetricBuilder(
+        TBuilder& builder,
+        const Symmetry symmetry)
+        : m_builder(builder)
+        , m_symmetry(symmetry)
+    {
+    }
+
+    void
+    BeginCoordinate(
+        const std::size_t& rows,
+        const std::size_t& cols,
+        const std::size_t& nonZeros)
+    {
+        m_builder.BeginCoordinate(rows, cols, MirrorsEntries() ?
+            2 * nonZeros : nonZeros);
+    }
+
+    void
+    EndCoordinate()
+    {
+        if (MirrorsTriangle()) {
+            MirrorTriangle(typename HasMirrorTriangle<TBuilder>::type());
+        }
+
+        m_builder.EndCoordinate();
+    }
+
+    void
+    BeginArray(
+        const std::size_t& rows,
+        const std::size_t& cols)
+    {
+        m_builder.BeginArray(rows, cols);
+    }
+
+    void
+    EndArray()
+    {
+        if (MirrorsTriangle()) {
+            MirrorTriangle(typename HasMirrorTriangle<TBuilder>::type());
+        }
+
+        m_builder.EndArray();
+    }
+
+    void
+    SetValue(
+        const std::size_t& row,
+        const std::size_t& col,
+        const ScalarType& value)
+    {
+        if (MirrorsTriangle() && row < col) {
+            m_builder.SetValue(col, row, Mirror(value, m_symmetry));
+            return;
+        }
+
+        m_builder.SetValue(row, col, value);
+
+        if (MirrorsEntries() && row != col) {
+            m_builder.SetValue(col, row, Mirror(value, m_symmetry));
+        }
+    }
+
+    void
+    BeginCompressed(
+        const std::size_t& rows,
+        const std::size_t& cols,
+        const std::size_t& nonZeros)
+    {
+        m_builder.BeginCompressed(rows, cols, nonZeros);
+    }
+
+    void
+    CountEntry(
+        const std::size_t& row,
+        const std::size_t& col)
+    {
+        m_builder.CountEntry(row, col);
+
+        if (m_symmetry != Symmetry::General && row != col) {
+            m_builder.CountEntry(col, row);
+        }
+    }
+
+    void
+    EndCount()
+    {
+        m_builder.EndCount();
+    }
+
+    void
+    FillEntry(
+        const std::size_t& row,
+        const std::size_t& col,
+        const ScalarType& value)
+    {
+        m_builder.FillEntry(row, col, value);
+
+        if (m_symmetry != Symmetry::General && row != col) {
+            m_builder.FillEntry(col, row, Mirror(value, m_symmetry));
+        }
+    }
+
+    void
+    EndCompressed()
+    {
+        m_builder.EndCompressed();
+    }
+};
+
+// The rows [rowBegin, rowEnd) and the columns [colBegin, colEnd) of a matrix
+struct Block
+{
+    std::size_t rowBegin;
+    std::size_t rowEnd;
+    std::size_t colBegin;
+    std::size_t colEnd;
+
+    std::size_t
+    Rows() const
+    {
+        return rowEnd - rowBegin;
+    }
+
+    std::size_t
+    Cols() const
+    {
+        return colEnd - colBegin;
+    }
+
+    bool
+    Contains(
+        const std::size_t row,
+        const std::size_t col) const
+    {
+        return row >= rowBegin && row < rowEnd && col >= colBegin &&
+            col < colEnd;
+    }
+};
+
+// Forwards only the entries inside a block to a builder. The indices are
+// shifted so the block starts at (0, 0) and the matrix has the size of the
+// block.
+template <typename TBuilder>
+class BlockBuilder
+{
+public:
+    using ScalarType = typename TBuilder::ScalarType;
+
+private:
+    TBuilder& m_builder;
+    Block m_block;
+
+    // Assumes the entries are spread evenly over the matrix
+    std::size_t
+    EstimateNonZeros(
+        const std::size_t& rows,
+        const std::size_t& cols,
+        const std::size_t& nonZeros) const
+    {
+        if (rows == 0 || cols == 0) {
+            return 0;
+        }
+
+        return std::size_t(double(nonZeros) * m_block.Rows() / rows *
+            m_block.Cols() / cols) + 1;
+    }
+
+public:
+    BlockBuilder(
+        TBuilder& builder,
+        const Block& block)
+        : m_builder(builder)
+        , m_block(block)
+    {
+    }
+
+    void
+    BeginCoordinate(
+        const std::size_t& rows,
+        const std::size_t& cols,
+        const std::size_t& nonZeros)
+    {
+        m_builder.BeginCoordinate(m_block.Rows(), m_block.Cols(),
+            EstimateNonZeros(rows, cols, nonZeros));
+    }
+
+    void
+    EndCoordinate()
+    {
+        m_builder.EndCoordinate();
+    }
+
+    // Mirrored entries may arrive in any order, and the diagonal of a
+    // skew-symmetric file is not stored at all. The block is therefore
+    // started as coordinate matrix, which has no entries yet.
+    void
+    BeginArray(
+        const std::size_t& /*rows*/,
+        const std::size_t& /*cols*/)
+    {
+        m_builder.BeginCoordinate(m_block.Rows(), m_block.Cols(),
+            m_block.Rows() * m_block.Cols());
+    }
+
+    void
+    EndArray()
+    {
+        m_builder.EndCoordinate();
+    }
+
+    void
+    SetValue(
+        const std::size_t& row,
+        const std::size_t& col,
+        const ScalarType& value)
+    {
+        if (m_block.Contains(row, col)) {
+            m_builder.SetValue(row - m_block.rowBegin, col - m_block.colBegin,
+                value);
+        }
+    }
+
+    void
+    BeginCompressed(
+        const std::size_t& rows,
+        const std::size_t& cols,
+        const std::size_t& nonZeros)
+    {
+        m_builder.BeginCompressed(m_block.Rows(), m_block.Cols(),
+            EstimateNonZeros(rows, cols, nonZeros));
+    }
+
+    void
+    CountEntry(
+        const std::size_t& row,
+        const std::size_t& col)
+    {
+        if (m_block.Contains(row, col)) {
+            m_builder.CountEntry(row - m_block.rowBegin,
+                col - m_block.colBegin);
+        }
+    }
+
+    void
+    EndCount()
+    {
+        m_builder.EndCount();
+    }
+
+    void
+    FillEntry(
+        const std::size_t& row,
+        const std::size_t& col,
+        const ScalarType& value)
+    {
+        if (m_block.Contains(row, col)) {
+            m_builder.FillEntry(row - m_block.rowBegin,
+                col - m_block.colBegin, value);
+        }
+    }
+
+    void
+    EndCompressed()
+    {
+        m_builder.EndCompressed();
+    }
+};
+
+// A block supports compressed assembly if the underlying builder does
+template <typename TBuilder>
+struct HasCompressedAssembly<BlockBuilder<TBuilder>>
+    : public HasCompressedAssembly<TBuilder>
+{
+};
+
+// Sparse builders can provide SlotCount, FindSlot, IsSlot and ValuePtr to
+// address the stored values of a matrix directly. FindSlot returns the
+// position of (row, col) in the value array, or SlotCount if the entry is
+// not stored.
+template <typename TBuilder>
+struct HasValueSlots
+{
+private:
+    template <typename T>
+    static std::true_type
+    Check(decltype(&T::FindSlot));
+
+    template <typename T>
+    static std::false_type
+    Check(...);
+
+public:
+    using type = decltype(Check<TBuilder>(nullptr));
+
+    static const bool value = type::value;
+};
+
+// Position in the value array for every entry of a file, in the order of
+// the file and including mirrored entries. Filled by the first call of
+// Reader::ReadValuesInto and reused while the entries of later files arrive
+// in the same order.
+struct ValueSlots
+{
+    std::vector<std::size_t> slots;
+};
+
+// Used as matrix type to overwrite the values of a matrix without changing
+// its pattern
+template <typename TMatrix>
+struct ValueTarget
+{
+    TMatrix& matrix;
+    ValueSlots& slots;
+
+    // set if the file does not follow the cached slots
+    bool stale;
+};
+
+template <typename TMatrix>
+struct MatrixBuilder<ValueTarget<TMatrix>>
+{
+    using Builder = MatrixBuilder<TMatrix>;
+
+    using ScalarType = typename Builder::ScalarType;
+
+    ValueTarget<TMatrix>& m_target;
+
+    ScalarType* m_values;
+    std::size_t m_slotCount;
+
+    // number of entries received so far
+    std::size_t m_entry;
+
+    // whether the cached slots are checked instead of searched
+    bool m_cached;
+
+    MatrixBuilder(
+        ValueTarget<TMatrix>& target)
+        : m_target(target)
+        , m_values(Builder::ValuePtr(target.matrix))
+        , m_slotCount(Builder::SlotCount(target.matrix))
+        , m_entry(0)
+        , m_cached(!target.slots.slots.empty())
+    {
+    }
+
+    static void
+    Mismatch()
+    {
+        throw std::runtime_error("MatrixMarket structure does not match the "
+            "matrix");
+    }
+
+    void
+    BeginCoordinate(
+        const std::size_t& rows,
+        const std::size_t& cols,
+        const std::size_t& nonZeros)
+    {
+        if (rows != Builder::Rows(m_target.matrix) ||
+            cols != Builder::Cols(m_target.matrix)) {
+            Mismatch();
+        }
+
+        std::fill(m_values, m_values + m_slotCount, ScalarType(0));
+
+        if (!m_cached) {
+            m_target.slots.slots.reserve(nonZeros);
+        }
+    }
+
+    // Every stored value has to be set by the file, otherwise the file
+    // holds a smaller pattern
+    void
+    EndCoordinate()
+    {
+        if (m_cached) {
+            if (m_entry != m_target.slots.slots.size()) {
+                m_target.stale = true;
+            }
+
+            return;
+        }
+
+        std::vector<bool> visited(m_slotCount, false);
+        std::size_t count = 0;
+
+        for (const std::size_t slot : m_target.slots.slots) {
+            if (slot != m_slotCount && !visited[slot]) {
+                visited[slot] = true;
+                count += 1;
+            }
+        }
+
+        if (count != Builder::NonZeros(m_target.matrix)) {
+            Mismatch();
+        }
+    }
+
+    void
+    BeginArray(
+        const std::size_t& rows,
+        const std::size_t& cols)
+    {
+        BeginCoordinate(rows, cols, rows * cols);
+    }
+
+    void
+    EndArray()
+    {
+        EndCoordinate();
+    }
+
+    // Zeros of an array file may lie outside of the pattern
+    void
+    SetValue(
+        const std::size_t& row,
+        const std::size_t& col,
+        const ScalarType& value)
+    {
+        const std::size_t entry = m_entry++;
+
+        if (m_cached) {
+            if (m_target.stale || entry >= m_target.slots.slots.size()) {
+                m_target.stale = true;
+                return;
+            }
+
+            const std::size_t slot = m_target.slots.slots[entry];
+
+            if (slot == m_slotCount ? value != ScalarType(0) :
+                    !Builder::IsSlot(m_target.matrix, slot, row, col)) {
+                m_target.stale = true;
+                return;
+            }
+
+            if (slot != m_slotCount) {
+                m_values[slot] += value;
+            }
+
+            return;
+        }
+
+        const std::size_t slot = Builder::FindSlot(m_target.matrix, row, col);
+
+        if (slot == m_slotCount && value != ScalarType(0)) {
+            Mismatch();
+        }
+
+        m_target.slots.slots.push_back(slot);
+
+        if (slot != m_slotCount) {
+            m_values[slot] += value;
+        }
+    }
+};
+
+// Used as matrix type to pass the entries of a file to a function instead
+// of assembling a matrix
+template <typename TScalar, typename TFunction>
+struct EntryTarget
+{
+    TFunction& function;
+};
+
+template <typename TScalar, typename TFunction>
+struct MatrixBuilder<EntryTarget<TScalar, TFunction>>
+{
+    using ScalarType = TScalar;
+
+    EntryTarget<TScalar, TFunction>& m_target;
+
+    MatrixBuilder(
+        EntryTarget<TScalar, TFunction>& target)
+        : m_target(target)
+    {
+    }
+
+    void
+    BeginCoordinate(
+        const std::size_t& /*rows*/,
+        const std::size_t& /*cols*/,
+        const std::size_t& /*nonZeros*/)
+    {
+    }
+
+    void
+    EndCoordinate()
+    {
+    }
+
+    void
+    BeginArray(
+        const std::size_t& /*rows*/,
+        const std::size_t& /*cols*/)
+    {
+    }
+
+    void
+    EndArray()
+    {
+    }
+
+    void
+    SetValue(
+        const std::size_t& row,
+        const std::size_t& col,
+        const ScalarType& value)
+    {
+        m_target.function(row, col, value);
+    }
+};
+
+// Passes the entries parsed by one thread to a function together with the
+// index of the thread
+template <typename TScalar, typename TFunction>
+struct ThreadEntryTarget
+{
+    TFunction& function;
+    std::size_t thread;
+};
+
+template <typename TScalar, typename TFunction>
+struct MatrixBuilder<ThreadEntryTarget<TScalar, TFunction>>
+{
+    using ScalarType = TScalar;
+
+    ThreadEntryTarget<TScalar, TFunction>& m_target;
+
+    MatrixBuilder(
+        ThreadEntryTarget<TScalar, TFunction>& target)
+        : m_target(target)
+    {
+    }
+
+    void
+    SetValue(
+        const std::size_t& row,
+        const std::size_t& col,
+        const ScalarType& value)
+    {
+        m_target.function(m_target.thread, row, col, value);
+    }
+};
+
+// Consecutive entries of a file, valid until the function they are passed
+// to returns
+template <typename TScalar>
+struct EntrySpan
+{
+    const CoordTriplet<TScalar>* begin;
+    const CoordTriplet<TScalar>* end;
+
+    std::size_t
+    Size() const
+    {
+        return end - begin;
+    }
+
+    const CoordTriplet<TScalar>&
+    operator[](
+        const std::size_t index) const
+    {
+        return begin[index];
+    }
+};
+
+// Used as matrix type to pass the entries of a file to a function in
+// batches of a fixed size
+template <typename TScalar, typename TFunction>
+struct BatchTarget
+{
+    TFunction& function;
+    std::size_t batchSize;
+};
+
+template <typename TScalar, typename TFunction>
+struct MatrixBuilder<BatchTarget<TScalar, TFunction>>
+{
+    using ScalarType = TScalar;
+
+    BatchTarget<TScalar, TFunction>& m_target;
+
+    std::vector<CoordTriplet<TScalar>> m_batch;
+
+    MatrixBuilder(
+        BatchTarget<TScalar, TFunction>& target)
+        : m_target(target)
+    {
+        m_batch.reserve(target.batchSize);
+    }
+
+    void
+    Flush()
+    {
+        if (!m_batch.empty()) {
+            const EntrySpan<TScalar> span = {m_batch.data(), m_batch.data() +
+                m_batch.size()};
+
+            m_target.function(span);
+
+            m_batch.clear();
+        }
+    }
+
+    void
+    BeginCoordinate(
+        const std::size_t& /*rows*/,
+        const std::size_t& /*cols*/,
+        const std::size_t& /*nonZeros*/)
+    {
+    }
+
+    void
+    EndCoordinate()
+    {
+        Flush();
+    }
+
+    void
+    BeginArray(
+        const std::size_t& /*rows*/,
+        const std::size_t& /*cols*/)
+    {
+    }
+
+    void
+    EndArray()
+    {
+        Flush();
+    }
+
+    void
+    SetValue(
+        const std::size_t& row,
+        const std::size_t& col,
+        const ScalarType& value)
+    {
+        const CoordTriplet<TScalar> entry = {row, col, value};
+
+        m_batch.push_back(entry);
+
+        if (m_batch.size() == m_target.batchSize) {
+            Flush();
+        }
+    }
+};
+
+// Reads lines from a stream into a reused buffer.
+template <typename TStream>
+class StreamLineReader
+{
+private:
+    TStream& m_input;
+    std::string m_buffer;
+    std::string& m_line;
+
+public:
+    StreamLineReader(
+        TStream& input)
+        : m_input(input)
+        , m_line(m_buffer)
+    {
+    }
+
+    // Uses a line buffer owned by the caller
+    StreamLineReader(
+        TStream& input,
+        std::string& line)
+        : m_input(input)
+        , m_line(line)
+    {
+    }
+
+    bool
+    ReadLine(
+        Token& line)
+    {
+        if (!std::getline(m_input, m_line)) {
+            return false;
+        }
+
+        line.begin = m_line.data();
+        line.end = m_line.data() + m_line.size();
+
+        return true;
+    }
+};
+
+// Reads lines directly from a range of memory, e.g. a mapped file.
+class MemoryLineReader
+{
+private:
+    const char* m_pos;
+    const char* m_end;
+
+public:
+    MemoryLineReader(
+        const char* begin,
+        const char* end)
+        : m_pos(begin)
+        , m_end(end)
+    {
+    }
+
+    bool
+    ReadLine(
+        Token& line)
+    {
+        if (m_pos == m_end) {
+            return false;
+        }
+
+        const char* newline = static_cast<const char*>(std::memchr(m_pos,
+            '\n', m_end - m_pos));
+
+        line.begin = m_pos;
+
+        if (newline == nullptr) {
+            line.end = m_end;
+            m_pos = m_end;
+        } else {
+            line.end = newline;
+            m_pos = newline + 1;
+        }
+
+        return true;
+    }
+
+    const char*
+    Position() const
+    {
+        return m_pos;
+    }
+};
+
+// Reads lines from a compressed stream. A separate thread decompresses the
+// input into a bounded queue of blocks, so decompression overlaps with
+// parsing and at most a few blocks of decompressed data exist at any time.
+class DecompressingLineReader
+{
+private:
+    static const std::size_t BlockSize = 1 << 20;
+    static const std::size_t InputSize = 1 << 18;
+    static const std::size_t MaxQueuedBlocks = 4;
+
+    using Block = std::vector<char>;
+
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::deque<Block> m_blocks;
+    std::vector<Block> m_free;
+    std::exception_ptr m_error;
+    bool m_finished;
+    bool m_stop;
+
+    Block m_block;
+    std::size_t m_pos;
+
+    // a line crossing a block boundary is assembled here
+    std::string m_carry;
+
+    std::thread m_thread;
+
+    Block
+    AcquireBlock()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        Block block;
+
+        if (!m_free.empty()) {
+            block.swap(m_free.back());
+            m_free.pop_back();
+        }
+
+        block.resize(BlockSize);
+
+        return block;
+    }
+
+    bool
+    PushBlock(
+        Block& block)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        m_changed.wait(lock, [this]() {
+            return m_blocks.size() < MaxQueuedBlocks || m_stop;
+        });
+
+        if (m_stop) {
+            return false;
+        }
+
+        m_blocks.push_back(std::move(block));
+
+        m_changed.notify_all();
+
+        return true;
+    }
+
+    template <typename TDecoder>
+    void
+    Decompress(
+        std::istream& input)
+    {
+        TDecoder decoder;
+
+        std::vector<char> buffer(InputSize);
+
+        const char* in = buffer.data();
+        const char* inEnd = buffer.data();
+
+        Block block = AcquireBlock();
+
+        char* out = block.data();
+
+        // the decoder may hold back output when the block is full, so new
+        // input is only read after it produced less than it could
+
+        bool drained = true;
+
+        while (true) {
+            if (in == inEnd && drained) {
+                input.read(buffer.data(), buffer.size());
+
+                const std::size_t count = std::size_t(input.gcount());
+
+                if (count == 0) {
+                    break;
+                }
+
+                in = buffer.data();
+                inEnd = buffer.data() + count;
+            }
+
+            decoder.Decode(in, inEnd, out, block.data() + block.size());
+
+            drained = (out != block.data() + block.size());
+
+            if (!drained) {
+                if (!PushBlock(block)) {
+                    return;
+                }
+
+                block = AcquireBlock();
+                out = block.data();
+            }
+        }
+
+        if (!decoder.AtEnd()) {
+            throw std::runtime_error("MatrixMarket compressed data truncated");
+        }
+
+        block.resize(out - block.data());
+
+        if (!block.empty()) {
+            PushBlock(block);
+        }
+    }
+
+    void
+    Run(
+        std::istream& input,
+        const Compression compression)
+    {
+        // the input is not read if no decompression library is enabled
+        static_cast<void>(input);
+
+        try {
+            switch (compression) {
+#ifdef MATRIXMERCHANT_USE_ZLIB
+            case Compression::Gzip:
+                Decompress<GzipDecoder>(input);
+                break;
+#endif
+#ifdef MATRIXMERCHANT_USE_ZSTD
+            case Compression::Zstd:
+                Decompress<ZstdDecoder>(input);
+                break;
+#endif
+            default:
+                break;
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            m_error = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_finished = true;
+
+        m_changed.notify_all();
+    }
+
+    bool
+    NextBlock()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        if (m_block.capacity() != 0) {
+            m_free.push_back(std::move(m_block));
+            m_block = Block();
+        }
+
+        m_changed.wait(lock, [this]() {
+            return !m_blocks.empty() || m_finished;
+        });
+
+        if (m_blocks.empty()) {
+            if (m_error) {
+                std::rethrow_exception(m_error);
+            }
+
+            return false;
+        }
+
+        m_block.swap(m_blocks.front());
+        m_blocks.pop_front();
+
+        m_pos = 0;
+
+        m_changed.notify_all();
+
+        return true;
+    }
+
+public:
+    DecompressingLineReader(
+        std::istream& input,
+        const Compression compression)
+        : m_finished(false)
+        , m_stop(false)
+        , m_pos(0)
+    {
+#ifndef MATRIXMERCHANT_USE_ZLIB
+        if (compression == Compression::Gzip) {
+            throw std::runtime_error("MatrixMarket gzip input requires "
+                "MATRIXMERCHANT_USE_ZLIB");
+        }
+#endif
+#ifndef MATRIXMERCHANT_USE_ZSTD
+        if (compression == Compression::Zstd) {
+            throw std::runtime_error("MatrixMarket zstd input requires "
+                "MATRIXMERCHANT_USE_ZSTD");
+        }
+#endif
+
+        m_thread = std::thread([this, &input, compression]() {
+            Run(input, compression);
+        });
+    }
+
+    DecompressingLineReader(const DecompressingLineReader&) = delete;
+
+    DecompressingLineReader&
+    operator=(const DecompressingLineReader&) = delete;
+
+    ~DecompressingLineReader()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            m_stop = true;
+        }
+
+        m_changed.notify_all();
+
+        m_thread.join();
+    }
+
+    bool
+    ReadLine(
+        Token& line)
+    {
+        m_carry.clear();
+
+        while (true) {
+            if (m_pos == m_block.size()) {
+                if (!NextBlock()) {
+                    if (m_carry.empty()) {
+                        return false;
+                    }
+
+                    line.begin = m_carry.data();
+                    line.end = m_carry.data() + m_carry.size();
+
+                    return true;
+                }
+            }
+
+            const char* begin = m_block.data() + m_pos;
+            const char* end = m_block.data() + m_block.size();
+
+            const char* newline = static_cast<const char*>(std::memchr(begin,
+                '\n', end - begin));
+
+            if (newline == nullptr) {
+                m_carry.append(begin, end);
+                m_pos = m_block.size();
+                continue;
+            }
+
+            m_pos = (newline + 1) - m_block.data();
+
+            if (m_carry.empty()) {
+                line.begin = begin;
+                line.end = newline;
+            } else {
+                m_carry.append(begin, newline);
+
+                line.begin = m_carry.data();
+                line.end = m_carry.data() + m_carry.size();
+            }
+
+            return true;
+        }
+    }
+};
+
+struct ReadOptions
+{
+    // Number of threads parsing the entries of a coordinate file. 0 selects
+    // the number of hardware threads. Compressed input is always parsed by a
+    // single thread while another one decompresses it.
+    std::size_t threads;
+
+    // Assemble compressed sparse matrices in two passes over the file: the
+    // first counts the entries per row or column, the second writes them
+    // directly into the final arrays. Peak memory stays close to the size
+    // of the matrix. Requires a regular file and a builder supporting
+    // compressed assembly, otherwise the entries are read in one pass.
+    bool twoPass;
+
+    // Keep a binary copy of the matrix next to the file (filename.cache)
+    // and read it instead of the text as long as the file is unchanged. The
+    // cache is specific to the scalar type and to sparse or dense matrices.
+    // If it cannot be written, the file is read as usual.
+    bool cache;
+
+    // Read only the rows [rowBegin, rowEnd) and the columns [colBegin,
+    // colEnd) of the file. The indices are shifted so the block starts at
+    // (0, 0) and the matrix has the size of the block. Ends beyond the size
+    // of the file are clamped. Without an index, entries outside of the
+    // block are parsed and dropped. The cache is not used for blocks.
+    std::size_t rowBegin;
+    std::size_t rowEnd;
+    std::size_t colBegin;
+    std::size_t colEnd;
+
+    // Use the chunk index next to the file (filename.index) to split the
+    // body between threads and to skip the parts of the body that hold no
+    // entry of the block. A missing or outdated index is built by scanning
+    // the body once and written for later reads. Only regular uncompressed
+    // coordinate files are indexed.
+    bool index;
+
+    // Number of entries per chunk of a new index
+    std::size_t indexStride;
+
+    // Bytes of the body parsed by each thread at once by ForEachEntry and
+    // ForEachBatch. Bounds the memory of the parsed entries.
+    std::size_t windowSize;
+
+    ReadOptions()
+        : threads(1)
+        , twoPass(false)
+        , cache(false)
+        , rowBegin(0)
+        , rowEnd(std::numeric_limits<std::size_t>::max())
+        , colBegin(0)
+        , colEnd(std::numeric_limits<std::size_t>::max())
+        , index(false)
+        , indexStride(1 << 14)
+        , windowSize(1 << 22)
+    {
+    }
+};
+
+class Reader
+{
+private:
+    template <typename TScalar>
+    struct CoordChunk
+    {
+        const char* begin;
+        const char* end;
+        std::vector<CoordTriplet<TScalar>> entries;
+        bool failed;
+
+        // Only used when entries outside of the block are dropped: the
+        // number of parsed entries, the position of every kept entry among
+        // them and the position of the first dropped one out of range
+        std::size_t count;
+        std::vector<std::size_t> positions;
+        std::size_t outOfRange;
+    };
+
+    // Chunks smaller than this are not worth a thread of their own
+    static const std::size_t MinChunkSize = 1 << 16;
+
+    struct ChunkStore
+    {
+        virtual ~ChunkStore()
+        {
+        }
+    };
+
+    template <typename TScalar>
+    struct TypedChunkStore : public ChunkStore
+    {
+        std::vector<CoordChunk<TScalar>> chunks;
+    };
+
+    // Buffers and threads used by a read. Reader objects keep their
+    // workspace, so the buffers grow during the first reads and are reused
+    // afterwards. The static functions use a new workspace for every call.
+    struct Workspace
+    {
+        // threads of the parallel reader, or nullptr to start new ones
+        ThreadPool* pool;
+
+        // body of a stream that is parsed in parallel
+        std::string body;
+
+        // line buffer of a stream
+        std::string line;
+
+        // chunks of the parallel reader for the last scalar type
+        std::unique_ptr<ChunkStore> chunks;
+
+        // bytes of the body parsed by each thread at once, or 0 to parse
+        // the whole body at once
+        std::size_t window;
+
+        Workspace()
+            : pool(nullptr)
+            , window(0)
+        {
+        }
+
+        template <typename TScalar>
+        std::vector<CoordChunk<TScalar>>&
+        Chunks()
+        {
+            TypedChunkStore<TScalar>* store =
+                dynamic_cast<TypedChunkStore<TScalar>*>(chunks.get());
+
+            if (store == nullptr) {
+                store = new TypedChunkStore<TScalar>();
+                chunks.reset(store);
+            }
+
+            return store->chunks;
+        }
+    };
+
+    // Reads the next line holding data, skipping comments and blank lines
+    template <typename TLineReader>
+    static bool
+    GetDataLine(
+        TLineReader& lines,
+        Tokens& tokens)
+    {
+        Token line;
+
+        while (lines.ReadLine(line)) {
+            if (line.begin != line.end && *line.begin == '%') {
+                continue;
+            }
+
+            Tokenize(line.begin, line.end, tokens);
+
+            if (tokens.Size() != 0) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    static void
+    CheckIndex(
+        const Header& header,
+        const std::size_t row,
+        const std::size_t col)
+    {
+        if (row >= header.rows || col >= header.cols) {
+            throw std::runtime_error("MatrixMarket index out of range");
+        }
+    }
+
+    // Pattern files carry no values. Numeric matrices store an implicit one
+    // at every position of the pattern.
+    template <typename TScalar>
+    static bool
+    ReadCoordEntry(
+        const Tokens& tokens,
+        const bool pattern,
+        std::size_t& row,
+        std::size_t& col,
+        TScalar& value)
+    {
+        if (pattern) {
+            value = TScalar(1);
+
+            return PatternEntry::Read(tokens, row, col);
+        }
+
+        return CoordEntry<TScalar>::Read(tokens, row, col, value);
+    }
+
+    template <typename TLineReader>
+    static Header
+    ParseHeader(
+        TLineReader& lines)
+    {
+        Token line;
+        Tokens tokens;
+
+        // --- read banner
+
+        if (lines.ReadLine(line)) {
+            Tokenize(line.begin, line.end, tokens);
+        }
+
+        if (tokens.Size() != 5 || tokens[0] != "%%MatrixMarket" ||
+            tokens[1] != "matrix") {
+            throw std::runtime_error("MatrixMarket banner invalid");
+        }
+
+        Header header;
+
+        header.storage = tokens[2].ToString();
+        header.type = tokens[3].ToString();
+        header.symmetry = tokens[4].ToString();
+
+        const std::string& storage = header.storage;
+        const std::string& type = header.type;
+        const std::string& symmetry = header.symmetry;
+
+        if (storage != "array" && storage != "coordinate") {
+            throw std::runtime_error("MatrixMarket storage format '" + storage
+                + "' invalid");
+        }
+
+        if (type != "pattern" && type != "integer" && type != "real"
+            && type != "complex") {
+            throw std::runtime_error("MatrixMarket data type '" + type +
+                "' invalid");
+        }
+
+        if (symmetry != "general" && symmetry != "symmetric"
+            && symmetry != "hermitian" && symmetry != "skew-symmetric") {
+            throw std::runtime_error("MatrixMarket symmetry '" + symmetry
+                + "' invalid");
+        }
+
+        if (type == "pattern" && storage != "coordinate") {
+            throw std::runtime_error("MatrixMarket pattern requires "
+                "coordinate storage");
+        }
+
+        // --- read matrix size
+
+        if (!GetDataLine(lines, tokens)) {
+            throw std::runtime_error("MatrixMarket matrix size invalid");
+        }
+
+        header.nonZeros = 0;
+
+        if (storage == "array" && tokens.Size() != 2) {
+            throw std::runtime_error("MatrixMarket matrix size invalid");
+        }
+
+        if (storage == "coordinate" && tokens.Size() != 3) {
+            throw std::runtime_error("MatrixMarket matrix size invalid");
+        }
+
+        if (!TryParse(tokens[0], header.rows)) {
+            throw std::runtime_error("MatrixMarket matrix size invalid");
+        }
+
+        if (!TryParse(tokens[1], header.cols)) {
+            throw std::runtime_error("MatrixMarket matrix size invalid");
+        }
+
+        if (storage == "coordinate" && !TryParse(tokens[2], header.nonZeros)) {
+            throw std::runtime_error("MatrixMarket matrix size invalid");
+        }
+
+        if (symmetry != "general" && header.rows != header.cols) {
+            throw std::runtime_error("MatrixMarket " + symmetry +
+                " matrix must be square");
+        }
+
+        return header;
+    }
+
+    // Selects the block of the file given by the options
+    static Block
+    GetBlock(
+        const Header& header,
+        const ReadOptions& options)
+    {
+        Block block;
+
+        block.rowBegin = options.rowBegin;
+        block.rowEnd = std::min(options.rowEnd, header.rows);
+        block.colBegin = options.colBegin;
+        block.colEnd = std::min(options.colEnd, header.cols);
+
+        if (block.rowBegin > block.rowEnd || block.colBegin > block.colEnd) {
+            throw std::runtime_error("MatrixMarket block invalid");
+        }
+
+        return block;
+    }
+
+    static bool
+    IsWhole(
+        const Header& header,
+        const Block& block)
+    {
+        return block.rowBegin == 0 && block.rowEnd == header.rows &&
+            block.colBegin == 0 && block.colEnd == header.cols;
+    }
+
+    static bool
+    SelectsBlock(
+        const ReadOptions& options)
+    {
+        return options.rowBegin != 0 || options.colBegin != 0 ||
+            options.rowEnd != std::numeric_limits<std::size_t>::max() ||
+            options.colEnd != std::numeric_limits<std::size_t>::max();
+    }
+
+    template <typename TBuilder, typename TLineReader>
+    static void
+    ReadEntries(
+        TBuilder& target,
+        const Header& header,
+        TLineReader& lines)
+    {
+        Tokens tokens;
+
+        SymmetricBuilder<TBuilder> builder(target, GetSymmetry(header));
+
+        using ScalarType = typename TBuilder::ScalarType;
+
+        const std::size_t rows = header.rows;
+        const std::size_t cols = header.cols;
+        const std::size_t nonZeros = header.nonZeros;
+
+        if (header.storage == "coordinate") {
+            const bool pattern = (header.type == "pattern");
+
+            builder.BeginCoordinate(rows, cols, nonZeros);
+
+            for (std::size_t i = 0; i < nonZeros; i++) {
+                if (!GetDataLine(lines, tokens)) {
+                    throw std::runtime_error("MatrixMarket unexpected end of "
+                        "data");
+                }
+
+                std::size_t row;
+                std::size_t col;
+                ScalarType value;
+
+                if (!ReadCoordEntry(tokens, pattern, row, col, value)) {
+                    throw std::runtime_error("MatrixMarket invalid value");
+                }
+
+                CheckIndex(header, row, col);
+
+                builder.SetValue(row, col, value);
+            }
+
+            builder.EndCoordinate();
+        } else { // storage == "array"
+            builder.BeginArray(rows, cols);
+
+            // symmetric storage holds the lower triangle, skew-symmetric
+            // storage the strict lower triangle
+
+            const Symmetry symmetry = GetSymmetry(header);
+
+            for (std::size_t col = 0; col < cols; col++) {
+                std::size_t firstRow = 0;
+
+                if (symmetry == Symmetry::SkewSymmetric) {
+                    firstRow = col + 1;
+                } else if (symmetry != Symmetry::General) {
+                    firstRow = col;
+                }
+
+                for (std::size_t row = firstRow; row < rows; row++) {
+                    if (!GetDataLine(lines, tokens)) {
+                        throw std::runtime_error("MatrixMarket unexpected end "
+                            "of data");
+                    }
+
+                    ScalarType value;
+
+                    if (!ArrayEntry<ScalarType>::Read(tokens, value)) {
+                        throw std::runtime_error("MatrixMarket invalid value");
+                    }
+
+                    builder.SetValue(row, col, value);
+                }
+            }
+
+            builder.EndArray();
+        }
+    }
+
+    // Start of the line following the position, or the end
+    static const char*
+    NextLine(
+        const char* pos,
+        const char* end)
+    {
+        const char* newline = static_cast<const char*>(std::memchr(pos, '\n',
+            end - pos));
+
+        return (newline == nullptr) ? end : newline + 1;
+    }
+
+    // Splits the body at newline boundaries into chunks that are parsed
+    // concurrently into thread-local buffers. The buffers are merged into
+    // the builder in file order, so the result is the same as for a
+    // sequential read. Entries that do not reach the block, not even
+    // mirrored, are dropped by the parsing threads. With a window in the
+    // workspace, the body is processed in windows of that many bytes per
+    // thread, which bounds the buffers independent of the file size.
+    template <typename TBuilder>
+    static void
+    ReadCoordinateParallel(
+        TBuilder& target,
+        const Header& header,
+        const char* begin,
+        const char* end,
+        const Block& block,
+        std::size_t threads,
+        const std::vector<IndexChunk>& index,
+        Workspace& workspace)
+    {
+        using ScalarType = typename TBuilder::ScalarType;
+
+        const std::size_t size = end - begin;
+
+        const std::size_t windowSize = (workspace.window == 0) ? size :
+            std::min(size, workspace.window * threads);
+
+        if (threads > windowSize / MinChunkSize) {
+            threads = std::max<std::size_t>(windowSize / MinChunkSize, 1);
+        }
+
+        const bool pattern = (header.type == "pattern");
+
+        const bool filter = !IsWhole(header, block);
+
+        const bool mirrored = (GetSymmetry(header) != Symmetry::General);
+
+        std::vector<CoordChunk<ScalarType>>& chunks =
+            workspace.Chunks<ScalarType>();
+
+        chunks.resize(threads);
+
+        SymmetricBuilder<TBuilder> builder(target, GetSymmetry(header));
+
+        builder.BeginCoordinate(header.rows, header.cols, header.nonZeros);
+
+        std::size_t entriesRead = 0;
+
+        const char* windowBegin = begin;
+
+        do {
+            const char* windowEnd = (std::size_t(end - windowBegin) <=
+                windowSize) ? end : NextLine(windowBegin + windowSize, end);
+
+            const std::size_t windowLength = windowEnd - windowBegin;
+
+            const char* chunkBegin = windowBegin;
+
+            for (std::size_t i = 0; i < threads; i++) {
+                const char* chunkEnd = windowEnd;
+
+                if (i + 1 < threads && !index.empty()) {
+                    // the first line of an indexed chunk starts a new line
+
+                    const std::size_t offset = (windowBegin - begin) +
+                        windowLength / threads * (i + 1);
+
+                    const auto next = std::lower_bound(index.begin(),
+                        index.end(), offset, [](const IndexChunk& chunk,
+                            std::size_t value) {
+                            return chunk.offset < value;
+                        });
+
+                    if (next != index.end()) {
+                        chunkEnd = std::min(std::max(begin + next->offset,
+                            chunkBegin), windowEnd);
+                    }
+                } else if (i + 1 < threads) {
+                    chunkEnd = NextLine(std::max(windowBegin + windowLength /
+                        threads * (i + 1), chunkBegin), windowEnd);
+                }
+
+                chunks[i].begin = chunkBegin;
+                chunks[i].end = chunkEnd;
+                chunks[i].entries.clear();
+                chunks[i].failed = false;
+                chunks[i].count = 0;
+                chunks[i].positions.clear();
+                chunks[i].outOfRange = std::numeric_limits<std::size_t>::max();
+
+                chunkBegin = chunkEnd;
+            }
+
+            ParallelFor(workspace.pool, threads, [&](const std::size_t i) {
+                CoordChunk<ScalarType>& chunk = chunks[i];
+
+                const std::size_t chunkSize = chunk.end - chunk.begin;
+
+                if (!filter) {
+                    chunk.entries.reserve(std::size_t(double(header.nonZeros) *
+                        chunkSize / size) + 1);
+                }
+
+                MemoryLineReader lines(chunk.begin, chunk.end);
+
+                Tokens tokens;
+
+                while (GetDataLine(lines, tokens)) {
+                    CoordTriplet<ScalarType> entry;
+
+                    if (!ReadCoordEntry(tokens, pattern, entry.row, entry.col,
+                        entry.value)) {
+                        chunk.failed = true;
+                        break;
+                    }
+
+                    if (filter) {
+                        const std::size_t position = chunk.count++;
+
+                        if (!block.Contains(entry.row, entry.col) &&
+                            !(mirrored && block.Contains(entry.col,
+                                entry.row))) {
+                            if (entry.row >= header.rows ||
+                                entry.col >= header.cols) {
+                                chunk.outOfRange = std::min(chunk.outOfRange,
+                                    position);
+                            }
+
+                            continue;
+                        }
+
+                        chunk.positions.push_back(position);
+                    }
+
+                    chunk.entries.push_back(entry);
+                }
+
+                if (!filter) {
+                    chunk.count = chunk.entries.size();
+                }
+            });
+
+            // --- merge
+
+            for (const CoordChunk<ScalarType>& chunk : chunks) {
+                // entries beyond the number given in the header are ignored
+
+                const std::size_t remaining = header.nonZeros - entriesRead;
+
+                for (std::size_t i = 0; i < chunk.entries.size(); i++) {
+                    if ((filter ? chunk.positions[i] : i) >= remaining) {
+                        break;
+                    }
+
+                    const CoordTriplet<ScalarType>& entry = chunk.entries[i];
+
+                    CheckIndex(header, entry.row, entry.col);
+
+                    builder.SetValue(entry.row, entry.col, entry.value);
+                }
+
+                if (chunk.outOfRange < remaining) {
+                    throw std::runtime_error("MatrixMarket index out of range");
+                }
+
+                entriesRead += std::min(chunk.count, remaining);
+
+                if (chunk.failed && entriesRead < header.nonZeros) {
+                    throw std::runtime_error("MatrixMarket invalid value");
+                }
+            }
+
+            windowBegin = windowEnd;
+        } while (windowBegin != end && entriesRead < header.nonZeros);
+
+        if (entriesRead < header.nonZeros) {
+            throw std::runtime_error("MatrixMarket unexpected end of data");
+        }
+
+        builder.EndCoordinate();
+    }
+
+    // Parses the entries between two line boundaries into a builder and
+    // returns their number
+    template <typename TScalar, typename TBuilder>
+    static std::size_t
+    ScanEntries(
+        TBuilder& builder,
+        const Header& header,
+        const char* begin,
+        const char* end)
+    {
+        const bool pattern = (header.type == "pattern");
+
+        MemoryLineReader lines(begin, end);
+
+        Tokens tokens;
+
+        std::size_t count = 0;
+
+        while (GetDataLine(lines, tokens)) {
+            std::size_t row;
+            std::size_t col;
+            TScalar value;
+
+            if (!ReadCoordEntry(tokens, pattern, row, col, value)) {
+                throw std::runtime_error("MatrixMarket invalid value");
+            }
+
+            CheckIndex(header, row, col);
+
+            builder.SetValue(row, col, value);
+
+            count += 1;
+        }
+
+        return count;
+    }
+
+    // Splits the body into one chunk per thread and passes the entries of a
+    // chunk to the function directly from the thread parsing it, so nothing
+    // is buffered. The entries of different threads arrive concurrently and
+    // in no particular order. As entries are consumed before the end of the
+    // body is known, a body with more entries than given in the header is
+    // rejected instead of ignoring the entries beyond.
+    template <typename TScalar, typename TFunction>
+    static void
+    ReadCoordinateConcurrent(
+        const Header& header,
+        const char* begin,
+        const char* end,
+        const Block& block,
+        std::size_t threads,
+        TFunction& function,
+        Workspace& workspace)
+    {
+        using Target = ThreadEntryTarget<TScalar, TFunction>;
+        using TargetBuilder = MatrixBuilder<Target>;
+
+        const std::size_t size = end - begin;
+
+        if (threads > size / MinChunkSize) {
+            threads = std::max<std::size_t>(size / MinChunkSize, 1);
+        }
+
+        const Symmetry symmetry = GetSymmetry(header);
+
+        std::vector<std::size_t> counts(threads, 0);
+
+        ParallelFor(workspace.pool, threads, [&](const std::size_t i) {
+            const char* chunkBegin = (i == 0) ? begin : NextLine(begin +
+                size / threads * i, end);
+            const char* chunkEnd = (i + 1 == threads) ? end : NextLine(begin +
+                size / threads * (i + 1), end);
+
+            Target target = {function, i};
+
+            TargetBuilder targetBuilder(target);
+
+            if (IsWhole(header, block)) {
+                SymmetricBuilder<TargetBuilder> builder(targetBuilder,
+                    symmetry);
+
+                counts[i] = ScanEntries<TScalar>(builder, header, chunkBegin,
+                    chunkEnd);
+            } else {
+                BlockBuilder<TargetBuilder> blockBuilder(targetBuilder, block);
+
+                SymmetricBuilder<BlockBuilder<TargetBuilder>> builder(
+                    blockBuilder, symmetry);
+
+                counts[i] = ScanEntries<TScalar>(builder, header, chunkBegin,
+                    chunkEnd);
+            }
+        });
+
+        std::size_t entriesRead = 0;
+
+        for (const std::size_t count : counts) {
+            entriesRead += count;
+        }
+
+        if (entriesRead < header.nonZeros) {
+            throw std::runtime_error("MatrixMarket unexpected end of data");
+        }
+
+        if (entriesRead > header.nonZeros) {
+            throw std::runtime_error("MatrixMarket more entries than given "
+                "in the header");
+        }
+    }
+
+    template <typename TBuilder>
+    static void
+    ReadCoordinateTwoPass(
+        TBuilder& target,
+        const Header& header,
+        const char* begin,
+        const char* end,
+        std::true_type)
+    {
+        using ScalarType = typename TBuilder::ScalarType;
+
+        SymmetricBuilder<TBuilder> builder(target, GetSymmetry(header));
+
+        builder.BeginCompressed(header.rows, header.cols, header.nonZeros);
+
+        const bool pattern = (header.type == "pattern");
+
+        Tokens tokens;
+
+        // --- count entries
+
+        MemoryLineReader countLines(begin, end);
+
+        for (std::size_t i = 0; i < header.nonZeros; i++) {
+            if (!GetDataLine(countLines, tokens)) {
+                throw std::runtime_error("MatrixMarket unexpected end of data");
+            }
+
+            std::size_t row;
+            std::size_t col;
+
+            if (tokens.Size() < 2 || !TryParse(tokens[0], row) ||
+                !TryParse(tokens[1], col)) {
+                throw std::runtime_error("MatrixMarket invalid value");
+            }
+
+            row -= 1;
+            col -= 1;
+
+            CheckIndex(header, row, col);
+
+            builder.CountEntry(row, col);
+        }
+
+        builder.EndCount();
+
+        // --- fill entries
+
+        MemoryLineReader fillLines(begin, end);
+
+        for (std::size_t i = 0; i < header.nonZeros; i++) {
+            GetDataLine(fillLines, tokens);
+
+            std::size_t row;
+            std::size_t col;
+            ScalarType value;
+
+            if (!ReadCoordEntry(tokens, pattern, row, col, value)) {
+                throw std::runtime_error("MatrixMarket invalid value");
+            }
+
+            builder.FillEntry(row, col, value);
+        }
+
+        builder.EndCompressed();
+    }
+
+    template <typename TBuilder>
+    static void
+    ReadCoordinateTwoPass(
+        TBuilder& target,
+        const Header& header,
+        const char* begin,
+        const char* end,
+        std::false_type)
+    {
+        MemoryLineReader lines(begin, end);
+
+        ReadEntries(target, header, lines);
+    }
+
+    // Whether a chunk holds entries of the block, directly or mirrored
+    static bool
+    Reaches(
+        const IndexChunk& chunk,
+        const Block& block,
+        const bool mirrored)
+    {
+        const bool rows = chunk.rowBegin < block.rowEnd &&
+            block.rowBegin < chunk.rowEnd;
+        const bool cols = chunk.colBegin < block.colEnd &&
+            block.colBegin < chunk.colEnd;
+        const bool mirroredRows = chunk.colBegin < block.rowEnd &&
+            block.rowBegin < chunk.colEnd;
+        const bool mirroredCols = chunk.rowBegin < block.colEnd &&
+            block.colBegin < chunk.rowEnd;
+
+        return (rows && cols) || (mirrored && mirroredRows && mirroredCols);
+    }
+
+    // Restricts the body to the chunks from the first to the last one
+    // reaching the block. The number of entries in the header and the
+    // chunks are adjusted to the new body.
+    static void
+    SkipChunks(
+        Header& header,
+        const Block& block,
+        const char*& begin,
+        const char*& end,
+        std::vector<IndexChunk>& chunks)
+    {
+        const bool mirrored = (GetSymmetry(header) != Symmetry::General);
+
+        std::size_t first = chunks.size();
+        std::size_t last = chunks.size();
+
+        for (std::size_t i = 0; i < chunks.size(); i++) {
+            if (Reaches(chunks[i], block, mirrored)) {
+                first = std::min(first, i);
+                last = i + 1;
+            }
+        }
+
+        if (first == chunks.size()) {
+            header.nonZeros = 0;
+            begin = end;
+            chunks.clear();
+            return;
+        }
+
+        const IndexChunk start = chunks[first];
+
+        if (last < chunks.size()) {
+            header.nonZeros = chunks[last].entry - start.entry;
+            end = begin + chunks[last].offset;
+        } else {
+            header.nonZeros -= start.entry;
+        }
+
+        begin += start.offset;
+
+        chunks.erase(chunks.begin() + last, chunks.end());
+        chunks.erase(chunks.begin(), chunks.begin() + first);
+
+        for (IndexChunk& chunk : chunks) {
+            chunk.offset -= start.offset;
+            chunk.entry -= start.entry;
+        }
+    }
+
+    // The body of a file in memory and its chunk index, if there is one
+    struct MemoryBody
+    {
+        const char* end;
+        const std::vector<IndexChunk>* chunks;
+    };
+
+    template <typename TBuilder>
+    static void
+    ReadBody(
+        TBuilder& target,
+        const Header& fileHeader,
+        MemoryLineReader& fileLines,
+        MemoryBody& body,
+        const Block& block,
+        const ReadOptions& options,
+        Workspace& workspace)
+    {
+        Header header = fileHeader;
+
+        const char* begin = fileLines.Position();
+        const char* end = body.end;
+
+        std::vector<IndexChunk> chunks;
+
+        if (body.chunks != nullptr) {
+            chunks = *body.chunks;
+
+            if (!IsWhole(header, block)) {
+                SkipChunks(header, block, begin, end, chunks);
+            }
+        }
+
+        MemoryLineReader lines(begin, end);
+
+        const std::size_t threads = ThreadCount(options.threads);
+
+        if (header.storage == "coordinate" && options.twoPass) {
+            ReadCoordinateTwoPass(target, header, begin, end,
+                typename HasCompressedAssembly<TBuilder>::type());
+        } else if (header.storage == "coordinate" && threads > 1) {
+            ReadCoordinateParallel(target, header, begin, end, block, threads,
+                chunks, workspace);
+        } else {
+            ReadEntries(target, header, lines);
+        }
+    }
+
+    template <typename TBuilder, typename TStream>
+    static void
+    ReadBody(
+        TBuilder& target,
+        const Header& header,
+        StreamLineReader<TStream>& lines,
+        TStream& input,
+        const Block& block,
+        const ReadOptions& options,
+        Workspace& workspace)
+    {
+        const std::size_t threads = ThreadCount(options.threads);
+
+        // a stream cannot be split, so the body is buffered first. With a
+        // window the memory has to stay bounded, so the stream is parsed
+        // sequentially instead.
+
+        if (header.storage == "coordinate" && threads > 1 &&
+            workspace.window == 0) {
+            std::string& body = workspace.body;
+
+            body.assign(std::istreambuf_iterator<char>(input),
+                std::istreambuf_iterator<char>());
+
+            ReadCoordinateParallel(target, header, body.data(), body.data() +
+                body.size(), block, threads, std::vector<IndexChunk>(),
+                workspace);
+        } else {
+            ReadEntries(target, header, lines);
+        }
+    }
+
+    template <typename TBuilder>
+    static void
+    ReadBody(
+        TBuilder& target,
+        const Header& header,
+        DecompressingLineReader& lines,
+        std::istream& /*input*/,
+        const Block& /*block*/,
+        const ReadOptions& /*options*/,
+        Workspace& /*workspace*/)
+    {
+        ReadEntries(target, header, lines);
+    }
+
+    // Reads the body into the matrix, or into the block of it selected by
+    // the options. The source is passed on to the ReadBody overload of the
+    // line reader.
+    template <typename TMatrix, typename TLineReader, typename TSource>
+    static void
+    ReadBody(
+        TMatrix& matrix,
+        const Header& header,
+        TLineReader& lines,
+        TSource& source,
+        const ReadOptions& options,
+        Workspace& workspace)
+    {
+        MatrixBuilder<TMatrix> builder(matrix);
+
+        const Block block = GetBlock(header, options);
+
+        if (IsWhole(header, block)) {
+            ReadBody(builder, header, lines, source, block, options,
+                workspace);
+        } else {
+            BlockBuilder<MatrixBuilder<TMatrix>> blockBuilder(builder, block);
+
+            ReadBody(blockBuilder, header, lines, source, block, options,
+                workspace);
+        }
+    }
+
+    // --- chunk index
+
+    // Checks that every chunk starts at a line holding its first entry
+    static bool
+    CheckChunks(
+        const Header& header,
+        const char* begin,
+        const char* end,
+        const std::vector<IndexChunk>& chunks)
+    {
+        if (header.nonZeros != 0 && (chunks.empty() ||
+                chunks.front().entry != 0)) {
+            return false;
+        }
+
+        Tokens tokens;
+
+        for (const IndexChunk& chunk : chunks) {
+            const char* line = begin + chunk.offset;
+
+            if (chunk.offset != 0 && line[-1] != '\n') {
+                return false;
+            }
+
+            const char* lineEnd = static_cast<const char*>(std::memchr(line,
+                '\n', end - line));
+
+            Tokenize(line, lineEnd == nullptr ? end : lineEnd, tokens);
+
+            std::size_t row;
+            std::size_t col;
+
+            if (tokens.Size() < 2 || !TryParse(tokens[0], row) ||
+                !TryParse(tokens[1], col) || row - 1 != chunk.row ||
+                col - 1 != chunk.col) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // Scans the body once and records a chunk every `stride` entries
+    static std::vector<IndexChunk>
+    BuildChunks(
+        const Header& header,
+        const char* begin,
+        const char* end,
+        const std::size_t stride)
+    {
+        IndexRecorder recorder(stride);
+
+        MemoryLineReader lines(begin, end);
+
+        Token line;
+        Tokens tokens;
+
+        for (std::size_t i = 0; i < header.nonZeros; ) {
+            if (!lines.ReadLine(line)) {
+                throw std::runtime_error("MatrixMarket unexpected end of data");
+            }
+
+            if (line.begin != line.end && *line.begin == '%') {
+                continue;
+            }
+
+            Tokenize(line.begin, line.end, tokens);
+
+            if (tokens.Size() == 0) {
+                continue;
+            }
+
+            std::size_t row;
+            std::size_t col;
+
+            if (tokens.Size() < 2 || !TryParse(tokens[0], row) ||
+                !TryParse(tokens[1], col)) {
+                throw std::runtime_error("MatrixMarket invalid value");
+            }
+
+            CheckIndex(header, row - 1, col - 1);
+
+            recorder.Add(line.begin - begin, row - 1, col - 1);
+
+            i += 1;
+        }
+
+        return recorder.Chunks();
+    }
+
+    template <typename TMatrix>
+    static void
+    ReadFromMemory(
+        TMatrix& matrix,
+        const char* begin,
+        const char* end,
+        const ReadOptions& options,
+        Workspace& workspace)
+    {
+        MemoryLineReader lines(begin, end);
+
+        const Header header = ParseHeader(lines);
+
+        MemoryBody body = {end, nullptr};
+
+        ReadBody(matrix, header, lines, body, options, workspace);
+    }
+
+    // Reads a mapped file with its chunk index. A missing or outdated index
+    // is built first and written next to the file.
+    template <typename TMatrix>
+    static void
+    ReadFromMemoryIndexed(
+        TMatrix& matrix,
+        const std::string& filename,
+        const char* begin,
+        const char* end,
+        const ReadOptions& options,
+        Workspace& workspace)
+    {
+        MemoryLineReader lines(begin, end);
+
+        const Header header = ParseHeader(lines);
+
+        if (header.storage != "coordinate") {
+            MemoryBody body = {end, nullptr};
+
+            ReadBody(matrix, header, lines, body, options, workspace);
+
+            return;
+        }
+
+        const char* bodyBegin = lines.Position();
+
+        std::vector<IndexChunk> chunks;
+
+        if (!ReadIndexFile(filename, header.nonZeros, end - bodyBegin,
+                chunks) || !CheckChunks(header, bodyBegin, end, chunks)) {
+            chunks = BuildChunks(header, bodyBegin, end, options.indexStride);
+
+            WriteIndexFile(filename, header.nonZeros, end - bodyBegin,
+                chunks);
+        }
+
+        MemoryBody body = {end, &chunks};
+
+        ReadBody(matrix, header, lines, body, options, workspace);
+    }
+
+    // --- binary cache
+
+    template <typename TBuilder, typename TIndex>
+    static void
+    FillFromCache(
+        TBuilder& builder,
+        const CacheHeader& header,
+        const std::uint64_t* offsets,
+        const TIndex* indices,
+        const char* values,
+        std::true_type)
+    {
+        using ScalarType = typename TBuilder::ScalarType;
+
+        builder.BeginCompressed(header.rows, header.cols, header.nonZeros);
+
+        for (std::size_t row = 0; row < header.rows; row++) {
+            for (std::size_t i = offsets[row]; i < offsets[row + 1]; i++) {
+                builder.CountEntry(row, std::size_t(indices[i]));
+            }
+        }
+
+        builder.EndCount();
+
+        for (std::size_t row = 0; row < header.rows; row++) {
+            for (std::size_t i = offsets[row]; i < offsets[row + 1]; i++) {
+                ScalarType value;
+
+                std::memcpy(&value, values + i * sizeof(ScalarType),
+                    sizeof(ScalarType));
+
+                builder.FillEntry(row, std::size_t(indices[i]), value);
+            }
+        }
+
+        builder.EndCompressed();
+    }
+
+    template <typename TBuilder, typename TIndex>
+    static void
+    FillFromCache(
+        TBuilder& builder,
+        const CacheHeader& header,
+        const std::uint64_t* offsets,
+        const TIndex* indices,
+        const char* values,
+        std::false_type)
+    {
+        using ScalarType = typename TBuilder::ScalarType;
+
+        builder.BeginCoordinate(header.rows, header.cols, header.nonZeros);
+
+        for (std::size_t row = 0; row < header.rows; row++) {
+            for (std::size_t i = offsets[row]; i < offsets[row + 1]; i++) {
+                ScalarType value;
+
+                std::memcpy(&value, values + i * sizeof(ScalarType),
+                    sizeof(ScalarType));
+
+                builder.SetValue(row, std::size_t(indices[i]), value);
+            }
+        }
+
+        builder.EndCoordinate();
+    }
+
+    template <typename TMatrix, typename TIndex>
+    static bool
+    ReadSparseCache(
+        TMatrix& matrix,
+        const CacheHeader& header,
+        const char* data,
+        const std::size_t size)
+    {
+        using Builder = MatrixBuilder<TMatrix>;
+        using ScalarType = typename Builder::ScalarType;
+
+        // check the layout before anything is passed to the builder
+
+        if (header.rows >= size / sizeof(std::uint64_t) ||
+            header.nonZeros > size / (sizeof(TIndex) + sizeof(ScalarType))) {
+            return false;
+        }
+
+        const std::size_t offsetsSize = CacheAlign((header.rows + 1) *
+            sizeof(std::uint64_t));
+        const std::size_t indicesSize = CacheAlign(header.nonZeros *
+            sizeof(TIndex));
+
+        if (offsetsSize + indicesSize + header.nonZeros * sizeof(ScalarType) >
+            size) {
+            return false;
+        }
+
+        const std::uint64_t* offsets = reinterpret_cast<const std::uint64_t*>(
+            data);
+        const TIndex* indices = reinterpret_cast<const TIndex*>(data +
+            offsetsSize);
+        const char* values = data + offsetsSize + indicesSize;
+
+        if (offsets[0] != 0 || offsets[header.rows] != header.nonZeros) {
+            return false;
+        }
+
+        for (std::size_t row = 0; row < header.rows; row++) {
+            if (offsets[row] > offsets[row + 1]) {
+                return false;
+            }
+        }
+
+        for (std::size_t i = 0; i < header.nonZeros; i++) {
+            if (indices[i] >= header.cols) {
+                return false;
+            }
+        }
+
+        Builder builder(matrix);
+
+        FillFromCache(builder, header, offsets, indices, values,
+            typename HasCompressedAssembly<Builder>::type());
+
+        return true;
+    }
+
+    template <typename TMatrix>
+    static bool
+    ReadDenseCache(
+        TMatrix& matrix,
+        const CacheHeader& header,
+        const char* data,
+        const std::size_t size)
+    {
+        using Builder = MatrixBuilder<TMatrix>;
+        using ScalarType = typename Builder::ScalarType;
+
+        if (header.cols != 0 &&
+            header.rows > size / sizeof(ScalarType) / header.cols) {
+            return false;
+        }
+
+        Builder builder(matrix);
+
+        builder.BeginArray(header.rows, header.cols);
+
+        for (std::size_t col = 0; col < header.cols; col++) {
+            for (std::size_t row = 0; row < header.rows; row++) {
+                ScalarType value;
+
+                std::memcpy(&value, data, sizeof(ScalarType));
+
+                builder.SetValue(row, col, value);
+
+                data += sizeof(ScalarType);
+            }
+        }
+
+        builder.EndArray();
+
+        return true;
+    }
+
+    // Returns false without modifying the matrix if the cache does not
+    // belong to the source file or was written for another scalar type
+    template <typename TMatrix>
+    static bool
+    ReadFromCache(
+        TMatrix& matrix,
+        const char* data,
+        const std::size_t size,
+        const SourceStamp& source)
+    {
+        using Builder = MatrixBuilder<TMatrix>;
+        using ScalarType = typename Builder::ScalarType;
+
+        if (size < sizeof(CacheHeader)) {
+            return false;
+        }
+
+        CacheHeader header;
+
+        std::memcpy(&header, data, sizeof(CacheHeader));
+
+        if (!header.IsValid() || header.source != source ||
+            header.scalarKind != ScalarKind<ScalarType>() ||
+            header.scalarSize != sizeof(ScalarType) ||
+            header.sparse != HasForEachNonZero<Builder>::value) {
+            return false;
+        }
+
+        data += sizeof(CacheHeader);
+
+        const std::size_t available = size - sizeof(CacheHeader);
+
+        if (!header.sparse) {
+            return ReadDenseCache(matrix, header, data, available);
+        } else if (header.indexSize == sizeof(std::uint32_t)) {
+            return ReadSparseCache<TMatrix, std::uint32_t>(matrix, header,
+                data, available);
+        } else if (header.indexSize == sizeof(std::uint64_t)) {
+            return ReadSparseCache<TMatrix, std::uint64_t>(matrix, header,
+                data, available);
+        }
+
+        return false;
+    }
+
+    template <typename TMatrix>
+    static CacheHeader
+    MakeCacheHeader(
+        const TMatrix& matrix,
+        const SourceStamp& source)
+    {
+        using Builder = MatrixBuilder<TMatrix>;
+        using ScalarType = typename Builder::ScalarType;
+
+        CacheHeader header;
+
+        header.source = source;
+        header.scalarKind = ScalarKind<ScalarType>();
+        header.scalarSize = sizeof(ScalarType);
+        header.sparse = HasForEachNonZero<Builder>::value;
+        header.rows = Builder::Rows(matrix);
+        header.cols = Builder::Cols(matrix);
+
+        return header;
+    }
+
+    // Converts the stored entries to compressed row storage, independent of
+    // the storage order of the matrix
+    template <typename TMatrix, typename TIndex>
+    static void
+    WriteSparseCache(
+        const TMatrix& matrix,
+        const std::string& path,
+        CacheHeader header)
+    {
+        using Builder = MatrixBuilder<TMatrix>;
+        using ScalarType = typename Builder::ScalarType;
+
+        const std::size_t outerSize = Builder::OuterSize(matrix);
+
+        std::vector<std::uint64_t> offsets(header.rows + 1, 0);
+
+        Builder::ForEachNonZero(matrix, 0, outerSize,
+            [&](const std::size_t row, const std::size_t /*col*/,
+                const ScalarType& /*value*/) {
+                offsets[row + 1] += 1;
+            });
+
+        for (std::size_t row = 0; row < header.rows; row++) {
+            offsets[row + 1] += offsets[row];
+        }
+
+        header.indexSize = sizeof(TIndex);
+        header.nonZeros = offsets[header.rows];
+
+        std::vector<TIndex> indices(header.nonZeros);
+        std::vector<char> values(header.nonZeros * sizeof(ScalarType));
+
+        std::vector<std::uint64_t> next(offsets.begin(), offsets.end() - 1);
+
+        Builder::ForEachNonZero(matrix, 0, outerSize,
+            [&](const std::size_t row, const std::size_t col,
+                const ScalarType& value) {
+                const std::size_t i = next[row]++;
+
+                indices[i] = TIndex(col);
+
+                std::memcpy(&values[i * sizeof(ScalarType)], &value,
+                    sizeof(ScalarType));
+            });
+
+        WriteCacheFile(path, header, {
+            {offsets.data(), offsets.size() * sizeof(std::uint64_t)},
+            {indices.data(), indices.size() * sizeof(TIndex)},
+            {values.data(), values.size()}});
+    }
+
+    template <typename TMatrix>
+    static void
+    WriteToCache(
+        const TMatrix& matrix,
+        const std::string& path,
+        const SourceStamp& source,
+        std::true_type)
+    {
+        const CacheHeader header = MakeCacheHeader(matrix, source);
+
+        if (header.cols <= std::numeric_limits<std::uint32_t>::max()) {
+            WriteSparseCache<TMatrix, std::uint32_t>(matrix, path, header);
+        } else {
+            WriteSparseCache<TMatrix, std::uint64_t>(matrix, path, header);
+        }
+    }
+
+    template <typename TMatrix>
+    static void
+    WriteToCache(
+        const TMatrix& matrix,
+        const std::string& path,
+        const SourceStamp& source,
+        std::false_type)
+    {
+        using Builder = MatrixBuilder<TMatrix>;
+        using ScalarType = typename Builder::ScalarType;
+
+        const CacheHeader header = MakeCacheHeader(matrix, source);
+
+        std::vector<char> values(header.rows * header.cols *
+            sizeof(ScalarType));
+
+        char* pos = values.data();
+
+        for (std::size_t col = 0; col < header.cols; col++) {
+            for (std::size_t row = 0; row < header.rows; row++) {
+                const ScalarType value = Builder::GetValue(matrix, row, col);
+
+                std::memcpy(pos, &value, sizeof(ScalarType));
+
+                pos += sizeof(ScalarType);
+            }
+        }
+
+        WriteCacheFile(path, header, {{values.data(), values.size()}});
+    }
+
+    // Reads from the binary cache next to the file if it is up to date.
+    // Otherwise the text is parsed and the cache is written for the next
+    // read.
+    template <typename TMatrix>
+    static void
+    ReadFromFileCached(
+        TMatrix& matrix,
+        const std::string& filename,
+        const ReadOptions& options,
+        Workspace& workspace,
+        std::true_type)
+    {
+        ReadOptions uncached(options);
+        uncached.cache = false;
+
+        SourceStamp source;
+
+        if (!GetSourceStamp(filename, source)) {
+            ReadFile(matrix, filename, uncached, workspace);
+            return;
+        }
+
+        const std::string cachePath = CachePath(filename);
+
+        {
+            MappedFile cache(cachePath);
+
+            if (cache.IsMapped() && ReadFromCache(matrix, cache.Data(),
+                    cache.Size(), source)) {
+                return;
+            }
+        }
+
+        ReadFile(matrix, filename, uncached, workspace);
+
+        WriteToCache(matrix, cachePath, source,
+            typename HasForEachNonZero<MatrixBuilder<TMatrix>>::type());
+    }
+
+    // Matrices that cannot be read back are never cached
+    template <typename TMatrix>
+    static void
+    ReadFromFileCached(
+        TMatrix& matrix,
+        const std::string& filename,
+        const ReadOptions& options,
+        Workspace& workspace,
+        std::false_type)
+    {
+        ReadOptions uncached(options);
+        uncached.cache = false;
+
+        ReadFile(matrix, filename, uncached, workspace);
+    }
+
+    template <typename TMatrix, typename TStream>
+    static void
+    ReadStream(
+        TMatrix& matrix,
+        TStream& input,
+        const ReadOptions& options,
+        Workspace& workspace)
+    {
+        const Compression compression = DetectCompression(input.peek());
+
+        if (compression != Compression::None) {
+            DecompressingLineReader lines(input, compression);
+
+            const Header header = ParseHeader(lines);
+
+            ReadBody(matrix, header, lines, input, options, workspace);
+
+            return;
+        }
+
+        StreamLineReader<TStream> lines(input, workspace.line);
+
+        const Header header = ParseHeader(lines);
+
+        ReadBody(matrix, header, lines, input, options, workspace);
+    }
+
+    template <typename TMatrix>
+    static void
+    ReadFile(
+        TMatrix& matrix,
+        const std::string& filename,
+        const ReadOptions& options,
+        Workspace& workspace)
+    {
+        if (options.cache && !SelectsBlock(options)) {
+            ReadFromFileCached(matrix, filename, options, workspace,
+                typename HasGetValue<MatrixBuilder<TMatrix>>::type());
+            return;
+        }
+
+        // regular files are scanned in place, everything else including
+        // compressed files is streamed
+
+        {
+            MappedFile mapping(filename);
+
+            if (mapping.IsMapped() &&
+                DetectCompression(*mapping.Data()) == Compression::None) {
+                if (options.index) {
+                    ReadFromMemoryIndexed(matrix, filename, mapping.Data(),
+                        mapping.Data() + mapping.Size(), options, workspace);
+                } else {
+                    ReadFromMemory(matrix, mapping.Data(), mapping.Data() +
+                        mapping.Size(), options, workspace);
+                }
+
+                return;
+            }
+        }
+
+        std::ifstream file(filename.c_str(), std::ios::binary);
+
+        if (!file) {
+            throw std::runtime_error("Invalid file");
+        }
+
+        ReadStream(matrix, file, options, workspace);
+    }
+
+    // Reads a file into a target that consumes the entries while they are
+    // parsed
+    template <typename TTarget>
+    static void
+    ReadStreaming(
+        TTarget& target,
+        const std::string& filename,
+        const ReadOptions& options)
+    {
+        ReadOptions streamOptions(options);
+        streamOptions.twoPass = false;
+        streamOptions.cache = false;
+
+        Workspace workspace;
+        workspace.window = std::max<std::size_t>(options.windowSize, 1);
+
+        ReadFile(target, filename, streamOptions, workspace);
+    }
+
+    // Collects the statistics of all entries of a file, read as TScalar
+    template <typename TScalar>
+    static MatrixStatistics
+    AnalyzeEntries(
+        const std::string& filename,
+        const Header& header,
+        const ReadOptions& options)
+    {
+        const std::size_t threads = ThreadCount(options.threads);
+
+        StatisticsCollector<TScalar> collector(header.rows, header.cols,
+            threads);
+
+        // the statistics always cover the whole matrix
+
+        ReadOptions analyzeOptions(options);
+        analyzeOptions.rowBegin = 0;
+        analyzeOptions.rowEnd = std::numeric_limits<std::size_t>::max();
+        analyzeOptions.colBegin = 0;
+        analyzeOptions.colEnd = std::numeric_limits<std::size_t>::max();
+
+        ForEachEntryConcurrent<TScalar>(filename, [&](const std::size_t thread,
+            const std::size_t row, const std::size_t col,
+            const TScalar& value) {
+            collector.Add(thread, row, col, value);
+        }, analyzeOptions);
+
+        return collector.Finish();
+    }
+
+    // --- state of Reader objects
+
+    ReadOptions m_options;
+    std::unique_ptr<ThreadPool> m_pool;
+    Workspace m_workspace;
+
+public:
+    // Reader objects read many files with the same options. They keep their
+    // buffers and, for more than one thread, a pool of threads between
+    // reads, so repeated reads allocate little beyond the matrices.
+    Reader()
+        : Reader(ReadOptions())
+    {
+    }
+
+    explicit Reader(
+        const ReadOptions& options)
+        : m_options(options)
+    {
+        const std::size_t threads = ThreadCount(options.threads);
+
+        if (threads > 1) {
+            m_pool.reset(new ThreadPool(threads));
+            m_workspace.pool = m_pool.get();
+        }
+    }
+
+    const ReadOptions&
+    Options() const
+    {
+        return m_options;
+    }
+
+    template <typename TMatrix>
+    void
+    Read(
+        TMatrix& matrix,
+        const std::string& filename)
+    {
+        ReadFile(matrix, filename, m_options, m_workspace);
+    }
+
+    template <typename TMatrix, typename TStream>
+    void
+    ReadStream(
+        TMatrix& matrix,
+        TStream& input)
+    {
+        ReadStream(matrix, input, m_options, m_workspace);
+    }
+
+    template <typename TMatrix, typename TStream>
+    static void
+    ReadFromStream(
+        TMatrix& matrix,
+        TStream& input,
+        const ReadOptions& options)
+    {
+        Workspace workspace;
+
+        ReadStream(matrix, input, options, workspace);
+    }
+
+    template <typename TMatrix, typename TStream>
+    static void
+    ReadFromStream(
+        TMatrix& matrix,
+        TStream& input)
+    {
+        ReadFromStream(matrix, input, ReadOptions());
+    }
+
+    template <typename TMatrix>
+    static void
+    ReadFromFile(
+        TMatrix& matrix,
+        const std::string& filename,
+        const ReadOptions& options)
+    {
+        Workspace workspace;
+
+        ReadFile(matrix, filename, options, workspace);
+    }
+
+    template <typename TMatrix>
+    static void
+    ReadFromFile(
+        TMatrix& matrix,
+        const std::string& filename)
+    {
+        ReadFromFile(matrix, filename, ReadOptions());
+    }
+
+    // Calls function(row, col, value) for every entry of a file without
+    // assembling a matrix. The entries arrive in file order with the
+    // indices and values a matrix would receive: symmetric storage is
+    // expanded, and only the entries of the block selected by the options
+    // are passed. With several threads the body is parsed in windows of
+    // ReadOptions::windowSize bytes per thread, so the memory stays bounded
+    // for any file size.
+    template <typename TScalar, typename TFunction>
+    static void
+    ForEachEntry(
+        const std::string& filename,
+        TFunction function,
+        const ReadOptions& options)
+    {
+        EntryTarget<TScalar, TFunction> target = {function};
+
+        ReadStreaming(target, filename, options);
+    }
+
+    template <typename TScalar, typename TFunction>
+    static void
+    ForEachEntry(
+        const std::string& filename,
+        TFunction function)
+    {
+        ForEachEntry<TScalar>(filename, function, ReadOptions());
+    }
+
+    // Like ForEachEntry, but calls function(span) with an EntrySpan of up to
+    // batchSize entries at a time
+    template <typename TScalar, typename TFunction>
+    static void
+    ForEachBatch(
+        const std::string& filename,
+        TFunction function,
+        const std::size_t batchSize,
+        const ReadOptions& options)
+    {
+        BatchTarget<TScalar, TFunction> target = {function,
+            std::max<std::size_t>(batchSize, 1)};
+
+        ReadStreaming(target, filename, options);
+    }
+
+    template <typename TScalar, typename TFunction>
+    static void
+    ForEachBatch(
+        const std::string& filename,
+        TFunction function,
+        const std::size_t batchSize)
+    {
+        ForEachBatch<TScalar>(filename, function, batchSize, ReadOptions());
+    }
+
+    // Calls function(thread, row, col, value) for every entry of a file from
+    // several threads at once, with thread in [0, ThreadCount(threads)).
+    // The function has to be safe to call concurrently for different
+    // threads, e.g. by accumulating into a buffer per thread. Regular
+    // coordinate files are split between the threads without buffering any
+    // entries. Array files and compressed files are passed by the calling
+    // thread as thread 0. Entries are expanded and selected like for
+    // ForEachEntry, but arrive in no particular order.
+    template <typename TScalar, typename TFunction>
+    static void
+    ForEachEntryConcurrent(
+        const std::string& filename,
+        TFunction function,
+        const ReadOptions& options)
+    {
+        {
+            MappedFile mapping(filename);
+
+            if (mapping.IsMapped() &&
+                DetectCompression(*mapping.Data()) == Compression::None) {
+                const char* end = mapping.Data() + mapping.Size();
+
+                MemoryLineReader lines(mapping.Data(), end);
+
+                const Header header = ParseHeader(lines);
+
+                if (header.storage == "coordinate") {
+                    Workspace workspace;
+
+                    ReadCoordinateConcurrent<TScalar>(header,
+                        lines.Position(), end, GetBlock(header, options),
+                        ThreadCount(options.threads), function, workspace);
+
+                    return;
+                }
+            }
+        }
+
+        ForEachEntry<TScalar>(filename, [&](const std::size_t row,
+            const std::size_t col, const TScalar& value) {
+            function(0, row, col, value);
+        }, options);
+    }
+
+    // Computes the statistics of a file in a single pass without assembling
+    // a matrix. The entries are parsed and accumulated by several threads
+    // like for ForEachEntryConcurrent. Complex files are analyzed with
+    // complex values, all other files with real ones.
+    static MatrixStatistics
+    Analyze(
+        const std::string& filename,
+        const ReadOptions& options)
+    {
+        const Header header = ReadHeader(filename);
+
+        if (header.type == "complex") {
+            return AnalyzeEntries<std::complex<double>>(filename, header,
+                options);
+        }
+
+        return AnalyzeEntries<double>(filename, header, options);
+    }
+
+    static MatrixStatistics
+    Analyze(
+        const std::string& filename)
+    {
+        return Analyze(filename, ReadOptions());
+    }
+
+    // Overwrites the values of a sparse matrix with the ones of a file
+    // holding the same pattern. Neither the pattern nor the value array is
+    // reallocated. The slots map the entries of the file to the value array
+    // and are kept for the next file, so later files with their entries in
+    // the same order are read without searching the pattern. Throws if the
+    // file does not match the pattern; the values are undefined then.
+    template <typename TMatrix>
+    static void
+    ReadValuesInto(
+        TMatrix& matrix,
+        const std::string& filename,
+        ValueSlots& slots,
+        const ReadOptions& options)
+    {
+        static_assert(HasValueSlots<MatrixBuilder<TMatrix>>::value,
+            "ReadValuesInto requires a builder with value slots");
+
+        ReadOptions valueOptions(options);
+        valueOptions.twoPass = false;
+        valueOptions.cache = false;
+        valueOptions.rowBegin = 0;
+        valueOptions.rowEnd = std::numeric_limits<std::size_t>::max();
+        valueOptions.colBegin = 0;
+        valueOptions.colEnd = std::numeric_limits<std::size_t>::max();
+
+        ValueTarget<TMatrix> target = {matrix, slots, false};
+
+        ReadFromFile(target, filename, valueOptions);
+
+        if (target.stale) {
+            // the entries are in another order, so the slots are searched
+            // again
+
+            slots.slots.clear();
+            target.stale = false;
+
+            ReadFromFile(target, filename, valueOptions);
+        }
+    }
+
+    template <typename TMatrix>
+    static void
+    ReadValuesInto(
+        TMatrix& matrix,
+        const std::string& filename,
+        ValueSlots& slots)
+    {
+        ReadValuesInto(matrix, filename, slots, ReadOptions());
+    }
+
+    template <typename TMatrix>
+    static void
+    ReadValuesInto(
+        TMatrix& matrix,
+        const std::string& filename)
+    {
+        ValueSlots slots;
+
+        ReadValuesInto(matrix, filename, slots, ReadOptions());
+    }
+
+    // Reads only the banner, the comments and the size line of a file
+    static Header
+    ReadHeader(
+        const std::string& filename)
+    {
+        std::ifstream file(filename.c_str(), std::ios::binary);
+
+        if (!file) {
+            throw std::runtime_error("Invalid file");
+        }
+
+        const Compression compression = DetectCompression(file.peek());
+
+        if (compression != Compression::None) {
+            DecompressingLineReader lines(file, compression);
+
+            return ParseHeader(lines);
+        }
+
+        StreamLineReader<std::ifstream> lines(file);
+
+        return ParseHeader(lines);
+    }
+
+    // Reads the headers of many files concurrently. The files are handed
+    // out one at a time, so slow files do not hold up the others. If a
+    // header cannot be read, the first error is rethrown once all threads
+    // have finished.
+    static std::vector<Header>
+    ReadHeaders(
+        const std::vector<std::string>& filenames,
+        const std::size_t threads)
+    {
+        std::vector<Header> headers(filenames.size());
+
+        std::atomic<std::size_t> next(0);
+
+        ParallelFor(std::min(ThreadCount(threads), filenames.size()),
+            [&](const std::size_t) {
+                for (std::size_t i = next++; i < filenames.size();
+                     i = next++) {
+                    headers[i] = ReadHeader(filenames[i]);
+                }
+            });
+
+        return headers;
+    }
+
+    static std::vector<Header>
+    ReadHeaders(
+        const std::vector<std::string>& filenames)
+    {
+        return ReadHeaders(filenames, 0);
+    }
+}; // class Reader
+
+struct WriteOptions
+{
+    // Number of threads formatting the entries. 0 selects the number of
+    // hardware threads. The output does not depend on the number of threads.
+    std::size_t threads;
+
+    // Write a chunk index next to files in coordinate format
+    // (filename.index), see ReadOptions::index
+    bool index;
+
+    // Number of entries per chunk of the index
+    std::size_t indexStride;
+
+    WriteOptions()
+        : threads(1)
+        , index(false)
+        , indexStride(1 << 14)
+    {
+    }
+};
+
+class Writer
+{
+private:
+    // Number of entries formatted by one thread at a time
+    static const std::size_t EntriesPerPartition = 1 << 18;
+
+    template <typename TScalar>
+    static const char*
+    TypeName(
+        const bool coordinate)
+    {
+        if (is_complex<TScalar>::value) {
+            return "complex";
+        } else if (std::is_same<TScalar, bool>::value) {
+            return coordinate ? "pattern" : "integer";
+        } else if (std::is_integral<TScalar>::value) {
+            return "integer";
+        } else {
+            return "real";
+        }
+    }
+
+    template <typename TSink>
+    static void
+    WriteHeader(
+        TSink& sink,
+        const char* storage,
+        const char* type,
+        const std::size_t rows,
+        const std::size_t cols,
+        const std::size_t* nonZeros)
+    {
+        sink.Write(std::string("%%MatrixMarket matrix ") + storage + " " +
+            type + " general\n");
+
+        sink.Write(std::string("%Created by the MatrixMerchant "
+            "https://github.com/oberbichler/MatrixMerchant\n"));
+
+        char* pos = sink.Reserve(3 * NumberFormatter::MaxLength);
+
+        pos = NumberFormatter::Format(pos, rows);
+        *pos++ = ' ';
+        pos = NumberFormatter::Format(pos, cols);
+
+        if (nonZeros != nullptr) {
+            *pos++ = ' ';
+            pos = NumberFormatter::Format(pos, *nonZeros);
+        }
+
+        *pos++ = '\n';
+
+        sink.Commit(pos);
+    }
+
+    // Sparse matrices: only the stored entries in [outerBegin, outerEnd)
+    // are visited
+    template <typename TMatrix, typename TSink>
+    static void
+    WriteCoordinateEntries(
+        const TMatrix& matrix,
+        TSink& sink,
+        const std::size_t outerBegin,
+        const std::size_t outerEnd,
+        IndexRecorder* recorder,
+        std::true_type)
+    {
+        using Builder = MatrixBuilder<TMatrix>;
+        using ScalarType = typename Builder::ScalarType;
+        using Entry = CoordEntry<ScalarType>;
+
+        Builder::ForEachNonZero(matrix, outerBegin, outerEnd,
+            [&](const std::size_t row, const std::size_t col,
+                const ScalarType& value) {
+                if (recorder != nullptr) {
+                    recorder->Add(sink.Position(), row, col);
+                }
+
+                char* pos = sink.Reserve(Entry::MaxLength);
+
+                sink.Commit(Entry::Format(pos, row, col, value));
+            });
+    }
+
+    // Dense matrices: every entry of the columns [outerBegin, outerEnd) is
+    // written
+    template <typename TMatrix, typename TSink>
+    static void
+    WriteCoordinateEntries(
+        const TMatrix& matrix,
+        TSink& sink,
+        const std::size_t outerBegin,
+        const std::size_t outerEnd,
+        IndexRecorder* recorder,
+        std::false_type)
+    {
+        using Builder = MatrixBuilder<TMatrix>;
+        using ScalarType = typename Builder::ScalarType;
+        using Entry = CoordEntry<ScalarType>;
+
+        const std::size_t rows = Builder::Rows(matrix);
+
+        for (std::size_t col = outerBegin; col < outerEnd; col++) {
+            for (std::size_t row = 0; row < rows; row++) {
+                ScalarType value = Builder::GetValue(matrix, row, col);
+
+                if (recorder != nullptr) {
+                    recorder->Add(sink.Position(), row, col);
+                }
+
+                char* pos = sink.Reserve(Entry::MaxLength);
+
+                sink.Commit(Entry::Format(pos, row, col, value));
+            }
+        }
+    }
+
+    template <typename TMatrix, typename TSink>
+    static void
+    WriteArrayEntries(
+        const TMatrix& matrix,
+        TSink& sink,
+        const std::size_t outerBegin,
+        const std::size_t outerEnd)
+    {
+        using Builder = MatrixBuilder<TMatrix>;
+        using ScalarType = typename Builder::ScalarType;
+        using Entry = ArrayEntry<ScalarType>;
+
+        const std::size_t rows = Builder::Rows(matrix);
+
+        for (std::size_t col = outerBegin; col < outerEnd; col++) {
+            for (std::size_t row = 0; row < rows; row++) {
+                ScalarType value = Builder::GetValue(matrix, row, col);
+
+                char* pos = sink.Reserve(Entry::MaxLength);
+
+                sink.Commit(Entry::Format(pos, value));
+            }
+        }
+    }
+
+    // Writes the entries of the outer indices [outerBegin, outerEnd). The
+    // outer index is the column, or for sparse matrices in coordinate
+    // format the outer index of the storage. Entries in coordinate format
+    // are added to the recorder, if there is one.
+    template <typename TMatrix, typename TSink>
+    static void
+    WriteEntries(
         const TMatrix& matrix,
         const bool coordinate,
-        TStream& stream)
+        TSink& sink,
+        const std::size_t outerBegin,
+        const std::size_t outerEnd,
+        IndexRecorder* recorder)
+    {
+        if (coordinate) {
+            WriteCoordinateEntries(matrix, sink, outerBegin, outerEnd,
+                recorder,
+                typename HasForEachNonZero<MatrixBuilder<TMatrix>>::type());
+        } else {
+            WriteArrayEntries(matrix, sink, outerBegin, outerEnd);
+        }
+    }
+
+    template <typename TMatrix>
+    static std::size_t
+    OuterSize(
+        const TMatrix& matrix,
+        const bool coordinate,
+        std::true_type)
+    {
+        return coordinate ? MatrixBuilder<TMatrix>::OuterSize(matrix) :
+            MatrixBuilder<TMatrix>::Cols(matrix);
+    }
+
+    template <typename TMatrix>
+    static std::size_t
+    OuterSize(
+        const TMatrix& matrix,
+        const bool /*coordinate*/,
+        std::false_type)
+    {
+        return MatrixBuilder<TMatrix>::Cols(matrix);
+    }
+
+    // Formats the entries on several threads. Each round hands a slice of
+    // consecutive outer indices to every thread, which formats it into its
+    // own buffer. The buffers are then written in order, so the output is
+    // identical to the serial one while the memory stays bounded by the size
+    // of one round.
+    template <typename TMatrix, typename TSink>
+    static void
+    WriteEntriesParallel(
+        const TMatrix& matrix,
+        const bool coordinate,
+        TSink& sink,
+        const std::size_t entries,
+        const std::size_t threads,
+        IndexRecorder* recorder)
+    {
+        const std::size_t outerSize = OuterSize(matrix, coordinate,
+            typename HasForEachNonZero<MatrixBuilder<TMatrix>>::type());
+
+        if (outerSize == 0) {
+            return;
+        }
+
+        const std::size_t entriesPerOuter = std::max<std::size_t>(1,
+            (entries + outerSize - 1) / outerSize);
+
+        const std::size_t step = std::max<std::size_t>(1,
+            EntriesPerPartition / entriesPerOuter);
+
+        std::vector<BufferSink> buffers(threads);
+
+        // offsets of the local recorders are relative to their buffer
+
+        std::vector<IndexRecorder> recorders(threads, IndexRecorder(
+            recorder != nullptr ? recorder->Stride() : 1));
+
+        for (std::size_t begin = 0; begin < outerSize;
+             begin += threads * step) {
+            ParallelFor(threads, [&](const std::size_t i) {
+                const std::size_t outerBegin = std::min(begin + i * step,
+                    outerSize);
+                const std::size_t outerEnd = std::min(outerBegin + step,
+                    outerSize);
+
+                buffers[i].Clear();
+                recorders[i].Clear();
+
+                WriteEntries(matrix, coordinate, buffers[i], outerBegin,
+                    outerEnd, recorder != nullptr ? &recorders[i] : nullptr);
+            });
+
+            for (std::size_t i = 0; i < threads; i++) {
+                if (recorder != nullptr) {
+                    recorder->Append(recorders[i], sink.Position());
+                }
+
+                sink.Write(buffers[i].Data(), buffers[i].Size());
+            }
+        }
+    }
+
+    template <typename TMatrix, typename TSink>
+    static void
+    WriteToSink(
+        const TMatrix& matrix,
+        const bool coordinate,
+        TSink& sink,
+        const WriteOptions& options,
+        IndexRecorder* recorder)
     {
         using ScalarType = typename MatrixBuilder<TMatrix>::ScalarType;
 
-        std::size_t rows = MatrixBuilder<TMatrix>::Rows(matrix);
-        std::size_t cols = MatrixBuilder<TMatrix>::Cols(matrix);
-        std::size_t nonZeros = MatrixBuilder<TMatrix>::NonZeros(matrix);
+        const std::size_t rows = MatrixBuilder<TMatrix>::Rows(matrix);
+        const std::size_t cols = MatrixBuilder<TMatrix>::Cols(matrix);
 
-        stream << std::setprecision(Precision<ScalarType>::value);
+        const char* type = TypeName<ScalarType>(coordinate);
 
-        stream << "%%MatrixMarket matrix";
+        std::size_t entries = rows * cols;
 
         if (coordinate) {
-            stream << " coordinate";
+            entries = MatrixBuilder<TMatrix>::NonZeros(matrix);
+
+            WriteHeader(sink, "coordinate", type, rows, cols, &entries);
         } else {
-            stream << " array";
+            WriteHeader(sink, "array", type, rows, cols, nullptr);
+        }
+
+        if (recorder != nullptr) {
+            recorder->SetOrigin(sink.Position());
         }
 
-        if (!is_complex<ScalarType>::value) {
-            stream << " real";
+        const std::size_t threads = ThreadCount(options.threads);
+
+        if (threads > 1 && entries >= 2 * EntriesPerPartition) {
+            WriteEntriesParallel(matrix, coordinate, sink, entries, threads,
+                recorder);
         } else {
-            stream << " complex";
+            WriteEntries(matrix, coordinate, sink, 0, OuterSize(matrix,
+                coordinate,
+                typename HasForEachNonZero<MatrixBuilder<TMatrix>>::type()),
+                recorder);
         }
 
-        stream << " general\n";
+        sink.Flush();
+    }
 
-        stream << "%Created by the MatrixMerchant "
-                  "https://github.com/oberbichler/MatrixMerchant\n";
+public:
+    template <typename TMatrix, typename TStream>
+    static void
+    WriteToStream(
+        const TMatrix& matrix,
+        const bool coordinate,
+        TStream& stream,
+        const WriteOptions& options)
+    {
+        StreamTarget<TStream> target(stream);
+        OutputSink<StreamTarget<TStream>> sink(target);
 
-        if (coordinate) {
-            stream << rows << " " << cols << " " << nonZeros << "\n";
+        WriteToSink(matrix, coordinate, sink, options, nullptr);
+    }
 
-            for (std::size_t col = 0; col < cols; col++) {
-                for (std::size_t row = 0; row < rows; row++) {
-                    ScalarType value = MatrixBuilder<TMatrix>::GetValue(matrix,
-                        row, col);
+    template <typename TMatrix, typename TStream>
+    static void
+    WriteToStream(
+        const TMatrix& matrix,
+        const bool coordinate,
+        TStream& stream)
+    {
+        WriteToStream(matrix, coordinate, stream, WriteOptions());
+    }
 
-                    CoordEntry<ScalarType>::Write(stream, row, col, value);
-                }
-            }
-        } else { // array
-            stream << rows << " " << cols << "\n";
+    // Sparse matrices are written in coordinate format, dense matrices in
+    // array format
+    template <typename TMatrix, typename TStream>
+    static void
+    WriteToStream(
+        const TMatrix& matrix,
+        TStream& stream)
+    {
+        WriteToStream(matrix, HasForEachNonZero<MatrixBuilder<TMatrix>>::value,
+            stream);
+    }
 
-            for (std::size_t col = 0; col < cols; col++) {
-                for (std::size_t row = 0; row < rows; row++) {
-                    ScalarType value = MatrixBuilder<TMatrix>::GetValue(matrix,
-                        row, col);
+    template <typename TMatrix>
+    static void
+    WriteToFile(
+        const TMatrix& matrix,
+        const bool coordinate,
+        const std::string& path,
+        const WriteOptions& options)
+    {
+        const bool index = (options.index && coordinate);
 
-                    ArrayEntry<ScalarType>::Write(stream, value);
-                }
-            }
+        IndexRecorder recorder(options.indexStride);
+
+        std::size_t bodySize;
+
+        {
+            FileTarget target(path);
+            OutputSink<FileTarget> sink(target);
+
+            WriteToSink(matrix, coordinate, sink, options, index ? &recorder :
+                nullptr);
+
+            bodySize = sink.Position() - recorder.Origin();
+
+            target.Close();
+        }
+
+        // the index refers to the modification time of the closed file
+
+        if (index) {
+            WriteIndexFile(path, MatrixBuilder<TMatrix>::NonZeros(matrix),
+                bodySize, recorder.Chunks());
         }
     }
 
@@ -483,13 +4165,20 @@ public:
     static void
     WriteToFile(
         const TMatrix& matrix,
+        const bool coordinate,
         const std::string& path)
     {
-        std::ofstream file(path);
-
-        WriteToStream(matrix, file);
+        WriteToFile(matrix, coordinate, path, WriteOptions());
+    }
 
-        file.close();
+    template <typename TMatrix>
+    static void
+    WriteToFile(
+        const TMatrix& matrix,
+        const std::string& path)
+    {
+        WriteToFile(matrix, HasForEachNonZero<MatrixBuilder<TMatrix>>::value,
+            path);
     }
 }; // class Writer
 
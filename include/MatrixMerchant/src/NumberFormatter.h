@@ -0,0 +1,480 @@
+#pragma once
+
+#include "PowersOfTen.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <locale>
+#include <sstream>
+#include <string>
+#include <type_traits>
+
+namespace MatrixMerchant {
+
+// Locale-independent conversion of numbers to text. Format writes into a
+// caller-provided buffer of at least MaxLength characters and returns a
+// pointer past the last written character. No terminating null character is
+// written.
+//
+// Float and double values are written with the Grisu2 algorithm (Loitsch,
+// "Printing Floating-Point Numbers Quickly and Accurately with Integers",
+// 2010). The output always reads back to the same value and is the shortest
+// such representation for all but a tiny fraction of the inputs. Like the
+// %g format, exponents below -4 and above 16 are written in scientific
+// notation. long double values are written by a stream with the classic
+// locale and enough digits to read back exactly.
+class NumberFormatter
+{
+public:
+    static const std::size_t MaxLength = 48;
+
+private:
+    struct DiyFp
+    {
+        std::uint64_t f;
+        int e;
+    };
+
+    struct Boundaries
+    {
+        DiyFp w;
+        DiyFp minus;
+        DiyFp plus;
+    };
+
+    // the digit generation requires the scaled value to have a binary
+    // exponent in [Alpha, Gamma]
+    static const int Alpha = -60;
+    static const int Gamma = -32;
+
+    static inline DiyFp
+    Make(
+        const std::uint64_t f,
+        const int e)
+    {
+        DiyFp result;
+
+        result.f = f;
+        result.e = e;
+
+        return result;
+    }
+
+    // Upper 64 bits of the 128-bit product, rounded
+    static inline DiyFp
+    Multiply(
+        const DiyFp& x,
+        const DiyFp& y)
+    {
+        const std::uint64_t xLow = x.f & 0xFFFFFFFF;
+        const std::uint64_t xHigh = x.f >> 32;
+        const std::uint64_t yLow = y.f & 0xFFFFFFFF;
+        const std::uint64_t yHigh = y.f >> 32;
+
+        const std::uint64_t lowLow = xLow * yLow;
+        const std::uint64_t lowHigh = xLow * yHigh;
+        const std::uint64_t highLow = xHigh * yLow;
+        const std::uint64_t highHigh = xHigh * yHigh;
+
+        std::uint64_t middle = (lowLow >> 32) + (lowHigh & 0xFFFFFFFF) +
+            (highLow & 0xFFFFFFFF);
+
+        middle += std::uint64_t(1) << 31;
+
+        return Make(highHigh + (lowHigh >> 32) + (highLow >> 32) +
+            (middle >> 32), x.e + y.e + 64);
+    }
+
+    static inline DiyFp
+    Normalize(
+        DiyFp x)
+    {
+        while ((x.f >> 63) == 0) {
+            x.f <<= 1;
+            x.e -= 1;
+        }
+
+        return x;
+    }
+
+    template <typename TFloat>
+    static Boundaries
+    ComputeBoundaries(
+        const TFloat value)
+    {
+        using BitsType = typename std::conditional<sizeof(TFloat) == 8,
+            std::uint64_t, std::uint32_t>::type;
+
+        const int precision = std::numeric_limits<TFloat>::digits;
+        const int bias = std::numeric_limits<TFloat>::max_exponent - 1 +
+            (precision - 1);
+        const int minExponent = 1 - bias;
+        const std::uint64_t hiddenBit = std::uint64_t(1) << (precision - 1);
+
+        BitsType bits;
+
+        std::memcpy(&bits, &value, sizeof(TFloat));
+
+        const std::uint64_t fraction = std::uint64_t(bits) & (hiddenBit - 1);
+        const int exponent = int(bits >> (precision - 1)) &
+            ((1 << (sizeof(TFloat) * 8 - precision)) - 1);
+
+        const DiyFp v = (exponent == 0) ? Make(fraction, minExponent) :
+            Make(fraction + hiddenBit, exponent - bias);
+
+        // the boundaries are the midpoints to the neighboring floats. At a
+        // power of two the lower neighbor is closer.
+
+        const bool lowerIsCloser = (fraction == 0 && exponent > 1);
+
+        const DiyFp plus = Make(2 * v.f + 1, v.e - 1);
+        const DiyFp minus = lowerIsCloser ? Make(4 * v.f - 1, v.e - 2) :
+            Make(2 * v.f - 1, v.e - 1);
+
+        Boundaries result;
+
+        result.w = Normalize(v);
+        result.plus = Normalize(plus);
+        result.minus = Make(minus.f << (minus.e - result.plus.e),
+            result.plus.e);
+
+        return result;
+    }
+
+    // Returns a power of ten c = 10^-k such that the binary exponent of
+    // c * 2^e lies in [Alpha, Gamma]
+    static inline const PowersOfTen::CachedPower&
+    CachedPower(
+        const int e)
+    {
+        const int f = Alpha - e - 1;
+        const int k = (f * 78913) / (1 << 18) + int(f > 0);
+
+        const int index = (-PowersOfTen::Smallest + k +
+            (PowersOfTen::Step - 1)) / PowersOfTen::Step;
+
+        return PowersOfTen::Table()[index];
+    }
+
+    static inline int
+    LargestPowerOfTen(
+        const std::uint32_t n,
+        std::uint32_t& power)
+    {
+        static const std::uint32_t powers[] = {1, 10, 100, 1000, 10000,
+            100000, 1000000, 10000000, 100000000, 1000000000};
+
+        int digits = 10;
+
+        while (digits > 1 && n < powers[digits - 1]) {
+            digits -= 1;
+        }
+
+        power = powers[digits - 1];
+
+        return digits;
+    }
+
+    // Moves the last digit towards w while the result stays in the interval
+    static inline void
+    Round(
+        char* digits,
+        const int length,
+        const std::uint64_t distance,
+        const std::uint64_t delta,
+        std::uint64_t rest,
+        const std::uint64_t tenK)
+    {
+        while (rest < distance && delta - rest >= tenK &&
+               (rest + tenK < distance ||
+                distance - rest > rest + tenK - distance)) {
+            digits[length - 1] -= 1;
+            rest += tenK;
+        }
+    }
+
+    // Generates the shortest digits of a number in [minus, plus], the
+    // scaled boundaries of w
+    static void
+    GenerateDigits(
+        char* digits,
+        int& length,
+        int& exponent,
+        const DiyFp& minus,
+        const DiyFp& w,
+        const DiyFp& plus)
+    {
+        std::uint64_t delta = plus.f - minus.f;
+        std::uint64_t distance = plus.f - w.f;
+
+        const int shift = -plus.e;
+        const std::uint64_t one = std::uint64_t(1) << shift;
+
+        std::uint32_t integral = std::uint32_t(plus.f >> shift);
+        std::uint64_t fractional = plus.f & (one - 1);
+
+        std::uint32_t power;
+
+        int n = LargestPowerOfTen(integral, power);
+
+        while (n > 0) {
+            digits[length++] = char('0' + integral / power);
+
+            integral %= power;
+            n -= 1;
+
+            const std::uint64_t rest = (std::uint64_t(integral) << shift) +
+                fractional;
+
+            if (rest <= delta) {
+                exponent += n;
+
+                Round(digits, length, distance, delta, rest,
+                    std::uint64_t(power) << shift);
+                return;
+            }
+
+            power /= 10;
+        }
+
+        int m = 0;
+
+        while (true) {
+            fractional *= 10;
+
+            digits[length++] = char('0' + (fractional >> shift));
+
+            fractional &= one - 1;
+            m += 1;
+
+            delta *= 10;
+            distance *= 10;
+
+            if (fractional <= delta) {
+                break;
+            }
+        }
+
+        exponent -= m;
+
+        Round(digits, length, distance, delta, fractional, one);
+    }
+
+    template <typename TFloat>
+    static void
+    Grisu2(
+        char* digits,
+        int& length,
+        int& exponent,
+        const TFloat value)
+    {
+        const Boundaries boundaries = ComputeBoundaries(value);
+
+        const PowersOfTen::CachedPower& cached = CachedPower(
+            boundaries.plus.e);
+
+        const DiyFp c = Make(cached.f, cached.e);
+
+        const DiyFp w = Multiply(boundaries.w, c);
+        const DiyFp minus = Multiply(boundaries.minus, c);
+        const DiyFp plus = Multiply(boundaries.plus, c);
+
+        // shrink the interval by one unit to absorb the rounding errors of
+        // the multiplications
+
+        length = 0;
+        exponent = -cached.k;
+
+        GenerateDigits(digits, length, exponent, Make(minus.f + 1, minus.e),
+            w, Make(plus.f - 1, plus.e));
+    }
+
+    static inline char*
+    WriteExponent(
+        char* pos,
+        int exponent)
+    {
+        *pos++ = 'e';
+
+        if (exponent < 0) {
+            *pos++ = '-';
+            exponent = -exponent;
+        } else {
+            *pos++ = '+';
+        }
+
+        if (exponent >= 100) {
+            *pos++ = char('0' + exponent / 100);
+            exponent %= 100;
+        }
+
+        *pos++ = char('0' + exponent / 10);
+        *pos++ = char('0' + exponent % 10);
+
+        return pos;
+    }
+
+    // Writes the digits d1...dk * 10^exponent
+    static char*
+    WriteDecimal(
+        char* pos,
+        const char* digits,
+        const int length,
+        const int exponent)
+    {
+        // position of the decimal point relative to the first digit
+
+        const int point = length + exponent;
+
+        if (length <= point && point <= 17) { // ddd000
+            std::memcpy(pos, digits, length);
+            std::memset(pos + length, '0', point - length);
+            return pos + point;
+        }
+
+        if (0 < point && point <= 17) { // dd.ddd
+            std::memcpy(pos, digits, point);
+            pos[point] = '.';
+            std::memcpy(pos + point + 1, digits + point, length - point);
+            return pos + length + 1;
+        }
+
+        if (-4 < point && point <= 0) { // 0.000ddd
+            pos[0] = '0';
+            pos[1] = '.';
+            std::memset(pos + 2, '0', -point);
+            std::memcpy(pos + 2 - point, digits, length);
+            return pos + 2 - point + length;
+        }
+
+        // d.ddde+xx
+
+        *pos++ = digits[0];
+
+        if (length > 1) {
+            *pos++ = '.';
+            std::memcpy(pos, digits + 1, length - 1);
+            pos += length - 1;
+        }
+
+        return WriteExponent(pos, point - 1);
+    }
+
+    template <typename TFloat>
+    static char*
+    FormatFloat(
+        char* pos,
+        TFloat value)
+    {
+        if (std::signbit(value)) {
+            *pos++ = '-';
+            value = -value;
+        }
+
+        if (value != value) {
+            std::memcpy(pos, "nan", 3);
+            return pos + 3;
+        }
+
+        if (value == std::numeric_limits<TFloat>::infinity()) {
+            std::memcpy(pos, "inf", 3);
+            return pos + 3;
+        }
+
+        if (value == 0) {
+            *pos++ = '0';
+            return pos;
+        }
+
+        char digits[20];
+        int length;
+        int exponent;
+
+        Grisu2(digits, length, exponent, value);
+
+        return WriteDecimal(pos, digits, length, exponent);
+    }
+
+    static char*
+    FormatFloat(
+        char* pos,
+        const long double value)
+    {
+        std::ostringstream stream;
+
+        stream.imbue(std::locale::classic());
+        stream.precision(std::numeric_limits<long double>::max_digits10);
+        stream << value;
+
+        const std::string text = stream.str();
+
+        std::memcpy(pos, text.data(), text.size());
+
+        return pos + text.size();
+    }
+
+    template <typename TInteger>
+    static char*
+    FormatInteger(
+        char* pos,
+        const TInteger value)
+    {
+        using UnsignedType = typename std::make_unsigned<TInteger>::type;
+
+        UnsignedType magnitude = UnsignedType(value);
+
+        if (std::numeric_limits<TInteger>::is_signed && value < TInteger(0)) {
+            *pos++ = '-';
+            magnitude = UnsignedType(0) - magnitude;
+        }
+
+        char digits[std::numeric_limits<UnsignedType>::digits10 + 1];
+        char* first = digits + sizeof(digits);
+
+        do {
+            *--first = char('0' + magnitude % 10);
+            magnitude /= 10;
+        } while (magnitude != 0);
+
+        const std::size_t length = digits + sizeof(digits) - first;
+
+        std::memcpy(pos, first, length);
+
+        return pos + length;
+    }
+
+public:
+    template <typename TInteger>
+    static typename std::enable_if<std::is_integral<TInteger>::value &&
+        !std::is_same<TInteger, bool>::value, char*>::type
+    Format(
+        char* first,
+        const TInteger value)
+    {
+        return FormatInteger(first, value);
+    }
+
+    template <typename TFloat>
+    static typename std::enable_if<std::is_floating_point<TFloat>::value,
+        char*>::type
+    Format(
+        char* first,
+        const TFloat value)
+    {
+        return FormatFloat(first, value);
+    }
+
+    static char*
+    Format(
+        char* first,
+        const bool value)
+    {
+        *first = value ? '1' : '0';
+
+        return first + 1;
+    }
+}; // class NumberFormatter
+
+} // namespace MatrixMerchant
@@ -0,0 +1,698 @@
+#pragma once
+
+#include "PowersOfFive.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <type_traits>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+namespace MatrixMerchant {
+
+template <typename TFloat>
+struct FloatTraits;
+
+template <>
+struct FloatTraits<double>
+{
+    using BitsType = std::uint64_t;
+
+    static const int MantissaBits = 52;
+    static const int MinimumExponent = -1023;
+    static const int InfinitePower = 0x7FF;
+    static const int SmallestPowerOfTen = -342;
+    static const int LargestPowerOfTen = 308;
+    static const int MinExponentRoundToEven = -4;
+    static const int MaxExponentRoundToEven = 23;
+    static const int MinExponentFastPath = -22;
+    static const int MaxExponentFastPath = 22;
+
+    static const std::uint64_t MaxMantissaFastPath = std::uint64_t(2) << 52;
+
+    static inline double
+    ExactPowerOfTen(
+        const int exponent)
+    {
+        static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6,
+            1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+            1e18, 1e19, 1e20, 1e21, 1e22};
+
+        return powers[exponent];
+    }
+
+    static inline double
+    Convert(
+        const char* text)
+    {
+        return std::strtod(text, nullptr);
+    }
+};
+
+template <>
+struct FloatTraits<float>
+{
+    using BitsType = std::uint32_t;
+
+    static const int MantissaBits = 23;
+    static const int MinimumExponent = -127;
+    static const int InfinitePower = 0xFF;
+    static const int SmallestPowerOfTen = -65;
+    static const int LargestPowerOfTen = 38;
+    static const int MinExponentRoundToEven = -17;
+    static const int MaxExponentRoundToEven = 10;
+    static const int MinExponentFastPath = -10;
+    static const int MaxExponentFastPath = 10;
+
+    static const std::uint64_t MaxMantissaFastPath = std::uint64_t(2) << 23;
+
+    static inline float
+    ExactPowerOfTen(
+        const int exponent)
+    {
+        static const float powers[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f,
+            1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+
+        return powers[exponent];
+    }
+
+    static inline float
+    Convert(
+        const char* text)
+    {
+        return std::strtof(text, nullptr);
+    }
+};
+
+// long double values are always converted exactly by strtold
+template <>
+struct FloatTraits<long double>
+{
+    static inline long double
+    Convert(
+        const char* text)
+    {
+        return std::strtold(text, nullptr);
+    }
+};
+
+// Locale-independent conversion of character ranges to numbers. The
+// interface follows std::from_chars: Parse returns a pointer to the first
+// character that is not part of the number, or `first` if no number could be
+// parsed.
+//
+// Floating point values are correctly rounded. Decimals with up to 19
+// significant digits are converted with Clinger's fast path or the
+// Eisel-Lemire algorithm. The rare inputs where Eisel-Lemire cannot decide
+// the rounding are rewritten into an integer mantissa and exponent without a
+// decimal point and handed to strtod, which makes the result independent of
+// the current locale.
+class NumberParser
+{
+private:
+    struct UInt128
+    {
+        std::uint64_t high;
+        std::uint64_t low;
+    };
+
+    struct AdjustedMantissa
+    {
+        std::uint64_t mantissa;
+        int power2;
+    };
+
+    struct Decimal
+    {
+        bool negative;
+        bool truncated;
+        std::uint64_t mantissa;
+        std::int64_t exponent;
+        std::int64_t explicitExponent;
+        const char* integerBegin;
+        const char* integerEnd;
+        const char* fractionBegin;
+        const char* fractionEnd;
+    };
+
+    static inline bool
+    IsDigit(
+        const char c)
+    {
+        return static_cast<unsigned char>(c - '0') < 10;
+    }
+
+    static inline UInt128
+    Multiply(
+        const std::uint64_t a,
+        const std::uint64_t b)
+    {
+        UInt128 result;
+
+#if defined(__SIZEOF_INT128__)
+        // __extension__ keeps -Wpedantic quiet about the non-standard type
+        __extension__ typedef unsigned __int128 Product;
+
+        const Product product = Product(a) * b;
+
+        result.high = std::uint64_t(product >> 64);
+        result.low = std::uint64_t(product);
+#elif defined(_MSC_VER) && defined(_M_X64)
+        result.low = _umul128(a, b, &result.high);
+#else
+        const std::uint64_t aLow = a & 0xFFFFFFFF;
+        const std::uint64_t aHigh = a >> 32;
+        const std::uint64_t bLow = b & 0xFFFFFFFF;
+        const std::uint64_t bHigh = b >> 32;
+
+        const std::uint64_t lowLow = aLow * bLow;
+        const std::uint64_t highLow = aHigh * bLow;
+        const std::uint64_t lowHigh = aLow * bHigh;
+        const std::uint64_t highHigh = aHigh * bHigh;
+
+        const std::uint64_t cross = (lowLow >> 32) + (highLow & 0xFFFFFFFF) +
+            lowHigh;
+
+        result.high = highHigh + (highLow >> 32) + (cross >> 32);
+        result.low = (cross << 32) | (lowLow & 0xFFFFFFFF);
+#endif
+
+        return result;
+    }
+
+    static inline int
+    LeadingZeros(
+        std::uint64_t value)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_clzll(value);
+#else
+        int count = 0;
+
+        while ((value & (std::uint64_t(1) << 63)) == 0) {
+            value <<= 1;
+            count += 1;
+        }
+
+        return count;
+#endif
+    }
+
+    // Eisel-Lemire: computes the binary mantissa and exponent of w * 10^q
+    // from a 128-bit approximation of 5^q. The approximation is always
+    // sufficient for w < 2^64 (Mushtak and Lemire, "Fast Number Parsing
+    // Without Fallback", 2023).
+    template <typename TFloat>
+    static AdjustedMantissa
+    ComputeFloat(
+        const std::int64_t q,
+        std::uint64_t w)
+    {
+        using Traits = FloatTraits<TFloat>;
+
+        AdjustedMantissa answer;
+
+        if (w == 0 || q < Traits::SmallestPowerOfTen) {
+            answer.mantissa = 0;
+            answer.power2 = 0;
+            return answer;
+        }
+
+        if (q > Traits::LargestPowerOfTen) {
+            answer.mantissa = 0;
+            answer.power2 = Traits::InfinitePower;
+            return answer;
+        }
+
+        const int lz = LeadingZeros(w);
+
+        w <<= lz;
+
+        const std::uint64_t* powers = PowersOfFive::Table();
+        const std::size_t index = 2 * std::size_t(q - PowersOfFive::Smallest);
+
+        const std::uint64_t precisionMask = std::uint64_t(0xFFFFFFFFFFFFFFFF) >>
+            (Traits::MantissaBits + 3);
+
+        UInt128 product = Multiply(w, powers[index]);
+
+        if ((product.high & precisionMask) == precisionMask) {
+            const UInt128 second = Multiply(w, powers[index + 1]);
+
+            product.low += second.high;
+
+            if (second.high > product.low) {
+                product.high += 1;
+            }
+        }
+
+        const int upperBit = int(product.high >> 63);
+        const int shift = upperBit + 64 - Traits::MantissaBits - 3;
+
+        answer.mantissa = product.high >> shift;
+        answer.power2 = int(((152170 + 65536) * q) >> 16) + 63 + upperBit -
+            lz - Traits::MinimumExponent;
+
+        if (answer.power2 <= 0) { // subnormal
+            if (-answer.power2 + 1 >= 64) {
+                answer.mantissa = 0;
+                answer.power2 = 0;
+                return answer;
+            }
+
+            answer.mantissa >>= -answer.power2 + 1;
+            answer.mantissa += (answer.mantissa & 1);
+            answer.mantissa >>= 1;
+            answer.power2 = (answer.mantissa <
+                (std::uint64_t(1) << Traits::MantissaBits)) ? 0 : 1;
+            return answer;
+        }
+
+        // w * 10^q lies exactly between two floats: round to even
+
+        if (product.low <= 1 && q >= Traits::MinExponentRoundToEven &&
+            q <= Traits::MaxExponentRoundToEven &&
+            (answer.mantissa & 3) == 1 &&
+            (answer.mantissa << shift) == product.high) {
+            answer.mantissa &= ~std::uint64_t(1);
+        }
+
+        answer.mantissa += (answer.mantissa & 1);
+        answer.mantissa >>= 1;
+
+        if (answer.mantissa >= (std::uint64_t(2) << Traits::MantissaBits)) {
+            answer.mantissa = std::uint64_t(1) << Traits::MantissaBits;
+            answer.power2 += 1;
+        }
+
+        answer.mantissa &= ~(std::uint64_t(1) << Traits::MantissaBits);
+
+        if (answer.power2 >= Traits::InfinitePower) {
+            answer.mantissa = 0;
+            answer.power2 = Traits::InfinitePower;
+        }
+
+        return answer;
+    }
+
+    template <typename TFloat>
+    static TFloat
+    ToFloat(
+        const AdjustedMantissa& answer,
+        const bool negative)
+    {
+        using Traits = FloatTraits<TFloat>;
+        using BitsType = typename Traits::BitsType;
+
+        BitsType bits = BitsType(answer.mantissa) |
+            (BitsType(answer.power2) << Traits::MantissaBits);
+
+        if (negative) {
+            bits |= BitsType(1) << (sizeof(BitsType) * 8 - 1);
+        }
+
+        TFloat value;
+
+        std::memcpy(&value, &bits, sizeof(TFloat));
+
+        return value;
+    }
+
+    static const char*
+    ScanDecimal(
+        const char* first,
+        const char* last,
+        Decimal& number)
+    {
+        const char* pos = first;
+
+        number.negative = false;
+        number.truncated = false;
+
+        if (pos != last && (*pos == '-' || *pos == '+')) {
+            number.negative = (*pos == '-');
+            pos += 1;
+        }
+
+        std::uint64_t mantissa = 0;
+
+        number.integerBegin = pos;
+
+        while (pos != last && IsDigit(*pos)) {
+            mantissa = mantissa * 10 + std::uint64_t(*pos - '0');
+            pos += 1;
+        }
+
+        number.integerEnd = pos;
+        number.fractionBegin = pos;
+        number.fractionEnd = pos;
+
+        if (pos != last && *pos == '.') {
+            pos += 1;
+
+            number.fractionBegin = pos;
+
+            while (pos != last && IsDigit(*pos)) {
+                mantissa = mantissa * 10 + std::uint64_t(*pos - '0');
+                pos += 1;
+            }
+
+            number.fractionEnd = pos;
+        }
+
+        const std::int64_t integerDigits = number.integerEnd -
+            number.integerBegin;
+        const std::int64_t fractionDigits = number.fractionEnd -
+            number.fractionBegin;
+
+        if (integerDigits + fractionDigits == 0) {
+            return first;
+        }
+
+        number.explicitExponent = 0;
+
+        if (pos != last && (*pos == 'e' || *pos == 'E')) {
+            const char* exponentPos = pos + 1;
+
+            bool negativeExponent = false;
+
+            if (exponentPos != last &&
+                (*exponentPos == '-' || *exponentPos == '+')) {
+                negativeExponent = (*exponentPos == '-');
+                exponentPos += 1;
+            }
+
+            if (exponentPos != last && IsDigit(*exponentPos)) {
+                std::int64_t exponent = 0;
+
+                while (exponentPos != last && IsDigit(*exponentPos)) {
+                    if (exponent < 0x10000) {
+                        exponent = exponent * 10 + (*exponentPos - '0');
+                    }
+
+                    exponentPos += 1;
+                }
+
+                number.explicitExponent = negativeExponent ? -exponent :
+                    exponent;
+
+                pos = exponentPos;
+            }
+        }
+
+        number.mantissa = mantissa;
+        number.exponent = number.explicitExponent - fractionDigits;
+
+        // more than 19 digits might have overflowed the mantissa: keep the
+        // 19 most significant digits and remember that the value is truncated
+
+        if (integerDigits + fractionDigits > 19) {
+            std::int64_t significantDigits = integerDigits + fractionDigits;
+
+            for (const char* digit = number.integerBegin;
+                 digit != number.fractionEnd && significantDigits > 19;
+                 digit += 1) {
+                if (*digit == '0') {
+                    significantDigits -= 1;
+                } else if (*digit != '.') {
+                    break;
+                }
+            }
+
+            if (significantDigits > 19) {
+                const std::uint64_t minimal19Digits = 1000000000000000000ull;
+
+                number.truncated = true;
+
+                mantissa = 0;
+
+                const char* digit = number.integerBegin;
+
+                while (mantissa < minimal19Digits &&
+                       digit != number.integerEnd) {
+                    mantissa = mantissa * 10 + std::uint64_t(*digit - '0');
+                    digit += 1;
+                }
+
+                if (mantissa >= minimal19Digits) {
+                    number.exponent = (number.integerEnd - digit) +
+                        number.explicitExponent;
+                } else {
+                    digit = number.fractionBegin;
+
+                    while (mantissa < minimal19Digits &&
+                           digit != number.fractionEnd) {
+                        mantissa = mantissa * 10 + std::uint64_t(*digit - '0');
+                        digit += 1;
+                    }
+
+                    number.exponent = (number.fractionBegin - digit) +
+                        number.explicitExponent;
+                }
+
+                number.mantissa = mantissa;
+            }
+        }
+
+        return pos;
+    }
+
+    static bool
+    MatchIgnoreCase(
+        const char* first,
+        const char* last,
+        const char* word)
+    {
+        const std::size_t length = std::strlen(word);
+
+        if (std::size_t(last - first) < length) {
+            return false;
+        }
+
+        for (std::size_t i = 0; i < length; i++) {
+            if ((first[i] | 0x20) != word[i]) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    template <typename TFloat>
+    static const char*
+    ParseSpecial(
+        const char* first,
+        const char* last,
+        TFloat& value)
+    {
+        const char* pos = first;
+
+        const bool negative = (pos != last && *pos == '-');
+
+        if (pos != last && (*pos == '-' || *pos == '+')) {
+            pos += 1;
+        }
+
+        if (MatchIgnoreCase(pos, last, "nan")) {
+            value = negative ? -std::numeric_limits<TFloat>::quiet_NaN() :
+                std::numeric_limits<TFloat>::quiet_NaN();
+            return pos + 3;
+        }
+
+        if (MatchIgnoreCase(pos, last, "inf")) {
+            value = negative ? -std::numeric_limits<TFloat>::infinity() :
+                std::numeric_limits<TFloat>::infinity();
+            return pos + (MatchIgnoreCase(pos, last, "infinity") ? 8 : 3);
+        }
+
+        return first;
+    }
+
+    // Exact conversion for the cases Eisel-Lemire leaves undecided. The
+    // digits are copied without a decimal point so strtod does not depend on
+    // the radix character of the current locale.
+    template <typename TFloat>
+    static TFloat
+    ConvertExact(
+        const Decimal& number)
+    {
+        std::string text;
+
+        text.reserve((number.fractionEnd - number.integerBegin) + 24);
+
+        if (number.negative) {
+            text += '-';
+        }
+
+        text.append(number.integerBegin, number.integerEnd);
+        text.append(number.fractionBegin, number.fractionEnd);
+        text += 'e';
+        text += std::to_string(number.explicitExponent -
+            (number.fractionEnd - number.fractionBegin));
+
+        return FloatTraits<TFloat>::Convert(text.c_str());
+    }
+
+    template <typename TFloat>
+    static const char*
+    ParseFloat(
+        const char* first,
+        const char* last,
+        TFloat& value)
+    {
+        using Traits = FloatTraits<TFloat>;
+
+        Decimal number;
+
+        const char* end = ScanDecimal(first, last, number);
+
+        if (end == first) {
+            return ParseSpecial(first, last, value);
+        }
+
+        // Clinger's fast path: mantissa and power of ten are exact
+
+        if (!number.truncated &&
+            number.exponent >= Traits::MinExponentFastPath &&
+            number.exponent <= Traits::MaxExponentFastPath &&
+            number.mantissa <= Traits::MaxMantissaFastPath) {
+            TFloat result = TFloat(number.mantissa);
+
+            if (number.exponent < 0) {
+                result /= Traits::ExactPowerOfTen(int(-number.exponent));
+            } else {
+                result *= Traits::ExactPowerOfTen(int(number.exponent));
+            }
+
+            value = number.negative ? -result : result;
+
+            return end;
+        }
+
+        AdjustedMantissa answer = ComputeFloat<TFloat>(number.exponent,
+            number.mantissa);
+
+        // a truncated mantissa is only safe if rounding up the last kept
+        // digit yields the same float
+
+        if (number.truncated && answer.power2 >= 0) {
+            const AdjustedMantissa upper = ComputeFloat<TFloat>(
+                number.exponent, number.mantissa + 1);
+
+            if (upper.mantissa != answer.mantissa ||
+                upper.power2 != answer.power2) {
+                answer.power2 = -1;
+            }
+        }
+
+        if (answer.power2 < 0) {
+            value = ConvertExact<TFloat>(number);
+        } else {
+            value = ToFloat<TFloat>(answer, number.negative);
+        }
+
+        return end;
+    }
+
+    static const char*
+    ParseFloat(
+        const char* first,
+        const char* last,
+        long double& value)
+    {
+        Decimal number;
+
+        const char* end = ScanDecimal(first, last, number);
+
+        if (end == first) {
+            return ParseSpecial(first, last, value);
+        }
+
+        value = ConvertExact<long double>(number);
+
+        return end;
+    }
+
+    template <typename TInteger>
+    static const char*
+    ParseInteger(
+        const char* first,
+        const char* last,
+        TInteger& value)
+    {
+        using UnsignedType = typename std::make_unsigned<TInteger>::type;
+
+        const char* pos = first;
+
+        bool negative = false;
+
+        if (pos != last && (*pos == '-' || *pos == '+')) {
+            negative = (*pos == '-');
+
+            if (negative && !std::numeric_limits<TInteger>::is_signed) {
+                return first;
+            }
+
+            pos += 1;
+        }
+
+        const UnsignedType limit = negative ?
+            UnsignedType(std::numeric_limits<TInteger>::max()) + 1 :
+            UnsignedType(std::numeric_limits<TInteger>::max());
+
+        const char* digitsBegin = pos;
+
+        UnsignedType result = 0;
+
+        while (pos != last && IsDigit(*pos)) {
+            const UnsignedType digit = UnsignedType(*pos - '0');
+
+            if (result > (limit - digit) / 10) {
+                return first;
+            }
+
+            result = result * 10 + digit;
+
+            pos += 1;
+        }
+
+        if (pos == digitsBegin) {
+            return first;
+        }
+
+        value = negative ? TInteger(UnsignedType(0) - result) :
+            TInteger(result);
+
+        return pos;
+    }
+
+public:
+    template <typename TInteger>
+    static typename std::enable_if<std::is_integral<TInteger>::value &&
+        !std::is_same<TInteger, bool>::value, const char*>::type
+    Parse(
+        const char* first,
+        const char* last,
+        TInteger& value)
+    {
+        return ParseInteger(first, last, value);
+    }
+
+    template <typename TFloat>
+    static typename std::enable_if<std::is_floating_point<TFloat>::value,
+        const char*>::type
+    Parse(
+        const char* first,
+        const char* last,
+        TFloat& value)
+    {
+        return ParseFloat(first, last, value);
+    }
+}; // class NumberParser
+
+} // namespace MatrixMerchant
@@ -0,0 +1,313 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MATRIXMERCHANT_HAS_POSIX_WRITE
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace MatrixMerchant {
+
+// Writes to a file with one write(2) call per chunk of data. On platforms
+// without POSIX I/O an unbuffered std::FILE is used instead.
+class FileTarget
+{
+private:
+#ifdef MATRIXMERCHANT_HAS_POSIX_WRITE
+    int m_fd;
+#else
+    std::FILE* m_file;
+#endif
+
+public:
+    FileTarget(
+        const std::string& path)
+    {
+#ifdef MATRIXMERCHANT_HAS_POSIX_WRITE
+        m_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+        if (m_fd < 0) {
+            throw std::runtime_error("Invalid file");
+        }
+#else
+        m_file = std::fopen(path.c_str(), "wb");
+
+        if (m_file == nullptr) {
+            throw std::runtime_error("Invalid file");
+        }
+
+        std::setvbuf(m_file, nullptr, _IONBF, 0);
+#endif
+    }
+
+    FileTarget(const FileTarget&) = delete;
+
+    FileTarget&
+    operator=(const FileTarget&) = delete;
+
+    ~FileTarget()
+    {
+#ifdef MATRIXMERCHANT_HAS_POSIX_WRITE
+        if (m_fd >= 0) {
+            ::close(m_fd);
+        }
+#else
+        if (m_file != nullptr) {
+            std::fclose(m_file);
+        }
+#endif
+    }
+
+    // Closes the file. Errors of the last writes may only be reported here,
+    // e.g. for a full disk, so writers close the file explicitly instead of
+    // relying on the destructor.
+    void
+    Close()
+    {
+#ifdef MATRIXMERCHANT_HAS_POSIX_WRITE
+        const int fd = m_fd;
+        m_fd = -1;
+
+        if (::close(fd) != 0 && errno != EINTR) {
+            throw std::runtime_error("MatrixMarket write failed");
+        }
+#else
+        std::FILE* file = m_file;
+        m_file = nullptr;
+
+        if (std::fflush(file) != 0 || std::fclose(file) != 0) {
+            throw std::runtime_error("MatrixMarket write failed");
+        }
+#endif
+    }
+
+    void
+    Write(
+        const char* data,
+        std::size_t size)
+    {
+#ifdef MATRIXMERCHANT_HAS_POSIX_WRITE
+        while (size != 0) {
+            const ssize_t written = ::write(m_fd, data, size);
+
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+
+            if (written < 0) {
+                throw std::runtime_error("MatrixMarket write failed");
+            }
+
+            data += written;
+            size -= std::size_t(written);
+        }
+#else
+        if (std::fwrite(data, 1, size, m_file) != size) {
+            throw std::runtime_error("MatrixMarket write failed");
+        }
+#endif
+    }
+}; // class FileTarget
+
+// Hands chunks of data to a std::ostream in a single call each
+template <typename TStream>
+class StreamTarget
+{
+private:
+    TStream& m_stream;
+
+public:
+    StreamTarget(
+        TStream& stream)
+        : m_stream(stream)
+    {
+    }
+
+    void
+    Write(
+        const char* data,
+        const std::size_t size)
+    {
+        m_stream.write(data, size);
+    }
+}; // class StreamTarget
+
+// Collects formatted output in a large preallocated buffer, which is passed
+// to the target once it is full. Entries are formatted directly into the
+// buffer: Reserve returns space for at least the requested number of
+// characters and Commit marks the characters up to `end` as written.
+template <typename TTarget>
+class OutputSink
+{
+public:
+    static const std::size_t BufferSize = 4 << 20;
+
+private:
+    TTarget& m_target;
+    std::vector<char> m_buffer;
+    std::size_t m_size;
+
+    // characters passed to the target
+    std::size_t m_written;
+
+public:
+    OutputSink(
+        TTarget& target)
+        : m_target(target)
+        , m_buffer(BufferSize)
+        , m_size(0)
+        , m_written(0)
+    {
+    }
+
+    char*
+    Reserve(
+        const std::size_t length)
+    {
+        if (m_size + length > m_buffer.size()) {
+            Flush();
+        }
+
+        return m_buffer.data() + m_size;
+    }
+
+    void
+    Commit(
+        const char* end)
+    {
+        m_size = end - m_buffer.data();
+    }
+
+    void
+    Write(
+        const char* data,
+        const std::size_t length)
+    {
+        if (length > m_buffer.size()) {
+            Flush();
+            m_target.Write(data, length);
+            m_written += length;
+            return;
+        }
+
+        std::memcpy(Reserve(length), data, length);
+
+        m_size += length;
+    }
+
+    void
+    Write(
+        const std::string& text)
+    {
+        Write(text.data(), text.size());
+    }
+
+    void
+    Flush()
+    {
+        if (m_size != 0) {
+            m_target.Write(m_buffer.data(), m_size);
+        }
+
+        m_written += m_size;
+        m_size = 0;
+    }
+
+    // Number of characters written so far
+    std::size_t
+    Position() const
+    {
+        return m_written + m_size;
+    }
+}; // class OutputSink
+
+// Collects formatted output in memory with the interface of OutputSink. The
+// buffer grows as needed and keeps its capacity when cleared, so it can be
+// reused for the next part of the output.
+class BufferSink
+{
+private:
+    std::vector<char> m_buffer;
+    std::size_t m_size;
+
+public:
+    BufferSink()
+        : m_size(0)
+    {
+    }
+
+    char*
+    Reserve(
+        const std::size_t length)
+    {
+        if (m_size + length > m_buffer.size()) {
+            m_buffer.resize(std::max(2 * m_buffer.size(), m_size + length));
+        }
+
+        return m_buffer.data() + m_size;
+    }
+
+    void
+    Commit(
+        const char* end)
+    {
+        m_size = end - m_buffer.data();
+    }
+
+    void
+    Write(
+        const char* data,
+        const std::size_t length)
+    {
+        std::memcpy(Reserve(length), data, length);
+
+        m_size += length;
+    }
+
+    void
+    Write(
+        const std::string& text)
+    {
+        Write(text.data(), text.size());
+    }
+
+    void
+    Flush()
+    {
+    }
+
+    void
+    Clear()
+    {
+        m_size = 0;
+    }
+
+    const char*
+    Data() const
+    {
+        return m_buffer.data();
+    }
+
+    std::size_t
+    Size() const
+    {
+        return m_size;
+    }
+
+    std::size_t
+    Position() const
+    {
+        return m_size;
+    }
+}; // class BufferSink
+
+} // namespace MatrixMerchant
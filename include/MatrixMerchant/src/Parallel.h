@@ -0,0 +1,241 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace MatrixMerchant {
+
+// Resolves a requested number of threads. 0 selects the number of hardware
+// threads.
+static inline std::size_t
+ThreadCount(
+    const std::size_t requested)
+{
+    if (requested != 0) {
+        return requested;
+    }
+
+    const std::size_t hardware = std::thread::hardware_concurrency();
+
+    return hardware != 0 ? hardware : 1;
+}
+
+// Runs function(i) for every i in [0, count), each on its own thread. The
+// first exception thrown by any of the calls is rethrown after all threads
+// have finished.
+template <typename TFunction>
+static void
+ParallelFor(
+    const std::size_t count,
+    TFunction function)
+{
+    std::vector<std::exception_ptr> errors(count);
+    std::vector<std::thread> threads;
+
+    threads.reserve(count);
+
+    for (std::size_t i = 0; i < count; i++) {
+        threads.emplace_back([&, i]() {
+            try {
+                function(i);
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        });
+    }
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    for (const std::exception_ptr& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+// A fixed set of threads that run the calls of Run. The calling thread
+// takes part in every run, so a pool of size n starts n - 1 threads. Running
+// a function allocates nothing, which keeps repeated reads free of thread
+// creation.
+class ThreadPool
+{
+private:
+    std::vector<std::thread> m_threads;
+    std::vector<std::exception_ptr> m_errors;
+
+    std::mutex m_mutex;
+    std::condition_variable m_started;
+    std::condition_variable m_finished;
+
+    // the current run
+    void (*m_invoke)(void*, std::size_t);
+    void* m_function;
+    std::size_t m_count;
+    std::size_t m_generation;
+    std::size_t m_running;
+    bool m_stop;
+
+    template <typename TFunction>
+    static void
+    Invoke(
+        void* function,
+        const std::size_t i)
+    {
+        (*static_cast<TFunction*>(function))(i);
+    }
+
+    // Calls of a run are distributed round-robin over the threads
+    void
+    Work(
+        const std::size_t thread)
+    {
+        for (std::size_t i = thread; i < m_count; i += Size()) {
+            try {
+                m_invoke(m_function, i);
+            } catch (...) {
+                if (!m_errors[thread]) {
+                    m_errors[thread] = std::current_exception();
+                }
+            }
+        }
+    }
+
+    void
+    Loop(
+        const std::size_t thread)
+    {
+        std::size_t generation = 0;
+
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+
+                m_started.wait(lock, [&]() {
+                    return m_stop || m_generation != generation;
+                });
+
+                if (m_stop) {
+                    return;
+                }
+
+                generation = m_generation;
+            }
+
+            Work(thread);
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            if (--m_running == 0) {
+                m_finished.notify_one();
+            }
+        }
+    }
+
+public:
+    ThreadPool(
+        const std::size_t size)
+        : m_errors(std::max<std::size_t>(size, 1))
+        , m_invoke(nullptr)
+        , m_function(nullptr)
+        , m_count(0)
+        , m_generation(0)
+        , m_running(0)
+        , m_stop(false)
+    {
+        for (std::size_t thread = 1; thread < m_errors.size(); thread++) {
+            m_threads.emplace_back(&ThreadPool::Loop, this, thread);
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+
+    ThreadPool&
+    operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+
+        m_started.notify_all();
+
+        for (std::thread& thread : m_threads) {
+            thread.join();
+        }
+    }
+
+    // Number of threads including the calling thread
+    std::size_t
+    Size() const
+    {
+        return m_errors.size();
+    }
+
+    // Runs function(i) for every i in [0, count) and waits for all calls.
+    // The first exception thrown by any of the calls is rethrown. Runs must
+    // not be nested or issued concurrently.
+    template <typename TFunction>
+    void
+    Run(
+        const std::size_t count,
+        TFunction function)
+    {
+        for (std::exception_ptr& error : m_errors) {
+            error = nullptr;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            m_invoke = &Invoke<TFunction>;
+            m_function = &function;
+            m_count = count;
+            m_running = m_threads.size();
+            m_generation += 1;
+        }
+
+        m_started.notify_all();
+
+        Work(0);
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+
+            m_finished.wait(lock, [&]() {
+                return m_running == 0;
+            });
+        }
+
+        for (const std::exception_ptr& error : m_errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+    }
+}; // class ThreadPool
+
+// Runs the calls on the threads of a pool, or on new threads without one
+template <typename TFunction>
+static void
+ParallelFor(
+    ThreadPool* pool,
+    const std::size_t count,
+    TFunction function)
+{
+    if (pool == nullptr) {
+        ParallelFor(count, function);
+    } else {
+        pool->Run(count, function);
+    }
+}
+
+} // namespace MatrixMerchant
@@ -0,0 +1,473 @@
+#pragma once
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "MatrixMerchant.h"
+
+namespace MatrixMerchant {
+
+enum class PartitionStrategy
+{
+    // every rank owns the same number of consecutive rows
+    ContiguousRows,
+
+    // every rank owns consecutive rows with about the same number of entries
+    BalancedRows,
+
+    // the ranks own the rows given by PartitionOptions::owners
+    Owners
+};
+
+struct PartitionOptions
+{
+    PartitionStrategy strategy;
+
+    // Owning rank of every row for PartitionStrategy::Owners
+    std::vector<std::size_t> owners;
+
+    PartitionOptions()
+        : strategy(PartitionStrategy::ContiguousRows)
+    {
+    }
+
+    PartitionOptions(
+        const PartitionStrategy strategy)
+        : strategy(strategy)
+    {
+    }
+};
+
+// The rows of a matrix owned by one rank. The matrix holds the local rows
+// with all columns of the file.
+template <typename TMatrix>
+struct Partition
+{
+    TMatrix matrix;
+
+    // global index of every local row
+    std::vector<std::size_t> localToGlobal;
+
+    // local index of every global row, or the maximum value of std::size_t
+    // for rows owned by other ranks
+    std::vector<std::size_t> globalToLocal;
+};
+
+// Number of entries in every row of a file, counting both positions of
+// mirrored entries
+struct RowCounts
+{
+    std::vector<std::size_t> counts;
+};
+
+template <>
+struct MatrixBuilder<RowCounts>
+{
+    using ScalarType = bool;
+
+    RowCounts& m_matrix;
+
+    MatrixBuilder(
+        RowCounts& matrix)
+        : m_matrix(matrix)
+    {
+    }
+
+    void
+    BeginCoordinate(
+        const std::size_t& rows,
+        const std::size_t& /*cols*/,
+        const std::size_t& /*nonZeros*/)
+    {
+        m_matrix.counts.assign(rows, 0);
+    }
+
+    void
+    EndCoordinate()
+    {
+    }
+
+    void
+    BeginArray(
+        const std::size_t& rows,
+        const std::size_t& cols)
+    {
+        BeginCoordinate(rows, cols, rows * cols);
+    }
+
+    void
+    EndArray()
+    {
+    }
+
+    void
+    SetValue(
+        const std::size_t& row,
+        const std::size_t& /*col*/,
+        const ScalarType& /*value*/)
+    {
+        m_matrix.counts[row] += 1;
+    }
+};
+
+// Used as matrix type to read a file into the partitions of several ranks
+// at once. Every entry is passed to the builder of the rank owning its row.
+template <typename TMatrix>
+struct PartitionSet
+{
+    // the partition of every rank, or nullptr for ranks that are not read
+    std::vector<Partition<TMatrix>*> partitions;
+
+    std::vector<std::size_t> owners;
+    std::vector<std::size_t> localRows;
+};
+
+template <typename TMatrix>
+struct MatrixBuilder<PartitionSet<TMatrix>>
+{
+    using ScalarType = typename MatrixBuilder<TMatrix>::ScalarType;
+
+    PartitionSet<TMatrix>& m_matrix;
+
+    std::vector<MatrixBuilder<TMatrix>> m_builders;
+
+    // builder of every rank, or nullptr for ranks that are not read
+    std::vector<MatrixBuilder<TMatrix>*> m_slots;
+
+    MatrixBuilder(
+        PartitionSet<TMatrix>& matrix)
+        : m_matrix(matrix)
+        , m_slots(matrix.partitions.size(), nullptr)
+    {
+        m_builders.reserve(matrix.partitions.size());
+
+        for (std::size_t rank = 0; rank < matrix.partitions.size(); rank++) {
+            if (matrix.partitions[rank] != nullptr) {
+                m_builders.emplace_back(matrix.partitions[rank]->matrix);
+                m_slots[rank] = &m_builders.back();
+            }
+        }
+    }
+
+    // The entries of a rank arrive in any order, and the diagonal of a
+    // skew-symmetric array is not stored. The partitions are therefore
+    // always started as coordinate matrices.
+    void
+    BeginCoordinate(
+        const std::size_t& rows,
+        const std::size_t& cols,
+        const std::size_t& nonZeros)
+    {
+        for (std::size_t rank = 0; rank < m_slots.size(); rank++) {
+            if (m_slots[rank] == nullptr) {
+                continue;
+            }
+
+            const std::size_t localRows =
+                m_matrix.partitions[rank]->localToGlobal.size();
+
+            m_slots[rank]->BeginCoordinate(localRows, cols,
+                rows == 0 ? 0 : std::size_t(double(nonZeros) * localRows /
+                    rows) + 1);
+        }
+    }
+
+    void
+    EndCoordinate()
+    {
+        for (MatrixBuilder<TMatrix>& builder : m_builders) {
+            builder.EndCoordinate();
+        }
+    }
+
+    void
+    BeginArray(
+        const std::size_t& rows,
+        const std::size_t& cols)
+    {
+        BeginCoordinate(rows, cols, rows * cols);
+    }
+
+    void
+    EndArray()
+    {
+        EndCoordinate();
+    }
+
+    void
+    SetValue(
+        const std::size_t& row,
+        const std::size_t& col,
+        const ScalarType& value)
+    {
+        MatrixBuilder<TMatrix>* builder = m_slots[m_matrix.owners[row]];
+
+        if (builder != nullptr) {
+            builder->SetValue(m_matrix.localRows[row], col, value);
+        }
+    }
+};
+
+// Reads the rows of a file owned by one or all of several cooperating
+// ranks. Each rank receives its rows and the maps between local and global
+// row indices.
+class PartitionReader
+{
+private:
+    // Owning rank of every row
+    static std::vector<std::size_t>
+    RowOwners(
+        const std::string& filename,
+        const Header& header,
+        const std::size_t ranks,
+        const PartitionOptions& partitioning,
+        const ReadOptions& options)
+    {
+        const std::size_t rows = header.rows;
+
+        std::vector<std::size_t> owners(rows);
+
+        switch (partitioning.strategy) {
+        case PartitionStrategy::ContiguousRows:
+            for (std::size_t rank = 0; rank < ranks; rank++) {
+                std::fill(owners.begin() + rows * rank / ranks, owners.begin() +
+                    rows * (rank + 1) / ranks, rank);
+            }
+            break;
+        case PartitionStrategy::BalancedRows: {
+            // the entries per row are only known after a scan of the file
+
+            RowCounts rowCounts;
+
+            Reader::ReadFromFile(rowCounts, filename, RowOptions(options));
+
+            std::size_t total = 0;
+
+            for (const std::size_t count : rowCounts.counts) {
+                total += count;
+            }
+
+            std::size_t rank = 0;
+            std::size_t sum = 0;
+
+            for (std::size_t row = 0; row < rows; row++) {
+                owners[row] = rank;
+
+                sum += rowCounts.counts[row];
+
+                while (rank + 1 < ranks && double(sum) * ranks >=
+                        double(total) * (rank + 1)) {
+                    rank += 1;
+                }
+            }
+            break;
+        }
+        case PartitionStrategy::Owners:
+            if (partitioning.owners.size() != rows) {
+                throw std::runtime_error("Partition owners do not match the "
+                    "rows of the matrix");
+            }
+
+            for (const std::size_t owner : partitioning.owners) {
+                if (owner >= ranks) {
+                    throw std::runtime_error("Partition owner out of range");
+                }
+            }
+
+            owners = partitioning.owners;
+            break;
+        }
+
+        return owners;
+    }
+
+    // Local index of every row within the rows of its owner
+    static std::vector<std::size_t>
+    LocalRows(
+        const std::vector<std::size_t>& owners,
+        const std::size_t ranks)
+    {
+        std::vector<std::size_t> next(ranks, 0);
+        std::vector<std::size_t> localRows(owners.size());
+
+        for (std::size_t row = 0; row < owners.size(); row++) {
+            localRows[row] = next[owners[row]]++;
+        }
+
+        return localRows;
+    }
+
+    template <typename TMatrix>
+    static void
+    SetRows(
+        Partition<TMatrix>& partition,
+        const std::size_t rank,
+        const std::vector<std::size_t>& owners,
+        const std::vector<std::size_t>& localRows)
+    {
+        partition.localToGlobal.clear();
+        partition.globalToLocal.assign(owners.size(),
+            std::numeric_limits<std::size_t>::max());
+
+        for (std::size_t row = 0; row < owners.size(); row++) {
+            if (owners[row] == rank) {
+                partition.localToGlobal.push_back(row);
+                partition.globalToLocal[row] = localRows[row];
+            }
+        }
+    }
+
+    static void
+    CheckRanks(
+        const std::size_t ranks)
+    {
+        if (ranks == 0) {
+            throw std::runtime_error("Partition needs at least one rank");
+        }
+    }
+
+    static void
+    CheckRanks(
+        const std::size_t rank,
+        const std::size_t ranks)
+    {
+        CheckRanks(ranks);
+
+        if (rank >= ranks) {
+            throw std::runtime_error("Partition rank out of range");
+        }
+    }
+
+    static ReadOptions
+    RowOptions(
+        const ReadOptions& options)
+    {
+        ReadOptions rowOptions(options);
+
+        rowOptions.rowBegin = 0;
+        rowOptions.rowEnd = std::numeric_limits<std::size_t>::max();
+        rowOptions.colBegin = 0;
+        rowOptions.colEnd = std::numeric_limits<std::size_t>::max();
+        rowOptions.twoPass = false;
+        rowOptions.cache = false;
+
+        return rowOptions;
+    }
+
+public:
+    // Reads the rows of one rank. Consecutive rows are read as a block, so
+    // with ReadOptions::index only the part of the file holding them is
+    // parsed.
+    template <typename TMatrix>
+    static void
+    ReadPartition(
+        Partition<TMatrix>& partition,
+        const std::string& filename,
+        const std::size_t rank,
+        const std::size_t ranks,
+        const PartitionOptions& partitioning,
+        const ReadOptions& options)
+    {
+        CheckRanks(rank, ranks);
+
+        const Header header = Reader::ReadHeader(filename);
+
+        const std::vector<std::size_t> owners = RowOwners(filename, header,
+            ranks, partitioning, options);
+
+        const std::vector<std::size_t> localRows = LocalRows(owners, ranks);
+
+        SetRows(partition, rank, owners, localRows);
+
+        ReadOptions rowOptions = RowOptions(options);
+
+        if (partitioning.strategy != PartitionStrategy::Owners) {
+            const std::vector<std::size_t>& rows = partition.localToGlobal;
+
+            rowOptions.rowBegin = rows.empty() ? 0 : rows.front();
+            rowOptions.rowEnd = rows.empty() ? 0 : rows.back() + 1;
+            rowOptions.twoPass = options.twoPass;
+
+            Reader::ReadFromFile(partition.matrix, filename, rowOptions);
+
+            return;
+        }
+
+        PartitionSet<TMatrix> set;
+
+        set.partitions.assign(ranks, nullptr);
+        set.partitions[rank] = &partition;
+        set.owners = owners;
+        set.localRows = localRows;
+
+        Reader::ReadFromFile(set, filename, rowOptions);
+    }
+
+    template <typename TMatrix>
+    static void
+    ReadPartition(
+        Partition<TMatrix>& partition,
+        const std::string& filename,
+        const std::size_t rank,
+        const std::size_t ranks,
+        const PartitionOptions& partitioning)
+    {
+        ReadPartition(partition, filename, rank, ranks, partitioning,
+            ReadOptions());
+    }
+
+    // Reads the rows of all ranks in a single pass over the file. With
+    // several threads the body is split into byte ranges that are parsed
+    // concurrently. BalancedRows needs an additional pass to count the
+    // entries per row.
+    template <typename TMatrix>
+    static void
+    ReadPartitions(
+        std::vector<Partition<TMatrix>>& partitions,
+        const std::string& filename,
+        const std::size_t ranks,
+        const PartitionOptions& partitioning,
+        const ReadOptions& options)
+    {
+        CheckRanks(ranks);
+
+        const Header header = Reader::ReadHeader(filename);
+
+        const std::vector<std::size_t> owners = RowOwners(filename, header,
+            ranks, partitioning, options);
+
+        const std::vector<std::size_t> localRows = LocalRows(owners, ranks);
+
+        partitions.resize(ranks);
+
+        PartitionSet<TMatrix> set;
+
+        for (std::size_t rank = 0; rank < ranks; rank++) {
+            SetRows(partitions[rank], rank, owners, localRows);
+
+            set.partitions.push_back(&partitions[rank]);
+        }
+
+        set.owners = owners;
+        set.localRows = localRows;
+
+        Reader::ReadFromFile(set, filename, RowOptions(options));
+    }
+
+    template <typename TMatrix>
+    static void
+    ReadPartitions(
+        std::vector<Partition<TMatrix>>& partitions,
+        const std::string& filename,
+        const std::size_t ranks,
+        const PartitionOptions& partitioning)
+    {
+        ReadPartitions(partitions, filename, ranks, partitioning,
+            ReadOptions());
+    }
+}; // class PartitionReader
+
+} // namespace MatrixMerchant
@@ -0,0 +1,250 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "MatrixMerchant.h"
+
+namespace MatrixMerchant {
+
+// Structure of a sparse matrix without values in compressed row storage.
+// Only the indices are stored, which makes it suitable for large graphs
+// whose adjacency matrices are given as pattern files. A smaller index type
+// reduces the memory further.
+template <typename TIndex = std::size_t>
+struct SparsityPattern
+{
+    using IndexType = TIndex;
+
+    std::size_t rows;
+    std::size_t cols;
+
+    // rows + 1 offsets into colIndices
+    std::vector<TIndex> rowOffsets;
+
+    // column indices, sorted within each row
+    std::vector<TIndex> colIndices;
+
+    SparsityPattern()
+        : rows(0)
+        , cols(0)
+        , rowOffsets(1, 0)
+    {
+    }
+
+    std::size_t
+    NonZeros() const
+    {
+        return colIndices.size();
+    }
+
+    bool
+    Contains(
+        const std::size_t row,
+        const std::size_t col) const
+    {
+        const auto begin = colIndices.begin() + rowOffsets[row];
+        const auto end = colIndices.begin() + rowOffsets[row + 1];
+
+        return std::binary_search(begin, end, TIndex(col));
+    }
+};
+
+template <typename TIndex>
+struct MatrixBuilder<SparsityPattern<TIndex>>
+{
+    using MatrixType = SparsityPattern<TIndex>;
+
+    using ScalarType = bool;
+
+    using Assembly = PatternAssembly<TIndex>;
+
+    MatrixType& m_matrix;
+
+    // Row indices of the entries while reading in one pass. The column
+    // indices are collected in the matrix itself.
+    std::vector<TIndex> m_rows;
+
+    MatrixBuilder(
+        MatrixType& matrix)
+        : m_matrix(matrix)
+    {
+    }
+
+    void
+    BeginCoordinate(
+        const std::size_t& rows,
+        const std::size_t& cols,
+        const std::size_t& nonZeros)
+    {
+        m_matrix.rows = rows;
+        m_matrix.cols = cols;
+        m_matrix.rowOffsets.assign(rows + 1, 0);
+        m_matrix.colIndices.clear();
+        m_matrix.colIndices.reserve(nonZeros);
+
+        m_rows.clear();
+        m_rows.reserve(nonZeros);
+    }
+
+    void
+    EndCoordinate()
+    {
+        // bucket the entries by row in O(nnz)
+
+        for (const TIndex row : m_rows) {
+            Assembly::Count(m_matrix.rowOffsets.data(), row);
+        }
+
+        Assembly::CountsToOffsets(m_matrix.rowOffsets.data(), m_matrix.rows);
+
+        std::vector<TIndex> colIndices(m_rows.size());
+
+        for (std::size_t i = 0; i < m_rows.size(); i++) {
+            Assembly::Insert(m_matrix.rowOffsets.data(), colIndices.data(),
+                m_rows[i], m_matrix.colIndices[i]);
+        }
+
+        std::vector<TIndex>().swap(m_rows);
+
+        m_matrix.colIndices.swap(colIndices);
+
+        EndCompressed();
+    }
+
+    void
+    BeginArray(
+        const std::size_t& rows,
+        const std::size_t& cols)
+    {
+        BeginCoordinate(rows, cols, 0);
+    }
+
+    void
+    EndArray()
+    {
+        EndCoordinate();
+    }
+
+    void
+    SetValue(
+        const std::size_t& row,
+        const std::size_t& col,
+        const ScalarType& value)
+    {
+        if (!value) {
+            return;
+        }
+
+        m_rows.push_back(TIndex(row));
+        m_matrix.colIndices.push_back(TIndex(col));
+    }
+
+    // --- two-pass assembly directly into the compressed storage
+
+    void
+    BeginCompressed(
+        const std::size_t& rows,
+        const std::size_t& cols,
+        const std::size_t& /*nonZeros*/)
+    {
+        m_matrix.rows = rows;
+        m_matrix.cols = cols;
+        m_matrix.rowOffsets.assign(rows + 1, 0);
+        m_matrix.colIndices.clear();
+    }
+
+    void
+    CountEntry(
+        const std::size_t& row,
+        const std::size_t& /*col*/)
+    {
+        Assembly::Count(m_matrix.rowOffsets.data(), row);
+    }
+
+    void
+    EndCount()
+    {
+        Assembly::CountsToOffsets(m_matrix.rowOffsets.data(), m_matrix.rows);
+
+        m_matrix.colIndices.resize(m_matrix.rowOffsets[m_matrix.rows]);
+    }
+
+    void
+    FillEntry(
+        const std::size_t& row,
+        const std::size_t& col,
+        const ScalarType& /*value*/)
+    {
+        Assembly::Insert(m_matrix.rowOffsets.data(),
+            m_matrix.colIndices.data(), row, col);
+    }
+
+    void
+    EndCompressed()
+    {
+        const std::size_t nonZeros = Assembly::Finish(
+            m_matrix.rowOffsets.data(), m_matrix.colIndices.data(),
+            m_matrix.rows);
+
+        m_matrix.colIndices.resize(nonZeros);
+        m_matrix.colIndices.shrink_to_fit();
+    }
+
+    static inline bool
+    GetValue(
+        const MatrixType& matrix,
+        const std::size_t& row,
+        const std::size_t& col)
+    {
+        return matrix.Contains(row, col);
+    }
+
+    static inline std::size_t
+    Rows(
+        const MatrixType& matrix)
+    {
+        return matrix.rows;
+    }
+
+    static inline std::size_t
+    Cols(
+        const MatrixType& matrix)
+    {
+        return matrix.cols;
+    }
+
+    static inline std::size_t
+    NonZeros(
+        const MatrixType& matrix)
+    {
+        return matrix.NonZeros();
+    }
+
+    // --- iteration over the stored entries, row by row
+
+    static inline std::size_t
+    OuterSize(
+        const MatrixType& matrix)
+    {
+        return matrix.rows;
+    }
+
+    template <typename TFunction>
+    static void
+    ForEachNonZero(
+        const MatrixType& matrix,
+        const std::size_t outerBegin,
+        const std::size_t outerEnd,
+        TFunction function)
+    {
+        for (std::size_t row = outerBegin; row < outerEnd; row++) {
+            for (std::size_t i = matrix.rowOffsets[row];
+                 i < matrix.rowOffsets[row + 1]; i++) {
+                function(row, std::size_t(matrix.colIndices[i]), true);
+            }
+        }
+    }
+};
+
+} // namespace MatrixMerchant
@@ -0,0 +1,409 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+namespace MatrixMerchant {
+
+// Structure and value statistics of a matrix. Explicitly stored zeros are
+// only counted in explicitZeros and otherwise treated like entries that are
+// not stored, so array files describe their nonzero pattern.
+struct MatrixStatistics
+{
+    std::size_t rows;
+    std::size_t cols;
+
+    // number of nonzero entries after symmetric storage is expanded
+    std::size_t nonZeros;
+
+    std::size_t explicitZeros;
+
+    // nonzero entries in every row and column
+    std::vector<std::size_t> rowEntries;
+    std::vector<std::size_t> colEntries;
+
+    // Histograms of rowEntries and colEntries. Bin 0 counts the empty rows
+    // or columns, bin k > 0 the ones with [2^(k-1), 2^k) entries.
+    std::vector<std::size_t> rowHistogram;
+    std::vector<std::size_t> colHistogram;
+
+    std::size_t maxRowEntries;
+    std::size_t maxColEntries;
+
+    std::size_t emptyRows;
+    std::size_t emptyCols;
+
+    // largest row - col and col - row of any nonzero entry
+    std::size_t lowerBandwidth;
+    std::size_t upperBandwidth;
+
+    // sum over all rows of the distance between the first nonzero entry
+    // left of the diagonal and the diagonal
+    std::size_t profile;
+
+    // rows with |a_ii| >= or > the sum of |a_ij| over their other entries
+    std::size_t dominantRows;
+    std::size_t strictlyDominantRows;
+
+    // true if the matrix is square and every row is dominant
+    bool diagonallyDominant;
+
+    // Whether the pattern or the values equal the ones of the transpose.
+    // The entries are compared by sums of hashes, so a nonsymmetric matrix
+    // is reported as symmetric only with a probability of about 2^-64.
+    // Duplicate entries are compared one by one instead of summed.
+    bool structurallySymmetric;
+    bool numericallySymmetric;
+
+    // smallest and largest absolute value of the nonzero entries, 0 for a
+    // matrix without any
+    double minMagnitude;
+    double maxMagnitude;
+};
+
+// Collects MatrixStatistics from entries passed by several threads at once.
+// The per-row and per-column sums are shared by all threads and updated
+// atomically, so the collector holds about 4 rows + cols words for any
+// number of threads. Only the scalar statistics are kept per thread.
+template <typename TScalar>
+class StatisticsCollector
+{
+private:
+    struct ThreadState
+    {
+        std::size_t explicitZeros;
+        std::size_t lowerBandwidth;
+        std::size_t upperBandwidth;
+
+        double minMagnitude;
+        double maxMagnitude;
+
+        // hash sums of the entries above and below the diagonal, keyed by
+        // their position in the upper triangle
+        std::uint64_t upperPattern;
+        std::uint64_t lowerPattern;
+        std::uint64_t upperValues;
+        std::uint64_t lowerValues;
+
+        // keeps the states of different threads on different cache lines
+        char padding[64];
+    };
+
+    std::size_t m_rows;
+    std::size_t m_cols;
+
+    std::vector<std::atomic<std::size_t>> m_rowEntries;
+    std::vector<std::atomic<std::size_t>> m_colEntries;
+
+    // column of the first entry left of the diagonal, or the row itself
+    std::vector<std::atomic<std::size_t>> m_rowFirst;
+
+    // sum of the diagonal entries, the imaginary part only for complex
+    // values
+    std::vector<std::atomic<double>> m_diagonalReal;
+    std::vector<std::atomic<double>> m_diagonalImag;
+
+    std::vector<std::atomic<double>> m_offDiagonal;
+
+    std::vector<ThreadState> m_states;
+
+    static std::uint64_t
+    Mix(
+        std::uint64_t x)
+    {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ull;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebull;
+        x ^= x >> 31;
+
+        return x;
+    }
+
+    static std::uint64_t
+    ValueBits(
+        const double& value)
+    {
+        // -0 and +0 are equal values
+        const double normalized = value + 0.0;
+
+        std::uint64_t bits;
+        std::memcpy(&bits, &normalized, sizeof(bits));
+
+        return bits;
+    }
+
+    static std::uint64_t
+    ValueBits(
+        const std::complex<double>& value)
+    {
+        return Mix(ValueBits(value.real())) ^ ValueBits(value.imag());
+    }
+
+    static void
+    AtomicAdd(
+        std::atomic<double>& target,
+        const double value)
+    {
+        double current = target.load(std::memory_order_relaxed);
+
+        while (!target.compare_exchange_weak(current, current + value,
+            std::memory_order_relaxed)) {
+        }
+    }
+
+    static void
+    AtomicMin(
+        std::atomic<std::size_t>& target,
+        const std::size_t value)
+    {
+        std::size_t current = target.load(std::memory_order_relaxed);
+
+        while (value < current && !target.compare_exchange_weak(current,
+            value, std::memory_order_relaxed)) {
+        }
+    }
+
+    void
+    AddDiagonal(
+        const std::size_t row,
+        const double& value)
+    {
+        AtomicAdd(m_diagonalReal[row], value);
+    }
+
+    void
+    AddDiagonal(
+        const std::size_t row,
+        const std::complex<double>& value)
+    {
+        AtomicAdd(m_diagonalReal[row], value.real());
+        AtomicAdd(m_diagonalImag[row], value.imag());
+    }
+
+    static std::size_t
+    HistogramBin(
+        std::size_t count)
+    {
+        std::size_t bin = 0;
+
+        for (; count != 0; count >>= 1) {
+            bin += 1;
+        }
+
+        return bin;
+    }
+
+    static void
+    Histogram(
+        const std::vector<std::size_t>& counts,
+        std::vector<std::size_t>& histogram,
+        std::size_t& maxCount,
+        std::size_t& empty)
+    {
+        maxCount = 0;
+
+        for (const std::size_t count : counts) {
+            maxCount = std::max(maxCount, count);
+        }
+
+        histogram.assign(HistogramBin(maxCount) + 1, 0);
+
+        for (const std::size_t count : counts) {
+            histogram[HistogramBin(count)] += 1;
+        }
+
+        empty = histogram[0];
+    }
+
+    static std::vector<std::size_t>
+    Load(
+        const std::vector<std::atomic<std::size_t>>& values)
+    {
+        std::vector<std::size_t> loaded(values.size());
+
+        for (std::size_t i = 0; i < values.size(); i++) {
+            loaded[i] = values[i].load(std::memory_order_relaxed);
+        }
+
+        return loaded;
+    }
+
+public:
+    StatisticsCollector(
+        const std::size_t rows,
+        const std::size_t cols,
+        const std::size_t threads)
+        : m_rows(rows)
+        , m_cols(cols)
+        , m_rowEntries(rows)
+        , m_colEntries(cols)
+        , m_rowFirst(rows)
+        , m_diagonalReal(rows)
+        , m_diagonalImag(std::is_same<TScalar, std::complex<double>>::value ?
+            rows : 0)
+        , m_offDiagonal(rows)
+        , m_states(threads)
+    {
+        for (std::size_t row = 0; row < rows; row++) {
+            m_rowEntries[row].store(0, std::memory_order_relaxed);
+            m_rowFirst[row].store(row, std::memory_order_relaxed);
+            m_diagonalReal[row].store(0.0, std::memory_order_relaxed);
+            m_offDiagonal[row].store(0.0, std::memory_order_relaxed);
+        }
+
+        for (std::atomic<double>& value : m_diagonalImag) {
+            value.store(0.0, std::memory_order_relaxed);
+        }
+
+        for (std::atomic<std::size_t>& count : m_colEntries) {
+            count.store(0, std::memory_order_relaxed);
+        }
+
+        for (ThreadState& state : m_states) {
+            state.explicitZeros = 0;
+            state.lowerBandwidth = 0;
+            state.upperBandwidth = 0;
+            state.minMagnitude = std::numeric_limits<double>::infinity();
+            state.maxMagnitude = 0.0;
+            state.upperPattern = 0;
+            state.lowerPattern = 0;
+            state.upperValues = 0;
+            state.lowerValues = 0;
+        }
+    }
+
+    // Adds an entry. Calls for different threads may run concurrently.
+    void
+    Add(
+        const std::size_t thread,
+        const std::size_t row,
+        const std::size_t col,
+        const TScalar& value)
+    {
+        ThreadState& state = m_states[thread];
+
+        const double magnitude = std::abs(value);
+
+        if (magnitude == 0.0) {
+            state.explicitZeros += 1;
+            return;
+        }
+
+        m_rowEntries[row].fetch_add(1, std::memory_order_relaxed);
+        m_colEntries[col].fetch_add(1, std::memory_order_relaxed);
+
+        state.minMagnitude = std::min(state.minMagnitude, magnitude);
+        state.maxMagnitude = std::max(state.maxMagnitude, magnitude);
+
+        if (row == col) {
+            AddDiagonal(row, value);
+            return;
+        }
+
+        AtomicAdd(m_offDiagonal[row], magnitude);
+
+        const std::uint64_t position = Mix(Mix(std::min(row, col)) +
+            std::max(row, col));
+        const std::uint64_t entry = Mix(position + ValueBits(value));
+
+        if (row > col) {
+            state.lowerBandwidth = std::max(state.lowerBandwidth, row - col);
+            AtomicMin(m_rowFirst[row], col);
+            state.lowerPattern += position;
+            state.lowerValues += entry;
+        } else {
+            state.upperBandwidth = std::max(state.upperBandwidth, col - row);
+            state.upperPattern += position;
+            state.upperValues += entry;
+        }
+    }
+
+    // Combines the states of all threads once all entries are added
+    MatrixStatistics
+    Finish()
+    {
+        ThreadState total = m_states[0];
+
+        for (std::size_t i = 1; i < m_states.size(); i++) {
+            const ThreadState& state = m_states[i];
+
+            total.explicitZeros += state.explicitZeros;
+            total.lowerBandwidth = std::max(total.lowerBandwidth,
+                state.lowerBandwidth);
+            total.upperBandwidth = std::max(total.upperBandwidth,
+                state.upperBandwidth);
+            total.minMagnitude = std::min(total.minMagnitude,
+                state.minMagnitude);
+            total.maxMagnitude = std::max(total.maxMagnitude,
+                state.maxMagnitude);
+            total.upperPattern += state.upperPattern;
+            total.lowerPattern += state.lowerPattern;
+            total.upperValues += state.upperValues;
+            total.lowerValues += state.lowerValues;
+        }
+
+        MatrixStatistics stats;
+
+        stats.rows = m_rows;
+        stats.cols = m_cols;
+        stats.nonZeros = 0;
+        stats.explicitZeros = total.explicitZeros;
+        stats.rowEntries = Load(m_rowEntries);
+        stats.colEntries = Load(m_colEntries);
+        stats.lowerBandwidth = total.lowerBandwidth;
+        stats.upperBandwidth = total.upperBandwidth;
+        stats.profile = 0;
+        stats.dominantRows = 0;
+        stats.strictlyDominantRows = 0;
+
+        for (std::size_t row = 0; row < m_rows; row++) {
+            stats.nonZeros += stats.rowEntries[row];
+            stats.profile += row - m_rowFirst[row].load(
+                std::memory_order_relaxed);
+
+            const double diagonal = std::abs(std::complex<double>(
+                m_diagonalReal[row].load(std::memory_order_relaxed),
+                m_diagonalImag.empty() ? 0.0 :
+                    m_diagonalImag[row].load(std::memory_order_relaxed)));
+
+            const double offDiagonal = m_offDiagonal[row].load(
+                std::memory_order_relaxed);
+
+            if (diagonal >= offDiagonal) {
+                stats.dominantRows += 1;
+            }
+
+            if (diagonal > offDiagonal) {
+                stats.strictlyDominantRows += 1;
+            }
+        }
+
+        stats.diagonallyDominant = m_rows == m_cols &&
+            stats.dominantRows == m_rows;
+
+        stats.structurallySymmetric = m_rows == m_cols &&
+            total.upperPattern == total.lowerPattern;
+        stats.numericallySymmetric = stats.structurallySymmetric &&
+            total.upperValues == total.lowerValues;
+
+        stats.minMagnitude = stats.nonZeros != 0 ? total.minMagnitude : 0.0;
+        stats.maxMagnitude = total.maxMagnitude;
+
+        Histogram(stats.rowEntries, stats.rowHistogram, stats.maxRowEntries,
+            stats.emptyRows);
+        Histogram(stats.colEntries, stats.colHistogram, stats.maxColEntries,
+            stats.emptyCols);
+
+        return stats;
+    }
+}; // class StatisticsCollector
+
+} // namespace MatrixMerchant
@@ -0,0 +1,294 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "BinaryFormat.h"
+#include "MatrixMerchant.h"
+
+namespace MatrixMerchant {
+
+// Matrix-vector products computed while a file is read, for matrices that
+// do not fit into memory. The matrix is never assembled: every thread
+// accumulates the entries it parses into its own result vectors, which are
+// summed pairwise in a tree at the end. Text files are expanded like for a
+// read, binary files are traversed in place through their mapping. The
+// vectors can be any type with size(), resize() and operator[], e.g.
+// std::vector or Eigen::VectorXd.
+class StreamingProduct
+{
+private:
+    static bool
+    IsBinaryFile(
+        const std::string& filename)
+    {
+        std::ifstream file(filename.c_str(), std::ios::binary);
+
+        char magic[8] = {};
+
+        return file.read(magic, 8) && std::memcmp(magic, "MMBINARY", 8) == 0;
+    }
+
+    // Sums the buffers of all threads into the first one. On every level of
+    // the tree the pairs of buffers are added concurrently.
+    template <typename TScalar>
+    static void
+    Reduce(
+        std::vector<std::vector<TScalar>>& buffers)
+    {
+        for (std::size_t stride = 1; stride < buffers.size(); stride *= 2) {
+            const std::size_t pairs = (buffers.size() - stride + 2 * stride -
+                1) / (2 * stride);
+
+            ParallelFor(pairs, [&](const std::size_t pair) {
+                std::vector<TScalar>& target = buffers[2 * stride * pair];
+
+                const std::vector<TScalar>& source =
+                    buffers[2 * stride * pair + stride];
+
+                for (std::size_t i = 0; i < target.size(); i++) {
+                    target[i] += source[i];
+                }
+            });
+        }
+    }
+
+    // Passes the entries of the outer vectors of a sparse binary file to
+    // the threads in contiguous ranges
+    template <typename TScalar, typename TIndex, typename TFunction>
+    static void
+    ScanSparse(
+        const BinaryFile& file,
+        const std::size_t threads,
+        TFunction function)
+    {
+        const BinaryHeader& header = file.Header();
+
+        const TIndex* outer = file.OuterIndices<TIndex>();
+        const TIndex* inner = file.InnerIndices<TIndex>();
+        const TScalar* values = file.Values<TScalar>();
+
+        const bool rowMajor = file.IsRowMajor();
+
+        const std::uint64_t outerSize = header.OuterSize();
+        const std::uint64_t innerSize = rowMajor ? header.cols : header.rows;
+
+        ParallelFor(threads, [&](const std::size_t thread) {
+            const std::size_t outerBegin = outerSize * thread / threads;
+            const std::size_t outerEnd = outerSize * (thread + 1) / threads;
+
+            for (std::size_t i = outerBegin; i < outerEnd; i++) {
+                if (outer[i] < 0 || outer[i] > outer[i + 1] ||
+                    std::uint64_t(outer[i + 1]) > header.nonZeros) {
+                    throw std::runtime_error("Invalid binary file");
+                }
+
+                for (std::size_t j = outer[i]; j < std::size_t(outer[i + 1]);
+                     j++) {
+                    if (inner[j] < 0 || std::uint64_t(inner[j]) >= innerSize) {
+                        throw std::runtime_error("Invalid binary file");
+                    }
+
+                    const std::size_t k = std::size_t(inner[j]);
+
+                    function(thread, rowMajor ? i : k, rowMajor ? k : i,
+                        values[j]);
+                }
+            }
+        });
+    }
+
+    template <typename TScalar, typename TFunction>
+    static void
+    ScanDense(
+        const BinaryFile& file,
+        const std::size_t threads,
+        TFunction function)
+    {
+        const std::size_t rows = file.Rows();
+        const std::size_t cols = file.Cols();
+
+        const TScalar* values = file.Values<TScalar>();
+
+        ParallelFor(threads, [&](const std::size_t thread) {
+            for (std::size_t col = cols * thread / threads;
+                 col < cols * (thread + 1) / threads; col++) {
+                for (std::size_t row = 0; row < rows; row++) {
+                    function(thread, row, col, values[col * rows + row]);
+                }
+            }
+        });
+    }
+
+    // y = A x if x is given and yt = A^T xt if xt is given
+    template <typename TVector>
+    static void
+    Accumulate(
+        const std::string& filename,
+        const TVector* x,
+        TVector* y,
+        const TVector* xt,
+        TVector* yt,
+        const ReadOptions& options)
+    {
+        using ScalarType = typename TVector::value_type;
+
+        const std::size_t threads = ThreadCount(options.threads);
+
+        std::unique_ptr<BinaryFile> binary;
+
+        std::size_t rows;
+        std::size_t cols;
+
+        if (IsBinaryFile(filename)) {
+            binary.reset(new BinaryFile(filename));
+
+            rows = binary->Rows();
+            cols = binary->Cols();
+        } else {
+            const Header header = Reader::ReadHeader(filename);
+
+            rows = header.rows;
+            cols = header.cols;
+        }
+
+        if ((x != nullptr && std::size_t(x->size()) != cols) ||
+            (xt != nullptr && std::size_t(xt->size()) != rows)) {
+            throw std::runtime_error("Vector size does not match the matrix");
+        }
+
+        std::vector<std::vector<ScalarType>> ys(x != nullptr ? threads : 0,
+            std::vector<ScalarType>(rows, ScalarType(0)));
+        std::vector<std::vector<ScalarType>> yts(xt != nullptr ? threads : 0,
+            std::vector<ScalarType>(cols, ScalarType(0)));
+
+        auto accumulate = [&](const std::size_t thread, const std::size_t row,
+            const std::size_t col, const ScalarType& value) {
+            if (x != nullptr) {
+                ys[thread][row] += value * (*x)[col];
+            }
+
+            if (xt != nullptr) {
+                yts[thread][col] += value * (*xt)[row];
+            }
+        };
+
+        if (binary == nullptr) {
+            // the product always covers the whole matrix
+
+            ReadOptions productOptions(options);
+            productOptions.rowBegin = 0;
+            productOptions.rowEnd = std::numeric_limits<std::size_t>::max();
+            productOptions.colBegin = 0;
+            productOptions.colEnd = std::numeric_limits<std::size_t>::max();
+
+            Reader::ForEachEntryConcurrent<ScalarType>(filename, accumulate,
+                productOptions);
+        } else if (!binary->IsSparse()) {
+            ScanDense<ScalarType>(*binary, threads, accumulate);
+        } else if (binary->Header().indexSize == 4) {
+            ScanSparse<ScalarType, std::int32_t>(*binary, threads, accumulate);
+        } else {
+            ScanSparse<ScalarType, std::int64_t>(*binary, threads, accumulate);
+        }
+
+        if (x != nullptr) {
+            Reduce(ys);
+
+            y->resize(rows);
+
+            for (std::size_t i = 0; i < rows; i++) {
+                (*y)[i] = ys[0][i];
+            }
+        }
+
+        if (xt != nullptr) {
+            Reduce(yts);
+
+            yt->resize(cols);
+
+            for (std::size_t i = 0; i < cols; i++) {
+                (*yt)[i] = yts[0][i];
+            }
+        }
+    }
+
+public:
+    // y = A x
+    template <typename TVector>
+    static void
+    Multiply(
+        const std::string& filename,
+        const TVector& x,
+        TVector& y,
+        const ReadOptions& options)
+    {
+        Accumulate<TVector>(filename, &x, &y, nullptr, nullptr, options);
+    }
+
+    template <typename TVector>
+    static void
+    Multiply(
+        const std::string& filename,
+        const TVector& x,
+        TVector& y)
+    {
+        Multiply(filename, x, y, ReadOptions());
+    }
+
+    // y = A^T x
+    template <typename TVector>
+    static void
+    MultiplyTransposed(
+        const std::string& filename,
+        const TVector& x,
+        TVector& y,
+        const ReadOptions& options)
+    {
+        Accumulate<TVector>(filename, nullptr, nullptr, &x, &y, options);
+    }
+
+    template <typename TVector>
+    static void
+    MultiplyTransposed(
+        const std::string& filename,
+        const TVector& x,
+        TVector& y)
+    {
+        MultiplyTransposed(filename, x, y, ReadOptions());
+    }
+
+    // y = A x and yt = A^T xt in a single pass over the file
+    template <typename TVector>
+    static void
+    Multiply(
+        const std::string& filename,
+        const TVector& x,
+        TVector& y,
+        const TVector& xt,
+        TVector& yt,
+        const ReadOptions& options)
+    {
+        Accumulate<TVector>(filename, &x, &y, &xt, &yt, options);
+    }
+
+    template <typename TVector>
+    static void
+    Multiply(
+        const std::string& filename,
+        const TVector& x,
+        TVector& y,
+        const TVector& xt,
+        TVector& yt)
+    {
+        Multiply(filename, x, y, xt, yt, ReadOptions());
+    }
+}; // class StreamingProduct
+
+} // namespace MatrixMerchant
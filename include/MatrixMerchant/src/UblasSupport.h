@@ -3,6 +3,9 @@
 #include <boost/numeric/ublas/matrix.hpp>
 #include <boost/numeric/ublas/matrix_sparse.hpp>
 
+#include <algorithm>
+#include <vector>
+
 #include "MatrixMerchant.h"
 
 namespace MatrixMerchant {
@@ -28,7 +31,8 @@ struct MatrixBuilder<boost::numeric::ublas::matrix<TScalar>>
         const std::size_t& cols,
         const std::size_t& nonZeros)
     {
-        m_matrix.resize(rows, cols);
+        m_matrix.resize(rows, cols, false);
+        m_matrix.clear();
     }
 
     void
@@ -49,6 +53,13 @@ struct MatrixBuilder<boost::numeric::ublas::matrix<TScalar>>
     {
     }
 
+    void
+    MirrorTriangle(
+        const Symmetry symmetry)
+    {
+        MirrorLowerTriangle(m_matrix, m_matrix.size1(), symmetry);
+    }
+
     void
     SetValue(
         const std::size_t& row,
@@ -71,21 +82,21 @@ struct MatrixBuilder<boost::numeric::ublas::matrix<TScalar>>
     Rows(
         const MatrixType& matrix)
     {
-        return matrix.rows();
+        return matrix.size1();
     }
 
     static inline std::size_t
     Cols(
         const MatrixType& matrix)
     {
-        return matrix.cols();
+        return matrix.size2();
     }
 
     static inline std::size_t
     NonZeros(
         const MatrixType& matrix)
     {
-        return matrix.rows() * matrix.cols();
+        return matrix.size1() * matrix.size2();
     }
 };
 
@@ -167,9 +178,16 @@ struct MatrixBuilder<boost::numeric::ublas::compressed_matrix<TScalar>>
 
     MatrixType& m_matrix;
 
+    // Entries arriving in row-major order are appended in O(1). From the
+    // first out-of-order entry on, all entries are buffered and the matrix
+    // is rebuilt in sorted order at the end.
+    bool m_sorted;
+    std::vector<CoordTriplet<ScalarType>> m_buffer;
+
     MatrixBuilder(
         MatrixType& matrix)
         : m_matrix(matrix)
+        , m_sorted(true)
     {
     }
 
@@ -180,12 +198,20 @@ struct MatrixBuilder<boost::numeric::ublas::compressed_matrix<TScalar>>
         const std::size_t& nonZeros)
     {
         m_matrix.resize(rows, cols, false);
-        m_matrix.reserve(nonZeros);
+        m_matrix.reserve(nonZeros, false);
+
+        m_sorted = true;
+        m_buffer.clear();
     }
 
     void
     EndCoordinate()
     {
+        if (!m_sorted) {
+            Rebuild();
+        }
+
+        m_matrix.complete_index1_data();
     }
 
     void
@@ -193,12 +219,13 @@ struct MatrixBuilder<boost::numeric::ublas::compressed_matrix<TScalar>>
         const std::size_t& rows,
         const std::size_t& cols)
     {
-        m_matrix.resize(rows, cols);
+        BeginCoordinate(rows, cols, rows * cols);
     }
 
     void
     EndArray()
     {
+        EndCoordinate();
     }
 
     void
@@ -207,7 +234,146 @@ struct MatrixBuilder<boost::numeric::ublas::compressed_matrix<TScalar>>
         const std::size_t& col,
         const ScalarType& value)
     {
-        m_matrix.insert_element(row, col, value);
+        if (m_sorted && IsAppendable(row, col)) {
+            m_matrix.push_back(row, col, value);
+            return;
+        }
+
+        if (m_sorted) {
+            BeginBuffering();
+        }
+
+        m_buffer.push_back({row, col, value});
+    }
+
+    bool
+    IsAppendable(
+        const std::size_t& row,
+        const std::size_t& col) const
+    {
+        const std::size_t filled1 = m_matrix.filled1();
+        const std::size_t filled2 = m_matrix.filled2();
+
+        if (filled2 == 0) {
+            return true;
+        }
+
+        // the last entry lies in row filled1 - 2
+
+        const std::size_t lastRow = filled1 - 2;
+        const std::size_t lastCol = m_matrix.index2_data()[filled2 - 1];
+
+        return row > lastRow || (row == lastRow && col > lastCol);
+    }
+
+    void
+    BeginBuffering()
+    {
+        m_sorted = false;
+
+        m_buffer.reserve(m_matrix.nnz_capacity());
+
+        const std::size_t filled1 = m_matrix.filled1();
+
+        for (std::size_t row = 0; row + 1 < filled1; row++) {
+            for (std::size_t k = m_matrix.index1_data()[row];
+                 k < m_matrix.index1_data()[row + 1]; k++) {
+                m_buffer.push_back({row, m_matrix.index2_data()[k],
+                    m_matrix.value_data()[k]});
+            }
+        }
+    }
+
+    void
+    Rebuild()
+    {
+        std::stable_sort(m_buffer.begin(), m_buffer.end(),
+            [](const CoordTriplet<ScalarType>& a,
+                const CoordTriplet<ScalarType>& b) {
+                return a.row < b.row || (a.row == b.row && a.col < b.col);
+            });
+
+        m_matrix.reserve(m_buffer.size(), false);
+
+        for (std::size_t i = 0; i < m_buffer.size(); i++) {
+            ScalarType value = m_buffer[i].value;
+
+            while (i + 1 < m_buffer.size() &&
+                   m_buffer[i + 1].row == m_buffer[i].row &&
+                   m_buffer[i + 1].col == m_buffer[i].col) {
+                i += 1;
+                value += m_buffer[i].value;
+            }
+
+            m_matrix.push_back(m_buffer[i].row, m_buffer[i].col, value);
+        }
+
+        std::vector<CoordTriplet<ScalarType>>().swap(m_buffer);
+
+        m_sorted = true;
+    }
+
+    // --- two-pass assembly directly into the compressed storage
+
+    using Assembly = CompressedAssembly<std::size_t, ScalarType>;
+
+    void
+    BeginCompressed(
+        const std::size_t& rows,
+        const std::size_t& cols,
+        const std::size_t& /*nonZeros*/)
+    {
+        m_matrix.resize(rows, cols, false);
+        m_matrix.reserve(0, false);
+
+        std::fill(m_matrix.index1_data().begin(),
+            m_matrix.index1_data().end(), 0);
+    }
+
+    void
+    CountEntry(
+        const std::size_t& row,
+        const std::size_t& /*col*/)
+    {
+        Assembly::Count(&m_matrix.index1_data()[0], row);
+    }
+
+    void
+    EndCount()
+    {
+        const std::size_t rows = m_matrix.size1();
+
+        Assembly::CountsToOffsets(&m_matrix.index1_data()[0], rows);
+
+        const std::size_t nonZeros = m_matrix.index1_data()[rows];
+
+        // reserve resets the first offset, all others are kept
+
+        m_matrix.reserve(nonZeros, false);
+        m_matrix.index1_data()[0] = 0;
+    }
+
+    void
+    FillEntry(
+        const std::size_t& row,
+        const std::size_t& col,
+        const ScalarType& value)
+    {
+        Assembly::Insert(&m_matrix.index1_data()[0],
+            &m_matrix.index2_data()[0], &m_matrix.value_data()[0], row, col,
+            value);
+    }
+
+    void
+    EndCompressed()
+    {
+        const std::size_t rows = m_matrix.size1();
+
+        const std::size_t nonZeros = Assembly::Finish(
+            &m_matrix.index1_data()[0], &m_matrix.index2_data()[0],
+            &m_matrix.value_data()[0], rows);
+
+        m_matrix.set_filled(rows + 1, nonZeros);
     }
 
     static inline const ScalarType&
@@ -223,21 +389,55 @@ struct MatrixBuilder<boost::numeric::ublas::compressed_matrix<TScalar>>
     Rows(
         const MatrixType& matrix)
     {
-        return matrix.rows();
+        return matrix.size1();
     }
 
     static inline std::size_t
     Cols(
         const MatrixType& matrix)
     {
-        return matrix.cols();
+        return matrix.size2();
     }
 
     static inline std::size_t
     NonZeros(
         const MatrixType& matrix)
     {
-        return matrix.rows() * matrix.cols();
+        return matrix.nnz();
+    }
+
+    // --- iteration over the stored entries, row by row
+
+    static inline std::size_t
+    OuterSize(
+        const MatrixType& matrix)
+    {
+        return matrix.size1();
+    }
+
+    template <typename TFunction>
+    static void
+    ForEachNonZero(
+        const MatrixType& matrix,
+        const std::size_t outerBegin,
+        const std::size_t outerEnd,
+        TFunction function)
+    {
+        // offsets beyond the last filled row are not maintained by push_back
+
+        const std::size_t filled = matrix.filled1() - 1;
+
+        for (std::size_t row = outerBegin; row < outerEnd; row++) {
+            const std::size_t begin = matrix.index1_data()[
+                std::min(row, filled)];
+            const std::size_t end = matrix.index1_data()[
+                std::min(row + 1, filled)];
+
+            for (std::size_t i = begin; i < end; i++) {
+                function(row, std::size_t(matrix.index2_data()[i]),
+                    matrix.value_data()[i]);
+            }
+        }
     }
 };
 
@@ -0,0 +1,217 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// Replaces the global operators new and delete of the test program to count
+// its allocations. All forms are replaced, so every allocation is counted and
+// every pointer is released by the allocator it came from. The replacement
+// lives in a file of its own, because compilers warn about free() for
+// pointers of new-expressions in the same translation unit.
+
+static std::atomic<std::size_t> allocations(0);
+
+std::size_t
+AllocationCount()
+{
+    return allocations;
+}
+
+static void*
+Allocate(
+    const std::size_t size) noexcept
+{
+    allocations += 1;
+
+    return std::malloc(size != 0 ? size : 1);
+}
+
+void*
+operator new(
+    std::size_t size)
+{
+    void* pointer = Allocate(size);
+
+    if (pointer == nullptr) {
+        throw std::bad_alloc();
+    }
+
+    return pointer;
+}
+
+void*
+operator new[](
+    std::size_t size)
+{
+    return operator new(size);
+}
+
+void*
+operator new(
+    std::size_t size,
+    const std::nothrow_t&) noexcept
+{
+    return Allocate(size);
+}
+
+void*
+operator new[](
+    std::size_t size,
+    const std::nothrow_t&) noexcept
+{
+    return Allocate(size);
+}
+
+void
+operator delete(
+    void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void
+operator delete[](
+    void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void
+operator delete(
+    void* pointer,
+    const std::nothrow_t&) noexcept
+{
+    std::free(pointer);
+}
+
+void
+operator delete[](
+    void* pointer,
+    const std::nothrow_t&) noexcept
+{
+    std::free(pointer);
+}
+
+#if defined(__cpp_sized_deallocation)
+void
+operator delete(
+    void* pointer,
+    std::size_t /*size*/) noexcept
+{
+    std::free(pointer);
+}
+
+void
+operator delete[](
+    void* pointer,
+    std::size_t /*size*/) noexcept
+{
+    std::free(pointer);
+}
+#endif
+
+#if defined(__cpp_aligned_new)
+static void*
+AllocateAligned(
+    const std::size_t size,
+    const std::align_val_t alignment) noexcept
+{
+    const std::size_t bytes = std::size_t(alignment);
+
+    allocations += 1;
+
+    return std::aligned_alloc(bytes, (size + bytes) / bytes * bytes);
+}
+
+void*
+operator new(
+    std::size_t size,
+    std::align_val_t alignment)
+{
+    void* pointer = AllocateAligned(size, alignment);
+
+    if (pointer == nullptr) {
+        throw std::bad_alloc();
+    }
+
+    return pointer;
+}
+
+void*
+operator new[](
+    std::size_t size,
+    std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void*
+operator new(
+    std::size_t size,
+    std::align_val_t alignment,
+    const std::nothrow_t&) noexcept
+{
+    return AllocateAligned(size, alignment);
+}
+
+void*
+operator new[](
+    std::size_t size,
+    std::align_val_t alignment,
+    const std::nothrow_t&) noexcept
+{
+    return AllocateAligned(size, alignment);
+}
+
+void
+operator delete(
+    void* pointer,
+    std::align_val_t /*alignment*/) noexcept
+{
+    std::free(pointer);
+}
+
+void
+operator delete[](
+    void* pointer,
+    std::align_val_t /*alignment*/) noexcept
+{
+    std::free(pointer);
+}
+
+void
+operator delete(
+    void* pointer,
+    std::align_val_t /*alignment*/,
+    const std::nothrow_t&) noexcept
+{
+    std::free(pointer);
+}
+
+void
+operator delete[](
+    void* pointer,
+    std::align_val_t /*alignment*/,
+    const std::nothrow_t&) noexcept
+{
+    std::free(pointer);
+}
+
+void
+operator delete(
+    void* pointer,
+    std::size_t /*size*/,
+    std::align_val_t /*alignment*/) noexcept
+{
+    std::free(pointer);
+}
+
+void
+operator delete[](
+    void* pointer,
+    std::size_t /*size*/,
+    std::align_val_t /*alignment*/) noexcept
+{
+    std::free(pointer);
+}
+#endif
@@ -0,0 +1,78 @@
+#include "catch.hpp"
+
+#include <MatrixMerchant/Eigen>
+
+#include <Eigen/Core>
+
+#include "TestFiles.h"
+
+#include <cstddef>
+#include <vector>
+
+// Number of calls to operator new so far, see AllocationCounter.cc
+std::size_t
+AllocationCount();
+
+TEST_CASE("Allocation: Reader objects read dense matrices without allocating",
+    "[Allocation][Reader][Parallel]")
+{
+    using Reader = MatrixMerchant::Reader;
+
+    const int rows = 300;
+    const int cols = 200;
+
+    CoordinateBody body;
+
+    for (int col = 0; col < cols; col++) {
+        for (int row = col % 3; row < rows; row += 3) {
+            body.Add(row, col, (row - col) / 7.0);
+        }
+    }
+
+    const TemporaryFile file("Allocation.mtx", body.File(rows, cols));
+
+    const std::string array = "./data/array_real_general_3_4.mtx";
+
+    Eigen::MatrixXd expected;
+    Eigen::MatrixXd expectedArray;
+
+    Reader::ReadFromFile(expected, file.Path());
+    Reader::ReadFromFile(expectedArray, array);
+
+    for (const std::size_t threads : {1, 4}) {
+        MatrixMerchant::ReadOptions options;
+        options.threads = threads;
+
+        Reader reader(options);
+
+        Eigen::MatrixXd matrix(rows, cols);
+        Eigen::MatrixXd small(3, 4);
+
+        // the first reads size the buffers of the reader
+
+        reader.Read(matrix, file.Path());
+        reader.Read(small, array);
+
+        const std::size_t before = AllocationCount();
+
+        for (int i = 0; i < 3; i++) {
+            reader.Read(matrix, file.Path());
+            reader.Read(small, array);
+        }
+
+        const std::size_t after = AllocationCount();
+
+        REQUIRE( after == before );
+
+        REQUIRE( matrix == expected );
+        REQUIRE( small == expectedArray );
+    }
+
+    // the counter sees allocations of the test program
+
+    const std::size_t before = AllocationCount();
+
+    std::vector<double> vector(1);
+
+    REQUIRE( AllocationCount() == before + 1 );
+}
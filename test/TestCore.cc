@@ -0,0 +1,419 @@
+#include "catch.hpp"
+
+#include <MatrixMerchant/Core>
+
+#include "TestFiles.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+TEST_CASE("Core: Tokenize splits at whitespace",
+    "[Core][Tokenizer]")
+{
+    using MatrixMerchant::Tokens;
+
+    const std::string line = "  1\t2  -3.5E+00\r\n";
+
+    Tokens tokens;
+
+    MatrixMerchant::Tokenize(line.data(), line.data() + line.size(), tokens);
+
+    REQUIRE( tokens.Size() == 3 );
+
+    REQUIRE( tokens[0] == "1" );
+    REQUIRE( tokens[1] == "2" );
+    REQUIRE( tokens[2] == "-3.5E+00" );
+}
+
+TEST_CASE("Core: Tokenize counts tokens beyond capacity",
+    "[Core][Tokenizer]")
+{
+    using MatrixMerchant::Tokens;
+
+    const std::string line = "1 2 3 4 5 6 7 8 9 10";
+
+    Tokens tokens;
+
+    MatrixMerchant::Tokenize(line.data(), line.data() + line.size(), tokens);
+
+    REQUIRE( tokens.Size() == 10 );
+
+    REQUIRE( tokens[Tokens::Capacity - 1] == "8" );
+}
+
+template <typename TValue>
+static bool
+ParseAll(
+    const std::string& text,
+    TValue& value)
+{
+    const char* end = MatrixMerchant::NumberParser::Parse(text.data(),
+        text.data() + text.size(), value);
+
+    return end == text.data() + text.size();
+}
+
+TEST_CASE("Core: NumberParser integers",
+    "[Core][NumberParser]")
+{
+    std::size_t index;
+    int value;
+
+    REQUIRE( ParseAll("18446744073709551615", index) );
+    REQUIRE( index == 18446744073709551615ull );
+    REQUIRE( !ParseAll("18446744073709551616", index) );
+    REQUIRE( !ParseAll("-1", index) );
+
+    REQUIRE( ParseAll("-2147483648", value) );
+    REQUIRE( value == -2147483648ll );
+    REQUIRE( !ParseAll("2147483648", value) );
+    REQUIRE( !ParseAll("12a", value) );
+}
+
+TEST_CASE("Core: NumberParser doubles are correctly rounded",
+    "[Core][NumberParser]")
+{
+    const char* cases[] = {
+        "-1.7874030527951525",
+        "4.1845817867522186E+00",
+        "1e23",
+        "9007199254740993",
+        "2.2250738585072011e-308",
+        "4.9406564584124654e-324",
+        "2.4703282292062328e-324",
+        "1.7976931348623157e308",
+        "1.00000000000000011102230246251565404236316680908203125",
+        "1.00000000000000011102230246251565404236316680908203124",
+        "3.14159265358979323846264338327950288419716939937510582097494",
+        "123456789012345678901234567890e-10",
+        ".5",
+        "5.",
+        "1e400",
+    };
+
+    for (const char* text : cases) {
+        double value;
+
+        REQUIRE( ParseAll(text, value) );
+        REQUIRE( value == std::strtod(text, nullptr) );
+    }
+}
+
+TEST_CASE("Core: NumberParser floats are correctly rounded",
+    "[Core][NumberParser]")
+{
+    const char* cases[] = {
+        "-1.7874030527951525",
+        "3.4028235e38",
+        "1.4e-45",
+        "7.006492321624085e-46",
+        "1.00000005960464477539062500000000001",
+        "16777217",
+    };
+
+    for (const char* text : cases) {
+        float value;
+
+        REQUIRE( ParseAll(text, value) );
+        REQUIRE( value == std::strtof(text, nullptr) );
+    }
+}
+
+TEST_CASE("Core: NumberParser rejects malformed numbers",
+    "[Core][NumberParser]")
+{
+    double value;
+
+    REQUIRE( !ParseAll("-", value) );
+    REQUIRE( !ParseAll(".", value) );
+    REQUIRE( !ParseAll("1,5", value) );
+    REQUIRE( !ParseAll("1e", value) );
+    REQUIRE( !ParseAll("0x10", value) );
+}
+
+template <typename TValue>
+static std::string
+FormatToString(
+    const TValue value)
+{
+    char buffer[MatrixMerchant::NumberFormatter::MaxLength];
+
+    const char* end = MatrixMerchant::NumberFormatter::Format(buffer, value);
+
+    return std::string(buffer, end - buffer);
+}
+
+TEST_CASE("Core: NumberFormatter writes shortest representations",
+    "[Core][NumberFormatter]")
+{
+    REQUIRE( FormatToString(std::size_t(18446744073709551615ull)) ==
+        "18446744073709551615" );
+    REQUIRE( FormatToString(-2147483647 - 1) == "-2147483648" );
+
+    REQUIRE( FormatToString(0.0) == "0" );
+    REQUIRE( FormatToString(-0.0) == "-0" );
+    REQUIRE( FormatToString(0.1) == "0.1" );
+    REQUIRE( FormatToString(-2.0) == "-2" );
+    REQUIRE( FormatToString(0.0001) == "0.0001" );
+    REQUIRE( FormatToString(1e-5) == "1e-05" );
+    REQUIRE( FormatToString(1e16) == "10000000000000000" );
+    REQUIRE( FormatToString(1e17) == "1e+17" );
+    REQUIRE( FormatToString(5e-324) == "5e-324" );
+    REQUIRE( FormatToString(1.7976931348623157e308) ==
+        "1.7976931348623157e+308" );
+    REQUIRE( FormatToString(2.8017662727841071) == "2.801766272784107" );
+
+    REQUIRE( FormatToString(0.1f) == "0.1" );
+    REQUIRE( FormatToString(3.4028235e38f) == "3.4028235e+38" );
+}
+
+TEST_CASE("Core: NumberFormatter output reads back exactly",
+    "[Core][NumberFormatter]")
+{
+    std::uint64_t state = 0x9E3779B97F4A7C15ull;
+
+    for (int i = 0; i < 20000; i++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+
+        double value;
+
+        std::memcpy(&value, &state, sizeof(value));
+
+        if (value != value) {
+            continue;
+        }
+
+        double parsed;
+
+        REQUIRE( ParseAll(FormatToString(value), parsed) );
+        REQUIRE( parsed == value );
+
+        float single;
+        const std::uint32_t bits = std::uint32_t(state >> 32);
+
+        std::memcpy(&single, &bits, sizeof(single));
+
+        if (single != single) {
+            continue;
+        }
+
+        float parsedSingle;
+
+        REQUIRE( ParseAll(FormatToString(single), parsedSingle) );
+        REQUIRE( parsedSingle == single );
+    }
+}
+
+TEST_CASE("Core: Coordinate pattern general as SparsityPattern",
+    "[Core][Reader][Coordinate][Pattern][General]")
+{
+    using Pattern = MatrixMerchant::SparsityPattern<unsigned>;
+    using Reader = MatrixMerchant::Reader;
+
+    MatrixMerchant::ReadOptions twoPass;
+    twoPass.twoPass = true;
+
+    Pattern pattern;
+    Pattern compressed;
+
+    Reader::ReadFromFile(pattern, "./data/coordinate_pattern_general_3_4_5.mtx");
+    Reader::ReadFromFile(compressed,
+        "./data/coordinate_pattern_general_3_4_5.mtx", twoPass);
+
+    const std::vector<unsigned> rowOffsets = {0, 2, 3, 5};
+    const std::vector<unsigned> colIndices = {0, 1, 3, 0, 3};
+
+    REQUIRE( pattern.rows == 3 );
+    REQUIRE( pattern.cols == 4 );
+    REQUIRE( pattern.NonZeros() == 5 );
+    REQUIRE( pattern.rowOffsets == rowOffsets );
+    REQUIRE( pattern.colIndices == colIndices );
+
+    REQUIRE( compressed.rowOffsets == rowOffsets );
+    REQUIRE( compressed.colIndices == colIndices );
+
+    REQUIRE( pattern.Contains(2, 3) );
+    REQUIRE( !pattern.Contains(2, 2) );
+}
+
+TEST_CASE("Core: Structure of valued and symmetric files as SparsityPattern",
+    "[Core][Reader][Coordinate][Pattern][Symmetric]")
+{
+    using Pattern = MatrixMerchant::SparsityPattern<>;
+    using Reader = MatrixMerchant::Reader;
+
+    Pattern pattern;
+
+    Reader::ReadFromFile(pattern,
+        "./data/coordinate_real_general_unsorted_3_4_9.mtx");
+
+    REQUIRE( pattern.NonZeros() == 9 );
+
+    Reader::ReadFromFile(pattern,
+        "./data/coordinate_pattern_symmetric_3_3_3.mtx");
+
+    const std::vector<std::size_t> rowOffsets = {0, 2, 4, 5};
+    const std::vector<std::size_t> colIndices = {0, 1, 0, 2, 1};
+
+    REQUIRE( pattern.rowOffsets == rowOffsets );
+    REQUIRE( pattern.colIndices == colIndices );
+}
+
+TEST_CASE("Core: Pattern requires coordinate storage",
+    "[Core][Reader][Array][Pattern]")
+{
+    using Pattern = MatrixMerchant::SparsityPattern<>;
+    using Reader = MatrixMerchant::Reader;
+
+    std::stringstream input(
+        "%%MatrixMarket matrix array pattern general\n"
+        "1 1\n"
+        "1\n");
+
+    Pattern pattern;
+
+    REQUIRE_THROWS( Reader::ReadFromStream(pattern, input) );
+}
+
+TEST_CASE("Core: Write SparsityPattern as pattern file",
+    "[Core][Writer][Coordinate][Pattern][General]")
+{
+    using Pattern = MatrixMerchant::SparsityPattern<>;
+    using Reader = MatrixMerchant::Reader;
+    using Writer = MatrixMerchant::Writer;
+
+    Pattern pattern;
+
+    Reader::ReadFromFile(pattern, "./data/coordinate_pattern_general_3_4_5.mtx");
+
+    std::stringstream output;
+
+    Writer::WriteToStream(pattern, true, output);
+
+    const std::string expected =
+        "%%MatrixMarket matrix coordinate pattern general\n"
+        "%Created by the MatrixMerchant "
+        "https://github.com/oberbichler/MatrixMerchant\n"
+        "3 4 5\n"
+        "1 1\n"
+        "1 2\n"
+        "2 4\n"
+        "3 1\n"
+        "3 4\n";
+
+    REQUIRE( output.str() == expected );
+}
+
+TEST_CASE("Core: SparsityPattern in the binary format",
+    "[Core][Binary][Pattern]")
+{
+    using Pattern = MatrixMerchant::SparsityPattern<unsigned>;
+
+    const TemporaryFile file("Pattern.bin");
+
+    Pattern expected;
+
+    MatrixMerchant::Reader::ReadFromFile(expected,
+        "./data/coordinate_pattern_general_3_4_5.mtx");
+
+    MatrixMerchant::BinaryOptions options;
+    options.rowMajor = true;
+
+    MatrixMerchant::BinaryWriter::WriteToFile(expected, file.Path(), options);
+
+    Pattern actual;
+
+    MatrixMerchant::BinaryReader::ReadFromFile(actual, file.Path());
+
+    REQUIRE( actual.rows == 3 );
+    REQUIRE( actual.cols == 4 );
+    REQUIRE( actual.rowOffsets == expected.rowOffsets );
+    REQUIRE( actual.colIndices == expected.colIndices );
+
+    REQUIRE_THROWS( MatrixMerchant::BinaryFile(
+        "./data/coordinate_pattern_general_3_4_5.mtx") );
+}
+
+TEST_CASE("Core: Read only the header of files",
+    "[Core][Reader][Header]")
+{
+    using Reader = MatrixMerchant::Reader;
+
+    const MatrixMerchant::Header coordinate = Reader::ReadHeader(
+        "./data/coordinate_real_symmetric_3_3_4.mtx");
+
+    REQUIRE( coordinate.storage == "coordinate" );
+    REQUIRE( coordinate.type == "real" );
+    REQUIRE( coordinate.symmetry == "symmetric" );
+    REQUIRE( coordinate.rows == 3 );
+    REQUIRE( coordinate.cols == 3 );
+    REQUIRE( coordinate.nonZeros == 4 );
+
+    const MatrixMerchant::Header array = Reader::ReadHeader(
+        "./data/array_integer_general_3_4.mtx");
+
+    REQUIRE( array.storage == "array" );
+    REQUIRE( array.type == "integer" );
+    REQUIRE( array.rows == 3 );
+    REQUIRE( array.cols == 4 );
+
+    std::vector<std::string> filenames;
+
+    for (int i = 0; i < 50; i++) {
+        filenames.push_back(i % 2 == 0 ?
+            "./data/coordinate_pattern_general_3_4_5.mtx" :
+            "./data/array_complex_symmetric_3_3.mtx");
+    }
+
+    const std::vector<MatrixMerchant::Header> headers = Reader::ReadHeaders(
+        filenames, 4);
+
+    REQUIRE( headers.size() == 50 );
+    REQUIRE( headers[48].type == "pattern" );
+    REQUIRE( headers[48].nonZeros == 5 );
+    REQUIRE( headers[49].type == "complex" );
+    REQUIRE( headers[49].symmetry == "symmetric" );
+
+    filenames[17] = "./data/missing.mtx";
+
+    REQUIRE_THROWS( Reader::ReadHeaders(filenames) );
+}
+
+TEST_CASE("Core: ThreadPool runs every call and rethrows errors",
+    "[Core][Parallel]")
+{
+    MatrixMerchant::ThreadPool pool(4);
+
+    REQUIRE( pool.Size() == 4 );
+
+    for (int run = 0; run < 20; run++) {
+        std::vector<int> calls(3 + run % 9, 0);
+
+        pool.Run(calls.size(), [&](const std::size_t i) {
+            calls[i] += 1;
+        });
+
+        REQUIRE( calls == std::vector<int>(calls.size(), 1) );
+    }
+
+    REQUIRE_THROWS( pool.Run(6, [](const std::size_t i) {
+        if (i == 5) {
+            throw std::runtime_error("failed");
+        }
+    }) );
+
+    int total = 0;
+
+    pool.Run(1, [&](const std::size_t) {
+        total += 1;
+    });
+
+    REQUIRE( total == 1 );
+}
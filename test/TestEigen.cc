@@ -4,10 +4,19 @@
 
 #include <Eigen/Core>
 
+#include "TestFiles.h"
+
+#include <algorithm>
 #include <complex>
+#include <cstdint>
+#include <cstdio>
 #include <fstream>
+#include <iomanip>
+#include <limits>
 #include <sstream>
 #include <streambuf>
+#include <tuple>
+#include <vector>
 
 TEST_CASE("Eigen: Array real General as MatrixXd",
     "[Eigen][Reader][Array][Real][General][Double]")
@@ -225,3 +234,1697 @@ TEST_CASE("Eigen: Write MatrixXd"
 
     CHECK(act == exp);
 }
+
+TEST_CASE("Eigen: ReadFromStream matches ReadFromFile",
+    "[Eigen][Reader][Coordinate][Real][General]")
+{
+    using Matrix = Eigen::SparseMatrix<double>;
+    using Reader = MatrixMerchant::Reader;
+
+    std::ifstream file("./data/coordinate_real_general_3_4_9.mtx");
+    std::stringstream stream;
+    stream << file.rdbuf();
+
+    Matrix expected;
+    Matrix actual;
+
+    Reader::ReadFromFile(expected, "./data/coordinate_real_general_3_4_9.mtx");
+    Reader::ReadFromStream(actual, stream);
+
+    REQUIRE( actual.nonZeros() == expected.nonZeros() );
+    REQUIRE( Eigen::MatrixXd(actual) == Eigen::MatrixXd(expected) );
+}
+
+TEST_CASE("Eigen: Parallel read matches sequential read",
+    "[Eigen][Reader][Coordinate][Real][General][Parallel]")
+{
+    using Matrix = Eigen::SparseMatrix<double>;
+    using Reader = MatrixMerchant::Reader;
+
+    const int rows = 500;
+    const int cols = 400;
+
+    std::stringstream text;
+    text << std::setprecision(17);
+    text << "%%MatrixMarket matrix coordinate real general\n";
+    text << rows << " " << cols << " " << rows * cols / 4 << "\n";
+
+    for (int col = 0; col < cols; col++) {
+        for (int row = col % 4; row < rows; row += 4) {
+            text << row + 1 << " " << col + 1 << " " << (row - col) / 7.0
+                 << "\n";
+        }
+    }
+
+    std::stringstream sequentialInput(text.str());
+    std::stringstream parallelInput(text.str());
+
+    MatrixMerchant::ReadOptions options;
+    options.threads = 4;
+
+    Matrix sequential;
+    Matrix parallel;
+
+    Reader::ReadFromStream(sequential, sequentialInput);
+    Reader::ReadFromStream(parallel, parallelInput, options);
+
+    REQUIRE( parallel.nonZeros() == rows * cols / 4 );
+    REQUIRE( Eigen::MatrixXd(parallel) == Eigen::MatrixXd(sequential) );
+
+    Matrix file;
+
+    Reader::ReadFromFile(file, "./data/coordinate_real_general_3_4_9.mtx",
+        options);
+
+    REQUIRE( file.nonZeros() == 9 );
+    REQUIRE( file.coeff(2, 1) == -6.8545086364543906E-01 );
+}
+
+TEST_CASE("Eigen: Reader object reads many files",
+    "[Eigen][Reader][Parallel]")
+{
+    using Matrix = Eigen::SparseMatrix<double>;
+
+    const int rows = 500;
+    const int cols = 400;
+
+    CoordinateBody body;
+
+    for (int col = 0; col < cols; col++) {
+        for (int row = col % 4; row < rows; row += 4) {
+            body.Add(row, col, (row - col) / 7.0);
+        }
+    }
+
+    const std::string text = body.File(rows, cols);
+
+    const TemporaryFile file("Reader.mtx", text);
+
+    const std::string& path = file.Path();
+
+    MatrixMerchant::ReadOptions options;
+    options.threads = 4;
+
+    MatrixMerchant::Reader reader(options);
+
+    REQUIRE( reader.Options().threads == 4 );
+
+    Matrix expected;
+
+    MatrixMerchant::Reader::ReadFromFile(expected, path);
+
+    for (int i = 0; i < 3; i++) {
+        Matrix matrix;
+        Eigen::SparseMatrix<float> single;
+        Eigen::MatrixXd small;
+
+        reader.Read(matrix, path);
+        reader.Read(single, path);
+        reader.Read(small, "./data/array_real_general_3_4.mtx");
+
+        REQUIRE( Eigen::MatrixXd(matrix) == Eigen::MatrixXd(expected) );
+        REQUIRE( single.nonZeros() == expected.nonZeros() );
+        REQUIRE( small.rows() == 3 );
+
+        std::stringstream input(text);
+
+        reader.ReadStream(matrix, input);
+
+        REQUIRE( Eigen::MatrixXd(matrix) == Eigen::MatrixXd(expected) );
+    }
+
+    // the reader stays usable after a failed read
+
+    std::stringstream truncated(text.substr(0, text.size() / 2));
+
+    Matrix matrix;
+
+    REQUIRE_THROWS( reader.ReadStream(matrix, truncated) );
+
+    reader.Read(matrix, path);
+
+    REQUIRE( Eigen::MatrixXd(matrix) == Eigen::MatrixXd(expected) );
+}
+
+TEST_CASE("Eigen: Stream the entries of a file",
+    "[Eigen][Reader][Streaming]")
+{
+    using Reader = MatrixMerchant::Reader;
+    using Entry = MatrixMerchant::CoordTriplet<double>;
+
+    const int size = 300;
+
+    CoordinateBody body;
+
+    for (int col = 0; col < size; col++) {
+        for (int row = col; row < size; row++) {
+            body.Add(row, col, (row - col) / 7.0);
+        }
+    }
+
+    const TemporaryFile file("Streaming.mtx", body.File(size, size,
+        "symmetric"));
+
+    const std::string& path = file.Path();
+
+    Eigen::MatrixXd expected;
+
+    Reader::ReadFromFile(expected, path);
+
+    // sequential
+
+    std::vector<Entry> sequential;
+
+    Reader::ForEachEntry<double>(path, [&](const std::size_t row,
+        const std::size_t col, const double value) {
+        const Entry entry = {row, col, value};
+        sequential.push_back(entry);
+    });
+
+    REQUIRE( sequential.size() == std::size_t(size * size) );
+
+    Eigen::MatrixXd sum = Eigen::MatrixXd::Zero(size, size);
+
+    for (const Entry& entry : sequential) {
+        sum(entry.row, entry.col) += entry.value;
+    }
+
+    REQUIRE( sum == expected );
+
+    // several windows parsed by several threads deliver the same entries
+    // in the same order
+
+    MatrixMerchant::ReadOptions options;
+    options.threads = 4;
+    options.windowSize = 1 << 16;
+
+    std::vector<Entry> parallel;
+
+    Reader::ForEachEntry<double>(path, [&](const std::size_t row,
+        const std::size_t col, const double value) {
+        const Entry entry = {row, col, value};
+        parallel.push_back(entry);
+    }, options);
+
+    REQUIRE( parallel.size() == sequential.size() );
+
+    bool same = true;
+
+    for (std::size_t i = 0; i < parallel.size(); i++) {
+        same = same && parallel[i].row == sequential[i].row &&
+            parallel[i].col == sequential[i].col &&
+            parallel[i].value == sequential[i].value;
+    }
+
+    REQUIRE( same );
+
+    std::size_t count = 0;
+    std::size_t largest = 0;
+    sum.setZero();
+
+    Reader::ForEachBatch<double>(path, [&](
+        const MatrixMerchant::EntrySpan<double>& span) {
+        for (std::size_t i = 0; i < span.Size(); i++) {
+            sum(span[i].row, span[i].col) += span[i].value;
+        }
+
+        count += span.Size();
+        largest = std::max(largest, span.Size());
+    }, 1000, options);
+
+    REQUIRE( count == sequential.size() );
+    REQUIRE( largest == 1000 );
+    REQUIRE( sum == expected );
+
+    // blocks
+
+    options.rowBegin = 10;
+    options.rowEnd = 20;
+
+    sum = Eigen::MatrixXd::Zero(10, size);
+
+    Reader::ForEachEntry<double>(path, [&](const std::size_t row,
+        const std::size_t col, const double value) {
+        sum(row, col) += value;
+    }, options);
+
+    REQUIRE( sum == expected.middleRows(10, 10) );
+
+    // the header announces one more entry than the body holds
+
+    file.Write("%%MatrixMarket matrix coordinate real symmetric\n" +
+        std::to_string(size) + " " + std::to_string(size) + " " +
+        std::to_string(body.Count() + 1) + "\n" + body.Text());
+
+    options = MatrixMerchant::ReadOptions();
+    options.threads = 4;
+    options.windowSize = 1 << 16;
+
+    REQUIRE_THROWS( Reader::ForEachEntry<double>(path, [](
+        const std::size_t, const std::size_t, const double) {
+    }, options) );
+}
+
+TEST_CASE("Eigen: Unsorted coordinate entries as SparseMatrix",
+    "[Eigen][Reader][Coordinate][Real][General]")
+{
+    using Matrix = Eigen::SparseMatrix<double>;
+    using Reader = MatrixMerchant::Reader;
+
+    std::stringstream input(
+        "%%MatrixMarket matrix coordinate real general\n"
+        "3 4 5\n"
+        "3 4 5.0\n"
+        "1 2 2.0\n"
+        "3 1 3.0\n"
+        "2 4 4.0\n"
+        "1 1 1.0\n");
+
+    Matrix matrix;
+
+    Reader::ReadFromStream(matrix, input);
+
+    REQUIRE( matrix.nonZeros() == 5 );
+    REQUIRE( matrix.isCompressed() );
+
+    REQUIRE( matrix.coeff(0, 0) == 1.0 );
+    REQUIRE( matrix.coeff(0, 1) == 2.0 );
+    REQUIRE( matrix.coeff(2, 0) == 3.0 );
+    REQUIRE( matrix.coeff(1, 3) == 4.0 );
+    REQUIRE( matrix.coeff(2, 3) == 5.0 );
+}
+
+TEST_CASE("Eigen: Two-pass read as SparseMatrix",
+    "[Eigen][Reader][Coordinate][Real][General][TwoPass]")
+{
+    using Reader = MatrixMerchant::Reader;
+
+    MatrixMerchant::ReadOptions options;
+    options.twoPass = true;
+
+    Eigen::SparseMatrix<double> matrix;
+    Eigen::SparseMatrix<double, Eigen::RowMajor> rowMajor;
+
+    Reader::ReadFromFile(matrix,
+        "./data/coordinate_real_general_unsorted_3_4_9.mtx", options);
+    Reader::ReadFromFile(rowMajor,
+        "./data/coordinate_real_general_unsorted_3_4_9.mtx", options);
+
+    Eigen::SparseMatrix<double> expected;
+
+    Reader::ReadFromFile(expected, "./data/coordinate_real_general_3_4_9.mtx");
+
+    REQUIRE( matrix.isCompressed() );
+    REQUIRE( matrix.nonZeros() == 9 );
+    REQUIRE( rowMajor.nonZeros() == 9 );
+
+    REQUIRE( Eigen::MatrixXd(matrix) == Eigen::MatrixXd(expected) );
+    REQUIRE( Eigen::MatrixXd(rowMajor) == Eigen::MatrixXd(expected) );
+
+    for (int k = 0; k < matrix.outerSize(); k++) {
+        for (int i = matrix.outerIndexPtr()[k] + 1;
+             i < matrix.outerIndexPtr()[k + 1]; i++) {
+            REQUIRE( matrix.innerIndexPtr()[i - 1] <
+                matrix.innerIndexPtr()[i] );
+        }
+    }
+}
+
+TEST_CASE("Eigen: Refresh the values of a fixed pattern",
+    "[Eigen][Reader][Values]")
+{
+    using Matrix = Eigen::SparseMatrix<double>;
+    using Reader = MatrixMerchant::Reader;
+
+    const int size = 300;
+
+    const TemporaryFile file("Values.mtx");
+    const std::string& path = file.Path();
+
+    // writes a symmetric file with the values of a step, optionally in
+    // reverse order, with an additional or without the last entry
+
+    auto write = [&](const double step, const bool reverse, const int change) {
+        std::vector<std::tuple<int, int, double>> entries;
+
+        for (int col = 0; col < size; col++) {
+            for (int row = col; row < size; row += 1 + (row + col) % 9) {
+                entries.emplace_back(row, col, step + row / (col + 1.0));
+            }
+        }
+
+        if (change > 0) {
+            entries.emplace_back(1, 0, 1.0);
+            entries.emplace_back(0, 0, 1.0);
+        } else if (change < 0) {
+            entries.pop_back();
+        }
+
+        if (reverse) {
+            std::reverse(entries.begin(), entries.end());
+        }
+
+        CoordinateBody body;
+
+        for (const std::tuple<int, int, double>& entry : entries) {
+            body.Add(std::get<0>(entry), std::get<1>(entry),
+                std::get<2>(entry));
+        }
+
+        file.Write(body.File(size, size, "symmetric"));
+    };
+
+    write(1.0, false, 0);
+
+    Matrix matrix;
+    Matrix expected;
+
+    Reader::ReadFromFile(matrix, path);
+
+    const double* values = matrix.valuePtr();
+    const int* indices = matrix.innerIndexPtr();
+
+    MatrixMerchant::ValueSlots slots;
+
+    MatrixMerchant::ReadOptions options;
+    options.threads = 3;
+
+    for (int step = 2; step < 5; step++) {
+        write(step, step == 4, 0);
+
+        Reader::ReadFromFile(expected, path);
+        Reader::ReadValuesInto(matrix, path, slots, options);
+
+        REQUIRE( matrix.valuePtr() == values );
+        REQUIRE( matrix.innerIndexPtr() == indices );
+        REQUIRE( Eigen::MatrixXd(matrix) == Eigen::MatrixXd(expected) );
+        REQUIRE( slots.slots.size() == std::size_t(matrix.nonZeros()) );
+    }
+
+    // duplicate entries are summed
+
+    write(5.0, false, 1);
+
+    Reader::ReadFromFile(expected, path);
+    Reader::ReadValuesInto(matrix, path, slots);
+
+    REQUIRE( Eigen::MatrixXd(matrix) == Eigen::MatrixXd(expected) );
+
+    write(6.0, false, -1);
+
+    REQUIRE_THROWS( Reader::ReadValuesInto(matrix, path, slots) );
+    REQUIRE_THROWS( Reader::ReadValuesInto(matrix,
+        "./data/coordinate_real_general_unsorted_3_4_9.mtx") );
+
+    write(7.0, false, 0);
+
+    Reader::ReadFromFile(expected, path);
+    Reader::ReadValuesInto(matrix, path);
+
+    REQUIRE( Eigen::MatrixXd(matrix) == Eigen::MatrixXd(expected) );
+}
+
+TEST_CASE("Eigen: Array real symmetric as MatrixXd and SparseMatrix",
+    "[Eigen][Reader][Array][Real][Symmetric]")
+{
+    using Reader = MatrixMerchant::Reader;
+
+    Eigen::MatrixXd expected(3, 3);
+
+    expected << -5.8887776044934839, -6.5058302496506357, -3.7318643068148170,
+                -6.5058302496506357, -8.8589069109226806, -8.0462228609393414,
+                -3.7318643068148170, -8.0462228609393414,  2.6650512523087286;
+
+    Eigen::MatrixXd dense;
+    Eigen::SparseMatrix<double> sparse;
+
+    Reader::ReadFromFile(dense, "./data/array_real_symmetric_3_3.mtx");
+    Reader::ReadFromFile(sparse, "./data/array_real_symmetric_3_3.mtx");
+
+    REQUIRE( dense == expected );
+    REQUIRE( sparse.nonZeros() == 9 );
+    REQUIRE( Eigen::MatrixXd(sparse) == expected );
+}
+
+TEST_CASE("Eigen: Coordinate real symmetric and skew-symmetric",
+    "[Eigen][Reader][Coordinate][Real][Symmetric]")
+{
+    using Reader = MatrixMerchant::Reader;
+
+    Eigen::MatrixXd symmetric(3, 3);
+
+    symmetric << 1, 2, 3,
+                 2, 0, 0,
+                 3, 0, 4;
+
+    Eigen::MatrixXd skew(3, 3);
+
+    skew << 0, -2,  0,
+            2,  0,  5,
+            0, -5,  0;
+
+    MatrixMerchant::ReadOptions twoPass;
+    twoPass.twoPass = true;
+
+    Eigen::MatrixXd dense;
+    Eigen::SparseMatrix<double> sparse;
+    Eigen::SparseMatrix<double> compressed;
+
+    Reader::ReadFromFile(dense, "./data/coordinate_real_symmetric_3_3_4.mtx");
+    Reader::ReadFromFile(sparse, "./data/coordinate_real_symmetric_3_3_4.mtx");
+    Reader::ReadFromFile(compressed,
+        "./data/coordinate_real_symmetric_3_3_4.mtx", twoPass);
+
+    REQUIRE( dense == symmetric );
+    REQUIRE( sparse.nonZeros() == 6 );
+    REQUIRE( Eigen::MatrixXd(sparse) == symmetric );
+    REQUIRE( compressed.nonZeros() == 6 );
+    REQUIRE( Eigen::MatrixXd(compressed) == symmetric );
+
+    Reader::ReadFromFile(dense,
+        "./data/coordinate_real_skew-symmetric_3_3_2.mtx");
+    Reader::ReadFromFile(sparse,
+        "./data/coordinate_real_skew-symmetric_3_3_2.mtx");
+
+    REQUIRE( dense == skew );
+    REQUIRE( Eigen::MatrixXd(sparse) == skew );
+}
+
+TEST_CASE("Eigen: Read a block of rows and columns",
+    "[Eigen][Reader][Block]")
+{
+    using Reader = MatrixMerchant::Reader;
+
+    Eigen::MatrixXd full;
+    Eigen::MatrixXd dense;
+    Eigen::SparseMatrix<double> sparse;
+    Eigen::SparseMatrix<double> compressed;
+
+    MatrixMerchant::ReadOptions options;
+    options.rowBegin = 1;
+    options.colBegin = 1;
+    options.colEnd = 3;
+
+    MatrixMerchant::ReadOptions twoPass(options);
+    twoPass.twoPass = true;
+
+    Reader::ReadFromFile(full, "./data/coordinate_real_general_3_4_9.mtx");
+    Reader::ReadFromFile(dense, "./data/coordinate_real_general_3_4_9.mtx",
+        options);
+    Reader::ReadFromFile(sparse, "./data/coordinate_real_general_3_4_9.mtx",
+        options);
+    Reader::ReadFromFile(compressed,
+        "./data/coordinate_real_general_3_4_9.mtx", twoPass);
+
+    REQUIRE( dense == full.block(1, 1, 2, 2) );
+    REQUIRE( Eigen::MatrixXd(sparse) == full.block(1, 1, 2, 2) );
+    REQUIRE( Eigen::MatrixXd(compressed) == full.block(1, 1, 2, 2) );
+
+    // mirrored entries of symmetric storage
+
+    Reader::ReadFromFile(full, "./data/coordinate_real_symmetric_3_3_4.mtx");
+    Reader::ReadFromFile(sparse, "./data/coordinate_real_symmetric_3_3_4.mtx",
+        options);
+
+    REQUIRE( Eigen::MatrixXd(sparse) == full.block(1, 1, 2, 2) );
+
+    options.rowBegin = 0;
+    options.rowEnd = 1;
+    options.colBegin = 0;
+    options.colEnd = 3;
+
+    Reader::ReadFromFile(full,
+        "./data/coordinate_real_skew-symmetric_3_3_2.mtx");
+    Reader::ReadFromFile(dense,
+        "./data/coordinate_real_skew-symmetric_3_3_2.mtx", options);
+
+    REQUIRE( dense == full.block(0, 0, 1, 3) );
+
+    Reader::ReadFromFile(full, "./data/array_real_symmetric_3_3.mtx");
+    Reader::ReadFromFile(dense, "./data/array_real_symmetric_3_3.mtx",
+        options);
+
+    REQUIRE( dense == full.block(0, 0, 1, 3) );
+
+    // the parallel reader drops entries outside of the block while parsing
+
+    const int size = 500;
+
+    CoordinateBody body;
+
+    for (int col = 0; col < size; col++) {
+        for (int row = col + col % 4; row < size; row += 4) {
+            body.Add(row, col, (row - col) / 7.0);
+        }
+    }
+
+    const std::string header = body.Header(size, size, "symmetric");
+
+    std::stringstream fullInput(header + body.Text());
+    std::stringstream blockInput(header + body.Text());
+
+    options.threads = 4;
+    options.rowBegin = 100;
+    options.rowEnd = 220;
+    options.colBegin = 150;
+    options.colEnd = std::numeric_limits<std::size_t>::max();
+
+    Reader::ReadFromStream(full, fullInput);
+    Reader::ReadFromStream(sparse, blockInput, options);
+
+    REQUIRE( sparse.rows() == 120 );
+    REQUIRE( sparse.cols() == size - 150 );
+    REQUIRE( Eigen::MatrixXd(sparse) == full.block(100, 150, 120,
+        size - 150) );
+
+    std::stringstream truncated(header + body.Text().substr(0,
+        body.Text().size() / 2));
+
+    REQUIRE_THROWS( Reader::ReadFromStream(sparse, truncated, options) );
+
+    options.rowBegin = 2;
+    options.rowEnd = 1;
+
+    REQUIRE_THROWS( Reader::ReadFromFile(sparse,
+        "./data/coordinate_real_general_3_4_9.mtx", options) );
+}
+
+TEST_CASE("Eigen: Read the rows of several ranks",
+    "[Eigen][Reader][Partition]")
+{
+    using PartitionReader = MatrixMerchant::PartitionReader;
+    using PartitionStrategy = MatrixMerchant::PartitionStrategy;
+
+    const int size = 400;
+
+    CoordinateBody body;
+
+    // entries concentrate in the last rows, so balanced and contiguous
+    // partitions differ
+
+    for (int col = 0; col < size; col++) {
+        for (int row = col; row < size; row += 1 + (size - row) / 20) {
+            body.Add(row, col, (row + 2.0) / (col + 1));
+        }
+    }
+
+    const TemporaryFile file("Partition.mtx", body.File(size, size,
+        "symmetric"));
+
+    const std::string& path = file.Path();
+
+    Eigen::MatrixXd full;
+
+    MatrixMerchant::Reader::ReadFromFile(full, path);
+
+    const std::size_t ranks = 3;
+
+    MatrixMerchant::PartitionOptions owners(PartitionStrategy::Owners);
+
+    for (int row = 0; row < size; row++) {
+        owners.owners.push_back((row * 7) % ranks);
+    }
+
+    const std::vector<MatrixMerchant::PartitionOptions> strategies = {
+        PartitionStrategy::ContiguousRows, PartitionStrategy::BalancedRows,
+        owners};
+
+    MatrixMerchant::ReadOptions options;
+    options.threads = 4;
+
+    for (const MatrixMerchant::PartitionOptions& partitioning : strategies) {
+        std::vector<MatrixMerchant::Partition<Eigen::SparseMatrix<double>>>
+            partitions;
+
+        PartitionReader::ReadPartitions(partitions, path, ranks, partitioning,
+            options);
+
+        REQUIRE( partitions.size() == ranks );
+
+        std::vector<std::size_t> owned(size, 0);
+        std::vector<std::size_t> entries;
+
+        for (std::size_t rank = 0; rank < ranks; rank++) {
+            const auto& partition = partitions[rank];
+            const Eigen::MatrixXd local(partition.matrix);
+
+            REQUIRE( local.rows() == Eigen::Index(
+                partition.localToGlobal.size()) );
+            REQUIRE( local.cols() == size );
+
+            for (std::size_t i = 0; i < partition.localToGlobal.size(); i++) {
+                const std::size_t row = partition.localToGlobal[i];
+
+                REQUIRE( partition.globalToLocal[row] == i );
+                REQUIRE( local.row(i) == full.row(row) );
+
+                owned[row] += 1;
+            }
+
+            entries.push_back(partition.matrix.nonZeros());
+
+            // the same rows are read for a single rank
+
+            MatrixMerchant::Partition<Eigen::SparseMatrix<double>> single;
+
+            PartitionReader::ReadPartition(single, path, rank, ranks,
+                partitioning);
+
+            REQUIRE( single.localToGlobal == partition.localToGlobal );
+            REQUIRE( single.globalToLocal == partition.globalToLocal );
+            REQUIRE( Eigen::MatrixXd(single.matrix) == local );
+        }
+
+        REQUIRE( owned == std::vector<std::size_t>(size, 1) );
+
+        if (partitioning.strategy == PartitionStrategy::BalancedRows) {
+            const std::size_t total = entries[0] + entries[1] + entries[2];
+
+            for (const std::size_t count : entries) {
+                REQUIRE( count * ranks < total + total / 5 );
+            }
+        }
+
+        // a block in the options does not restrict the partitions
+
+        MatrixMerchant::ReadOptions blockOptions(options);
+        blockOptions.rowBegin = 10;
+        blockOptions.rowEnd = 20;
+        blockOptions.colBegin = 5;
+
+        std::vector<MatrixMerchant::Partition<Eigen::SparseMatrix<double>>>
+            blockPartitions;
+
+        PartitionReader::ReadPartitions(blockPartitions, path, ranks,
+            partitioning, blockOptions);
+
+        for (std::size_t rank = 0; rank < ranks; rank++) {
+            REQUIRE( blockPartitions[rank].localToGlobal ==
+                partitions[rank].localToGlobal );
+            REQUIRE( Eigen::MatrixXd(blockPartitions[rank].matrix) ==
+                Eigen::MatrixXd(partitions[rank].matrix) );
+        }
+    }
+
+    owners.owners.pop_back();
+
+    MatrixMerchant::Partition<Eigen::SparseMatrix<double>> partition;
+
+    REQUIRE_THROWS( PartitionReader::ReadPartition(partition, path, 0, ranks,
+        owners) );
+    REQUIRE_THROWS( PartitionReader::ReadPartition(partition, path, ranks,
+        ranks, PartitionStrategy::ContiguousRows) );
+
+    // there has to be at least one rank for every strategy
+
+    std::vector<MatrixMerchant::Partition<Eigen::SparseMatrix<double>>> none;
+
+    for (const MatrixMerchant::PartitionOptions& partitioning : strategies) {
+        REQUIRE_THROWS( PartitionReader::ReadPartitions(none, path, 0,
+            partitioning) );
+        REQUIRE_THROWS( PartitionReader::ReadPartition(partition, path, 0, 0,
+            partitioning) );
+    }
+}
+
+TEST_CASE("Eigen: Coordinate complex hermitian",
+    "[Eigen][Reader][Coordinate][Complex][Hermitian]")
+{
+    using Complex = std::complex<double>;
+    using Reader = MatrixMerchant::Reader;
+
+    Eigen::MatrixXcd expected(3, 3);
+
+    expected << Complex(1, 0), Complex(2, -3), Complex(0, 0),
+                Complex(2, 3), Complex(0, 0), Complex(-1, 2),
+                Complex(0, 0), Complex(-1, -2), Complex(0, 0);
+
+    Eigen::MatrixXcd dense;
+    Eigen::SparseMatrix<Complex> sparse;
+
+    Reader::ReadFromFile(dense, "./data/coordinate_complex_hermitian_3_3_3.mtx");
+    Reader::ReadFromFile(sparse,
+        "./data/coordinate_complex_hermitian_3_3_3.mtx");
+
+    REQUIRE( dense == expected );
+    REQUIRE( sparse.nonZeros() == 5 );
+    REQUIRE( Eigen::MatrixXcd(sparse) == expected );
+}
+
+TEST_CASE("Eigen: Coordinate pattern as SparseMatrix and MatrixXd",
+    "[Eigen][Reader][Coordinate][Pattern][General]")
+{
+    using Reader = MatrixMerchant::Reader;
+
+    Eigen::MatrixXd expected(3, 4);
+
+    expected << 1, 1, 0, 0,
+                0, 0, 0, 1,
+                1, 0, 0, 1;
+
+    MatrixMerchant::ReadOptions twoPass;
+    twoPass.twoPass = true;
+
+    Eigen::MatrixXd dense;
+    Eigen::SparseMatrix<double> sparse;
+    Eigen::SparseMatrix<double> compressed;
+    Eigen::SparseMatrix<bool> structure;
+
+    Reader::ReadFromFile(dense, "./data/coordinate_pattern_general_3_4_5.mtx");
+    Reader::ReadFromFile(sparse, "./data/coordinate_pattern_general_3_4_5.mtx");
+    Reader::ReadFromFile(compressed,
+        "./data/coordinate_pattern_general_3_4_5.mtx", twoPass);
+    Reader::ReadFromFile(structure,
+        "./data/coordinate_pattern_general_3_4_5.mtx");
+
+    REQUIRE( dense == expected );
+    REQUIRE( sparse.nonZeros() == 5 );
+    REQUIRE( Eigen::MatrixXd(sparse) == expected );
+    REQUIRE( Eigen::MatrixXd(compressed) == expected );
+    REQUIRE( structure.nonZeros() == 5 );
+    REQUIRE( structure.coeff(1, 3) );
+}
+
+#ifdef MATRIXMERCHANT_USE_ZLIB
+TEST_CASE("Eigen: Gzip compressed file as SparseMatrix",
+    "[Eigen][Reader][Coordinate][Real][General][Compressed]")
+{
+    using Matrix = Eigen::SparseMatrix<double>;
+    using Reader = MatrixMerchant::Reader;
+
+    Matrix expected;
+    Matrix actual;
+
+    Reader::ReadFromFile(expected, "./data/coordinate_real_general_3_4_9.mtx");
+    Reader::ReadFromFile(actual, "./data/coordinate_real_general_3_4_9.mtx.gz");
+
+    REQUIRE( actual.nonZeros() == 9 );
+    REQUIRE( Eigen::MatrixXd(actual) == Eigen::MatrixXd(expected) );
+}
+
+TEST_CASE("Eigen: Gzip compressed stream spanning several blocks",
+    "[Eigen][Reader][Coordinate][Real][General][Compressed]")
+{
+    using Matrix = Eigen::SparseMatrix<double>;
+    using Reader = MatrixMerchant::Reader;
+
+    const int rows = 1000;
+    const int cols = 800;
+
+    std::stringstream text;
+    text << std::setprecision(17);
+    text << "%%MatrixMarket matrix coordinate real general\n";
+    text << rows << " " << cols << " " << rows * cols / 4 << "\n";
+
+    for (int col = 0; col < cols; col++) {
+        for (int row = col % 4; row < rows; row += 4) {
+            text << row + 1 << " " << col + 1 << " " << (row - col) / 7.0
+                 << "\n";
+        }
+    }
+
+    const std::string plain = text.str();
+
+    // 15 + 16 writes a gzip header
+
+    z_stream stream = z_stream();
+
+    REQUIRE( deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16,
+        8, Z_DEFAULT_STRATEGY) == Z_OK );
+
+    std::string compressed(deflateBound(&stream, uLong(plain.size())), '\0');
+
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(plain.data()));
+    stream.avail_in = uInt(plain.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&compressed[0]);
+    stream.avail_out = uInt(compressed.size());
+
+    REQUIRE( deflate(&stream, Z_FINISH) == Z_STREAM_END );
+
+    compressed.resize(stream.total_out);
+
+    deflateEnd(&stream);
+
+    std::stringstream plainInput(plain);
+    std::stringstream compressedInput(compressed);
+
+    Matrix expected;
+    Matrix actual;
+
+    Reader::ReadFromStream(expected, plainInput);
+    Reader::ReadFromStream(actual, compressedInput);
+
+    REQUIRE( actual.nonZeros() == rows * cols / 4 );
+    REQUIRE( Eigen::MatrixXd(actual) == Eigen::MatrixXd(expected) );
+
+    std::stringstream truncatedInput(compressed.substr(0,
+        compressed.size() / 2));
+
+    REQUIRE_THROWS( Reader::ReadFromStream(actual, truncatedInput) );
+}
+#endif
+
+#ifdef MATRIXMERCHANT_USE_ZSTD
+TEST_CASE("Eigen: Zstd compressed file as SparseMatrix",
+    "[Eigen][Reader][Coordinate][Real][General][Compressed]")
+{
+    using Matrix = Eigen::SparseMatrix<double>;
+    using Reader = MatrixMerchant::Reader;
+
+    Matrix expected;
+    Matrix actual;
+
+    Reader::ReadFromFile(expected, "./data/coordinate_real_general_3_4_9.mtx");
+    Reader::ReadFromFile(actual,
+        "./data/coordinate_real_general_3_4_9.mtx.zst");
+
+    REQUIRE( actual.nonZeros() == 9 );
+    REQUIRE( Eigen::MatrixXd(actual) == Eigen::MatrixXd(expected) );
+}
+#endif
+
+TEST_CASE("Eigen: Write SparseMatrix writes stored entries only",
+    "[Eigen][Writer][Coordinate][Real][General]")
+{
+    using Matrix = Eigen::SparseMatrix<double>;
+    using Reader = MatrixMerchant::Reader;
+    using Writer = MatrixMerchant::Writer;
+
+    Matrix matrix(3, 4);
+
+    matrix.insert(0, 0) = 1.5;
+    matrix.insert(2, 0) = -2.0;
+    matrix.insert(1, 3) = 4.25;
+    matrix.makeCompressed();
+
+    std::stringstream output;
+
+    Writer::WriteToStream(matrix, true, output);
+
+    const std::string expected =
+        "%%MatrixMarket matrix coordinate real general\n"
+        "%Created by the MatrixMerchant "
+        "https://github.com/oberbichler/MatrixMerchant\n"
+        "3 4 3\n"
+        "1 1 1.5\n"
+        "3 1 -2\n"
+        "2 4 4.25\n";
+
+    REQUIRE( output.str() == expected );
+
+    Matrix actual;
+
+    Reader::ReadFromStream(actual, output);
+
+    REQUIRE( actual.nonZeros() == 3 );
+    REQUIRE( Eigen::MatrixXd(actual) == Eigen::MatrixXd(matrix) );
+}
+
+TEST_CASE("Eigen: Write matrices of other scalar types",
+    "[Eigen][Writer][Reader]")
+{
+    using Reader = MatrixMerchant::Reader;
+    using Writer = MatrixMerchant::Writer;
+
+    const std::string header =
+        "%Created by the MatrixMerchant "
+        "https://github.com/oberbichler/MatrixMerchant\n";
+
+    {
+        using Matrix = Eigen::Matrix<long, Eigen::Dynamic, Eigen::Dynamic>;
+
+        Matrix matrix(2, 2);
+
+        matrix << -9000000000l, 1, 0, 9223372036854775807l;
+
+        std::stringstream output;
+
+        Writer::WriteToStream(matrix, false, output);
+
+        REQUIRE( output.str() == "%%MatrixMarket matrix array integer "
+            "general\n" + header + "2 2\n-9000000000\n0\n1\n"
+            "9223372036854775807\n" );
+
+        Matrix actual;
+
+        Reader::ReadFromStream(actual, output);
+
+        REQUIRE( actual == matrix );
+    }
+
+    {
+        Eigen::SparseMatrix<unsigned> matrix(2, 3);
+
+        matrix.insert(1, 2) = 4294967295u;
+        matrix.makeCompressed();
+
+        std::stringstream output;
+
+        Writer::WriteToStream(matrix, true, output);
+
+        REQUIRE( output.str() == "%%MatrixMarket matrix coordinate integer "
+            "general\n" + header + "2 3 1\n2 3 4294967295\n" );
+    }
+
+    {
+        using Matrix = Eigen::Matrix<std::complex<float>, Eigen::Dynamic,
+            Eigen::Dynamic>;
+
+        Matrix matrix(1, 2);
+
+        matrix << std::complex<float>(0.1f, -2.5f),
+            std::complex<float>(3.4028235e38f, 1e-45f);
+
+        std::stringstream output;
+
+        Writer::WriteToStream(matrix, false, output);
+
+        REQUIRE( output.str() == "%%MatrixMarket matrix array complex "
+            "general\n" + header + "1 2\n0.1 -2.5\n3.4028235e+38 1e-45\n" );
+
+        Matrix actual;
+
+        Reader::ReadFromStream(actual, output);
+
+        REQUIRE( actual == matrix );
+    }
+
+    {
+        using Matrix = Eigen::Matrix<long double, Eigen::Dynamic,
+            Eigen::Dynamic>;
+
+        Matrix matrix(3, 1);
+
+        matrix << 1.0l / 3.0l, -std::numeric_limits<long double>::max(),
+            std::numeric_limits<long double>::denorm_min();
+
+        std::stringstream output;
+
+        Writer::WriteToStream(matrix, false, output);
+
+        Matrix actual;
+
+        Reader::ReadFromStream(actual, output);
+
+        REQUIRE( actual == matrix );
+    }
+}
+
+TEST_CASE("Eigen: WriteToFile and ReadFromFile round trip",
+    "[Eigen][Writer][Coordinate][Real][General]")
+{
+    using Matrix = Eigen::SparseMatrix<double>;
+    using Reader = MatrixMerchant::Reader;
+    using Writer = MatrixMerchant::Writer;
+
+    const int rows = 1000;
+    const int cols = 800;
+
+    // large enough to fill the output buffer several times
+
+    std::vector<Eigen::Triplet<double>> triplets;
+
+    for (int col = 0; col < cols; col++) {
+        for (int row = col % 4; row < rows; row += 4) {
+            triplets.emplace_back(row, col, (row - col) / 7.0);
+        }
+    }
+
+    Matrix expected(rows, cols);
+
+    expected.setFromTriplets(triplets.begin(), triplets.end());
+
+    const TemporaryFile file("WriteToFile.mtx");
+
+    Writer::WriteToFile(expected, file.Path());
+
+    std::ifstream written(file.Path());
+    std::stringstream fileContent;
+    fileContent << written.rdbuf();
+    written.close();
+
+    std::stringstream streamContent;
+
+    Writer::WriteToStream(expected, true, streamContent);
+
+    Matrix actual;
+
+    Reader::ReadFromFile(actual, file.Path());
+
+    REQUIRE( fileContent.str() == streamContent.str() );
+    REQUIRE( fileContent.str().size() > 4u << 20 );
+
+    REQUIRE( actual.nonZeros() == expected.nonZeros() );
+    REQUIRE( Eigen::MatrixXd(actual) == Eigen::MatrixXd(expected) );
+}
+
+#ifdef __linux__
+TEST_CASE("Eigen: WriteToFile reports a full disk",
+    "[Eigen][Writer][Coordinate][Real][General]")
+{
+    Eigen::SparseMatrix<double> matrix(3, 3);
+
+    matrix.insert(1, 2) = 1.5;
+
+    REQUIRE_THROWS_WITH( MatrixMerchant::Writer::WriteToFile(matrix,
+        "/dev/full"), "MatrixMarket write failed" );
+}
+#endif
+
+TEST_CASE("Eigen: Parallel writer matches the serial writer",
+    "[Eigen][Writer][Parallel]")
+{
+    using Writer = MatrixMerchant::Writer;
+
+    MatrixMerchant::WriteOptions options;
+    options.threads = 3;
+
+    // sparse matrix with rows of varying length
+
+    const int rows = 3000;
+    const int cols = 2000;
+
+    std::vector<Eigen::Triplet<double>> triplets;
+
+    for (int row = 0; row < rows; row++) {
+        for (int col = row % 7; col < cols; col += 1 + row % 13) {
+            triplets.emplace_back(row, col, (row + 1) / double(col + 3));
+        }
+    }
+
+    Eigen::SparseMatrix<double, Eigen::RowMajor> sparse(rows, cols);
+
+    sparse.setFromTriplets(triplets.begin(), triplets.end());
+
+    REQUIRE( sparse.nonZeros() > 1 << 19 );
+
+    std::stringstream sparseSerial;
+    std::stringstream sparseParallel;
+
+    Writer::WriteToStream(sparse, true, sparseSerial);
+    Writer::WriteToStream(sparse, true, sparseParallel, options);
+
+    REQUIRE( sparseSerial.str() == sparseParallel.str() );
+
+    // dense matrix in both formats
+
+    const Eigen::MatrixXd dense = Eigen::MatrixXd::Random(700, 800);
+
+    std::stringstream arraySerial;
+    std::stringstream arrayParallel;
+
+    Writer::WriteToStream(dense, false, arraySerial);
+    Writer::WriteToStream(dense, false, arrayParallel, options);
+
+    REQUIRE( arraySerial.str() == arrayParallel.str() );
+
+    std::stringstream coordinateSerial;
+    std::stringstream coordinateParallel;
+
+    Writer::WriteToStream(dense, true, coordinateSerial);
+    Writer::WriteToStream(dense, true, coordinateParallel, options);
+
+    REQUIRE( coordinateSerial.str() == coordinateParallel.str() );
+}
+
+TEST_CASE("Eigen: Chunk index written by the writer and the reader",
+    "[Eigen][Reader][Writer][Index]")
+{
+    using Reader = MatrixMerchant::Reader;
+    using Writer = MatrixMerchant::Writer;
+
+    const int rows = 3000;
+    const int cols = 2000;
+
+    std::vector<Eigen::Triplet<double>> triplets;
+
+    for (int row = 0; row < rows; row++) {
+        for (int col = row % 7; col < cols; col += 1 + row % 13) {
+            triplets.emplace_back(row, col, (row + 1) / double(col + 3));
+        }
+    }
+
+    Eigen::SparseMatrix<double, Eigen::RowMajor> expected(rows, cols);
+
+    expected.setFromTriplets(triplets.begin(), triplets.end());
+
+    const TemporaryFile file("Index.mtx");
+    const std::string& path = file.Path();
+    const std::string indexPath = path + ".index";
+
+    MatrixMerchant::WriteOptions writeOptions;
+    writeOptions.threads = 3;
+    writeOptions.index = true;
+    writeOptions.indexStride = 1000;
+
+    Writer::WriteToFile(expected, true, path, writeOptions);
+
+    REQUIRE( std::ifstream(indexPath).good() );
+
+    std::stringstream writtenIndex;
+    writtenIndex << std::ifstream(indexPath, std::ios::binary).rdbuf();
+
+    MatrixMerchant::ReadOptions options;
+    options.index = true;
+    options.rowBegin = 1000;
+    options.rowEnd = 1200;
+    options.colBegin = 500;
+
+    Eigen::SparseMatrix<double> block;
+
+    Reader::ReadFromFile(block, path, options);
+
+    REQUIRE( Eigen::MatrixXd(block) == Eigen::MatrixXd(expected.block(1000,
+        500, 200, cols - 500)) );
+
+    options.threads = 4;
+
+    Reader::ReadFromFile(block, path, options);
+
+    REQUIRE( Eigen::MatrixXd(block) == Eigen::MatrixXd(expected.block(1000,
+        500, 200, cols - 500)) );
+
+    MatrixMerchant::ReadOptions parallel;
+    parallel.index = true;
+    parallel.threads = 4;
+
+    Eigen::SparseMatrix<double> whole;
+
+    Reader::ReadFromFile(whole, path, parallel);
+
+    REQUIRE( whole.nonZeros() == expected.nonZeros() );
+    REQUIRE( Eigen::MatrixXd(whole) == Eigen::MatrixXd(expected) );
+
+    // the reader used the index of the writer instead of building its own
+
+    std::stringstream readIndex;
+    readIndex << std::ifstream(indexPath, std::ios::binary).rdbuf();
+
+    REQUIRE( readIndex.str() == writtenIndex.str() );
+
+    // a file rewritten with the same size but its entries in reverse order
+    // does not match the index anymore
+
+    {
+        std::ifstream written(path, std::ios::binary);
+
+        std::vector<std::string> lines;
+
+        for (std::string line; std::getline(written, line);) {
+            lines.push_back(line);
+        }
+
+        std::reverse(lines.begin() + 3, lines.end());
+
+        std::string content;
+
+        for (const std::string& line : lines) {
+            content += line + "\n";
+        }
+
+        file.Write(content);
+    }
+
+    Reader::ReadFromFile(block, path, options);
+
+    REQUIRE( Eigen::MatrixXd(block) == Eigen::MatrixXd(expected.block(1000,
+        500, 200, cols - 500)) );
+
+    // a missing index is built by the reader
+
+    std::remove(indexPath.c_str());
+
+    options.threads = 1;
+    options.rowBegin = 2990;
+    options.rowEnd = 3000;
+    options.colBegin = 0;
+
+    Reader::ReadFromFile(block, path, options);
+
+    REQUIRE( std::ifstream(indexPath).good() );
+    REQUIRE( Eigen::MatrixXd(block) == Eigen::MatrixXd(expected.block(2990,
+        0, 10, cols)) );
+
+    Reader::ReadFromFile(block, path, options);
+
+    REQUIRE( Eigen::MatrixXd(block) == Eigen::MatrixXd(expected.block(2990,
+        0, 10, cols)) );
+}
+
+TEST_CASE("Eigen: Read through the binary cache",
+    "[Eigen][Reader][Cache]")
+{
+    using Matrix = Eigen::SparseMatrix<double>;
+    using Reader = MatrixMerchant::Reader;
+    using Writer = MatrixMerchant::Writer;
+
+    const TemporaryFile file("Cache.mtx");
+    const std::string& path = file.Path();
+    const std::string cachePath = path + ".cache";
+
+    Matrix expected(5, 4);
+    expected.insert(0, 0) = 1.5;
+    expected.insert(4, 0) = -2;
+    expected.insert(1, 3) = 4.25;
+    expected.insert(3, 2) = 7;
+
+    Writer::WriteToFile(expected, path);
+
+    std::remove(cachePath.c_str());
+
+    MatrixMerchant::ReadOptions options;
+    options.cache = true;
+
+    // the first read creates the cache
+
+    Matrix first;
+
+    Reader::ReadFromFile(first, path, options);
+
+    REQUIRE( Eigen::MatrixXd(first) == Eigen::MatrixXd(expected) );
+    REQUIRE( std::ifstream(cachePath).good() );
+
+    // the second read takes the values from the cache. The last value in
+    // the cache is modified to tell both reads apart.
+
+    {
+        std::fstream cache(cachePath, std::ios::in | std::ios::out |
+            std::ios::binary);
+
+        const double value = 8;
+
+        cache.seekp(-8, std::ios::end);
+        cache.write(reinterpret_cast<const char*>(&value), sizeof(double));
+    }
+
+    Matrix second;
+
+    Reader::ReadFromFile(second, path, options);
+
+    REQUIRE( second.nonZeros() == 4 );
+    REQUIRE( second.coeff(4, 0) == 8 );
+
+    // a dense matrix does not match the sparse cache
+
+    Eigen::MatrixXd dense;
+
+    Reader::ReadFromFile(dense, path, options);
+
+    REQUIRE( dense == Eigen::MatrixXd(expected) );
+
+    // a changed file invalidates the cache
+
+    expected.coeffRef(0, 0) = 3;
+
+    Writer::WriteToFile(expected, path);
+
+    Matrix third;
+
+    Reader::ReadFromFile(third, path, options);
+
+    REQUIRE( Eigen::MatrixXd(third) == Eigen::MatrixXd(expected) );
+}
+
+TEST_CASE("Eigen: Binary format with zero-copy views",
+    "[Eigen][Binary]")
+{
+    using Matrix = Eigen::SparseMatrix<double>;
+
+    const TemporaryFile binary("Binary.bin");
+    const std::string& path = binary.Path();
+
+    Matrix expected(5, 4);
+    expected.insert(0, 0) = 1.5;
+    expected.insert(4, 0) = -2;
+    expected.insert(1, 3) = 4.25;
+    expected.insert(3, 2) = 7;
+    expected.makeCompressed();
+
+    // compressed column storage
+
+    MatrixMerchant::BinaryWriter::WriteToFile(expected, path);
+
+    {
+        const MatrixMerchant::BinaryFile file(path);
+
+        const auto view = MatrixMerchant::MapSparseMatrix<double>(file);
+
+        REQUIRE( view.nonZeros() == 4 );
+        REQUIRE( Eigen::MatrixXd(view) == Eigen::MatrixXd(expected) );
+
+        REQUIRE_THROWS( MatrixMerchant::MapSparseMatrix<float>(file) );
+        REQUIRE_THROWS( (MatrixMerchant::MapSparseMatrix<double,
+            Eigen::ColMajor, long long>(file)) );
+        REQUIRE_THROWS( (MatrixMerchant::MapSparseMatrix<double,
+            Eigen::RowMajor>(file)) );
+        REQUIRE_THROWS( MatrixMerchant::MapMatrix<double>(file) );
+
+        Matrix copy;
+
+        MatrixMerchant::BinaryReader::ReadFromFile(copy, path);
+
+        REQUIRE( Eigen::MatrixXd(copy) == Eigen::MatrixXd(expected) );
+
+        Eigen::MatrixXd dense;
+
+        MatrixMerchant::BinaryReader::ReadFromFile(dense, path);
+
+        REQUIRE( dense == Eigen::MatrixXd(expected) );
+    }
+
+    // compressed row storage with 64-bit indices
+
+    MatrixMerchant::BinaryOptions options;
+    options.rowMajor = true;
+    options.indexSize = 8;
+
+    MatrixMerchant::BinaryWriter::WriteToFile(expected, path, options);
+
+    {
+        const MatrixMerchant::BinaryFile file(path);
+
+        const auto view = MatrixMerchant::MapSparseMatrix<double,
+            Eigen::RowMajor, std::int64_t>(file);
+
+        REQUIRE( Eigen::MatrixXd(view) == Eigen::MatrixXd(expected) );
+
+        Matrix copy;
+
+        MatrixMerchant::BinaryReader::ReadFromFile(copy, path);
+
+        REQUIRE( Eigen::MatrixXd(copy) == Eigen::MatrixXd(expected) );
+    }
+
+    // indices that point past the mapping are rejected
+
+    std::uint64_t outerOffset;
+    std::uint64_t innerOffset;
+
+    {
+        const MatrixMerchant::BinaryFile file(path);
+
+        outerOffset = file.Header().outerOffset;
+        innerOffset = file.Header().innerOffset;
+    }
+
+    const std::int64_t invalid = 1 << 20;
+
+    for (const std::uint64_t offset : {outerOffset + 5 * 8, innerOffset}) {
+        MatrixMerchant::BinaryWriter::WriteToFile(expected, path, options);
+
+        {
+            std::fstream file(path, std::ios::in | std::ios::out |
+                std::ios::binary);
+
+            file.seekp(std::streamoff(offset));
+            file.write(reinterpret_cast<const char*>(&invalid), 8);
+        }
+
+        const MatrixMerchant::BinaryFile file(path);
+
+        REQUIRE_THROWS_WITH( (MatrixMerchant::MapSparseMatrix<double,
+            Eigen::RowMajor, std::int64_t>(file)), "Invalid binary file" );
+        REQUIRE_NOTHROW( (MatrixMerchant::MapSparseMatrixUnchecked<double,
+            Eigen::RowMajor, std::int64_t>(file)) );
+
+        Matrix copy;
+
+        REQUIRE_THROWS_WITH( MatrixMerchant::BinaryReader::ReadFromFile(copy,
+            path), "Invalid binary file" );
+    }
+
+    // dense matrix
+
+    const Eigen::MatrixXd dense = Eigen::MatrixXd::Random(7, 3);
+
+    MatrixMerchant::BinaryWriter::WriteToFile(dense, path);
+
+    {
+        const MatrixMerchant::BinaryFile file(path);
+
+        const auto view = MatrixMerchant::MapMatrix<double>(file);
+
+        REQUIRE( view == dense );
+        REQUIRE( std::uintptr_t(view.data()) % 64 == 0 );
+
+        REQUIRE_THROWS( MatrixMerchant::MapSparseMatrix<double>(file) );
+    }
+}
+
+TEST_CASE("Eigen: Streaming products from text and binary files",
+    "[Eigen][Reader][Streaming][Product]")
+{
+    using Product = MatrixMerchant::StreamingProduct;
+
+    const int size = 400;
+
+    CoordinateBody body;
+
+    for (int col = 0; col < size; col++) {
+        for (int row = col; row < size; row += 1 + (row + col) % 5) {
+            body.Add(row, col, (row * 3 + col) % 17 - 8);
+        }
+    }
+
+    const TemporaryFile file("Product.mtx");
+    const TemporaryFile binaryFile("Product.bin");
+
+    const std::string& path = file.Path();
+    const std::string& binaryPath = binaryFile.Path();
+
+    for (const char* symmetry : {"general", "symmetric", "skew-symmetric"}) {
+        file.Write(body.File(size, size, symmetry));
+
+        Eigen::SparseMatrix<double> matrix;
+
+        MatrixMerchant::Reader::ReadFromFile(matrix, path);
+
+        Eigen::VectorXd x(size);
+        Eigen::VectorXd xt(size);
+
+        for (int i = 0; i < size; i++) {
+            x[i] = i % 7 - 3;
+            xt[i] = i % 5 + 1;
+        }
+
+        const Eigen::VectorXd expected = matrix * x;
+        const Eigen::VectorXd expectedTransposed = matrix.transpose() * xt;
+
+        MatrixMerchant::ReadOptions options;
+        options.threads = 4;
+
+        Eigen::VectorXd y;
+        Eigen::VectorXd yt;
+
+        Product::Multiply(path, x, y, xt, yt, options);
+
+        REQUIRE( y == expected );
+        REQUIRE( yt == expectedTransposed );
+
+        std::vector<double> stdX(x.data(), x.data() + size);
+        std::vector<double> stdY;
+
+        Product::Multiply(path, stdX, stdY);
+
+        REQUIRE( Eigen::Map<Eigen::VectorXd>(stdY.data(), size) == expected );
+
+        Product::MultiplyTransposed(path, xt, yt, options);
+
+        REQUIRE( yt == expectedTransposed );
+
+        // binary files in compressed row and column storage
+
+        MatrixMerchant::BinaryOptions binaryOptions;
+
+        for (const bool rowMajor : {false, true}) {
+            binaryOptions.rowMajor = rowMajor;
+
+            MatrixMerchant::BinaryWriter::WriteToFile(matrix, binaryPath,
+                binaryOptions);
+
+            y.setZero();
+            yt.setZero();
+
+            Product::Multiply(binaryPath, x, y, xt, yt, options);
+
+            REQUIRE( y == expected );
+            REQUIRE( yt == expectedTransposed );
+        }
+    }
+
+    Eigen::VectorXd x(size + 1);
+    Eigen::VectorXd y;
+
+    REQUIRE_THROWS( Product::Multiply(path, x, y) );
+
+    // entries beyond the header cannot be ignored once they are consumed
+
+    file.Write("%%MatrixMarket matrix coordinate real general\n" +
+        std::to_string(size) + " " + std::to_string(size) + " " +
+        std::to_string(body.Count() - 1) + "\n" + body.Text());
+
+    x.resize(size);
+
+    REQUIRE_THROWS( Product::Multiply(path, x, y) );
+}
+
+
+TEST_CASE("Eigen: Analyze a file in a single pass",
+    "[Eigen][Reader][Streaming][Statistics]")
+{
+    using Reader = MatrixMerchant::Reader;
+
+    const int size = 300;
+
+    CoordinateBody body;
+
+    for (int col = 0; col < size; col++) {
+        for (int row = col; row < size; row += 1 + (row * col) % 7) {
+            body.Add(row, col, row == col ? 20 : (row * 3 + col) % 11 - 5);
+        }
+    }
+
+    const TemporaryFile file("Analyze.mtx");
+
+    for (const char* symmetry : {"general", "symmetric", "skew-symmetric"}) {
+        file.Write(body.File(size, size, symmetry));
+
+        Eigen::SparseMatrix<double> stored;
+
+        Reader::ReadFromFile(stored, file.Path());
+
+        const Eigen::SparseMatrix<double> matrix = stored.pruned();
+
+        const std::size_t explicitZeros = stored.nonZeros() -
+            matrix.nonZeros();
+        const Eigen::SparseMatrix<double> transposed = matrix.transpose();
+
+        std::vector<std::size_t> rowEntries(size, 0);
+        std::vector<std::size_t> colEntries(size, 0);
+        std::vector<double> offDiagonal(size, 0.0);
+        std::vector<int> rowFirst(size);
+
+        for (int row = 0; row < size; row++) {
+            rowFirst[row] = row;
+        }
+
+        std::size_t lowerBandwidth = 0;
+        std::size_t upperBandwidth = 0;
+        double minMagnitude = std::numeric_limits<double>::infinity();
+        double maxMagnitude = 0.0;
+
+        for (int k = 0; k < matrix.outerSize(); k++) {
+            for (Eigen::SparseMatrix<double>::InnerIterator it(matrix, k); it;
+                 ++it) {
+                const int row = int(it.row());
+                const int col = int(it.col());
+
+                rowEntries[row] += 1;
+                colEntries[col] += 1;
+
+                minMagnitude = std::min(minMagnitude, std::abs(it.value()));
+                maxMagnitude = std::max(maxMagnitude, std::abs(it.value()));
+
+                if (row != col) {
+                    offDiagonal[row] += std::abs(it.value());
+                }
+
+                if (row > col) {
+                    lowerBandwidth = std::max<std::size_t>(lowerBandwidth,
+                        row - col);
+                    rowFirst[row] = std::min(rowFirst[row], col);
+                } else {
+                    upperBandwidth = std::max<std::size_t>(upperBandwidth,
+                        col - row);
+                }
+            }
+        }
+
+        std::size_t profile = 0;
+        std::size_t dominantRows = 0;
+        std::size_t emptyRows = 0;
+
+        for (int row = 0; row < size; row++) {
+            profile += row - rowFirst[row];
+
+            if (std::abs(matrix.coeff(row, row)) >= offDiagonal[row]) {
+                dominantRows += 1;
+            }
+
+            if (rowEntries[row] == 0) {
+                emptyRows += 1;
+            }
+        }
+
+        Eigen::SparseMatrix<double> pattern = matrix;
+        Eigen::SparseMatrix<double> patternTransposed = transposed;
+
+        for (int k = 0; k < pattern.nonZeros(); k++) {
+            pattern.valuePtr()[k] = 1.0;
+            patternTransposed.valuePtr()[k] = 1.0;
+        }
+
+        for (const std::size_t threads : {1, 4}) {
+            MatrixMerchant::ReadOptions options;
+            options.threads = threads;
+
+            const MatrixMerchant::MatrixStatistics stats =
+                Reader::Analyze(file.Path(), options);
+
+            REQUIRE( stats.rows == std::size_t(size) );
+            REQUIRE( stats.cols == std::size_t(size) );
+            REQUIRE( stats.nonZeros == std::size_t(matrix.nonZeros()) );
+            REQUIRE( stats.explicitZeros == explicitZeros );
+            REQUIRE( stats.rowEntries == rowEntries );
+            REQUIRE( stats.colEntries == colEntries );
+            REQUIRE( stats.emptyRows == emptyRows );
+            REQUIRE( stats.maxRowEntries == *std::max_element(
+                rowEntries.begin(), rowEntries.end()) );
+            REQUIRE( stats.lowerBandwidth == lowerBandwidth );
+            REQUIRE( stats.upperBandwidth == upperBandwidth );
+            REQUIRE( stats.profile == profile );
+            REQUIRE( stats.dominantRows == dominantRows );
+            REQUIRE( stats.diagonallyDominant ==
+                (dominantRows == std::size_t(size)) );
+            REQUIRE( stats.minMagnitude == minMagnitude );
+            REQUIRE( stats.maxMagnitude == maxMagnitude );
+            REQUIRE( stats.structurallySymmetric ==
+                ((pattern - patternTransposed).norm() == 0) );
+            REQUIRE( stats.numericallySymmetric ==
+                ((matrix - transposed).norm() == 0) );
+
+            std::size_t histogramRows = 0;
+
+            for (const std::size_t count : stats.rowHistogram) {
+                histogramRows += count;
+            }
+
+            REQUIRE( histogramRows == std::size_t(size) );
+            REQUIRE( stats.rowHistogram[0] == emptyRows );
+        }
+    }
+
+    // a dense array with a nonsymmetric pattern
+
+    file.Write("%%MatrixMarket matrix array real general\n"
+        "3 2\n"
+        "4\n0\n-1\n0\n0\n2\n");
+
+    const MatrixMerchant::MatrixStatistics stats =
+        Reader::Analyze(file.Path());
+
+    REQUIRE( stats.nonZeros == 3 );
+    REQUIRE( stats.explicitZeros == 3 );
+    REQUIRE( stats.rowEntries == std::vector<std::size_t>({1, 0, 2}) );
+    REQUIRE( stats.colEntries == std::vector<std::size_t>({2, 1}) );
+    REQUIRE( stats.emptyRows == 1 );
+    REQUIRE( stats.emptyCols == 0 );
+    REQUIRE( stats.rowHistogram == std::vector<std::size_t>({1, 1, 1}) );
+    REQUIRE( stats.lowerBandwidth == 2 );
+    REQUIRE( stats.upperBandwidth == 0 );
+    REQUIRE( stats.profile == 2 );
+    REQUIRE( stats.minMagnitude == 1.0 );
+    REQUIRE( stats.maxMagnitude == 4.0 );
+    REQUIRE( !stats.structurallySymmetric );
+    REQUIRE( !stats.diagonallyDominant );
+}
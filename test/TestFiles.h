@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+// Body of a synthetic coordinate file. Entries are added with zero-based
+// indices, and values are written with enough digits to read back exactly.
+class CoordinateBody
+{
+private:
+    std::stringstream m_text;
+    std::size_t m_count;
+
+public:
+    CoordinateBody()
+        : m_count(0)
+    {
+        m_text << std::setprecision(17);
+    }
+
+    template <typename TValue>
+    void
+    Add(
+        const std::size_t row,
+        const std::size_t col,
+        const TValue& value)
+    {
+        m_text << row + 1 << " " << col + 1 << " " << value << "\n";
+        m_count += 1;
+    }
+
+    std::size_t
+    Count() const
+    {
+        return m_count;
+    }
+
+    std::string
+    Text() const
+    {
+        return m_text.str();
+    }
+
+    // Banner and size line for the entries added so far
+    std::string
+    Header(
+        const std::size_t rows,
+        const std::size_t cols,
+        const std::string& symmetry = "general",
+        const std::string& type = "real") const
+    {
+        std::stringstream header;
+        header << "%%MatrixMarket matrix coordinate " << type << " "
+               << symmetry << "\n";
+        header << rows << " " << cols << " " << m_count << "\n";
+
+        return header.str();
+    }
+
+    std::string
+    File(
+        const std::size_t rows,
+        const std::size_t cols,
+        const std::string& symmetry = "general",
+        const std::string& type = "real") const
+    {
+        return Header(rows, cols, symmetry, type) + Text();
+    }
+};
+
+// A file in the working directory. The file and the sidecars the readers
+// may have created next to it are removed when it goes out of scope, also
+// if a test fails.
+class TemporaryFile
+{
+private:
+    std::string m_path;
+
+public:
+    explicit TemporaryFile(
+        const std::string& name)
+        : m_path("./MatrixMerchant_" + name)
+    {
+    }
+
+    TemporaryFile(
+        const std::string& name,
+        const std::string& content)
+        : TemporaryFile(name)
+    {
+        Write(content);
+    }
+
+    TemporaryFile(const TemporaryFile&) = delete;
+
+    TemporaryFile&
+    operator=(const TemporaryFile&) = delete;
+
+    ~TemporaryFile()
+    {
+        for (const char* suffix : {"", ".index", ".cache"}) {
+            std::remove((m_path + suffix).c_str());
+        }
+    }
+
+    const std::string&
+    Path() const
+    {
+        return m_path;
+    }
+
+    // Replaces the content of the file
+    void
+    Write(
+        const std::string& content) const
+    {
+        std::ofstream file(m_path, std::ios::binary);
+        file << content;
+    }
+};
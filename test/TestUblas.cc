@@ -191,3 +191,162 @@ TEST_CASE("Ublas: Array complex General as compressed_matrix",
     REQUIRE( matrix(2, 1).ref().imag() == -8.3301296714039275E+00 );
     REQUIRE( matrix(2, 2).ref().imag() == -1.6652693449057949E+00 );
 }
+
+TEST_CASE("Ublas: Two-pass read as compressed_matrix",
+    "[Ublas][Reader][Coordinate][Real][General][TwoPass]")
+{
+    using Matrix = boost::numeric::ublas::compressed_matrix<double>;
+    using Reader = MatrixMerchant::Reader;
+
+    MatrixMerchant::ReadOptions options;
+    options.twoPass = true;
+
+    Matrix matrix;
+
+    Reader::ReadFromFile(matrix,
+        "./data/coordinate_real_general_unsorted_3_4_9.mtx", options);
+
+    REQUIRE( matrix.size1() == 3 );
+    REQUIRE( matrix.size2() == 4 );
+    REQUIRE( matrix.nnz() == 9 );
+
+    REQUIRE( matrix(0, 0) ==  4.1845817867522186E+00 );
+    REQUIRE( matrix(0, 2) == -2.0926889264634454E+00 );
+    REQUIRE( matrix(0, 3) == -7.8316889739440043E-01 );
+    REQUIRE( matrix(1, 0) ==  5.0906727488171413E+00 );
+    REQUIRE( matrix(1, 2) == -5.1864402160097285E+00 );
+    REQUIRE( matrix(1, 3) ==  2.0235820378239495E+00 );
+    REQUIRE( matrix(2, 0) ==  8.1418916746105481E+00 );
+    REQUIRE( matrix(2, 1) == -6.8545086364543906E-01 );
+    REQUIRE( matrix(2, 2) ==  3.2589429995407642E+00 );
+    REQUIRE( matrix(1, 1) ==  0.0 );
+}
+
+TEST_CASE("Ublas: Unsorted coordinate entries as compressed_matrix",
+    "[Ublas][Reader][Coordinate][Real][General]")
+{
+    using Matrix = boost::numeric::ublas::compressed_matrix<double>;
+    using Reader = MatrixMerchant::Reader;
+
+    Matrix sorted;
+    Matrix unsorted;
+
+    Reader::ReadFromFile(sorted, "./data/coordinate_real_general_3_4_9.mtx");
+    Reader::ReadFromFile(unsorted,
+        "./data/coordinate_real_general_unsorted_3_4_9.mtx");
+
+    REQUIRE( unsorted.nnz() == 9 );
+
+    for (std::size_t i = 0; i < 4; i++) {
+        REQUIRE( sorted.index1_data()[i] == unsorted.index1_data()[i] );
+    }
+
+    for (std::size_t i = 0; i < 9; i++) {
+        REQUIRE( sorted.index2_data()[i] == unsorted.index2_data()[i] );
+    }
+
+    for (std::size_t i = 0; i < 3; i++) {
+        for (std::size_t j = 0; j < 4; j++) {
+            REQUIRE( sorted(i, j) == unsorted(i, j) );
+        }
+    }
+}
+
+TEST_CASE("Ublas: Array real general as compressed_matrix",
+    "[Ublas][Reader][Array][Real][General]")
+{
+    using Matrix = boost::numeric::ublas::compressed_matrix<double>;
+    using Reader = MatrixMerchant::Reader;
+
+    Matrix matrix;
+
+    Reader::ReadFromFile(matrix, "./data/array_real_general_3_4.mtx");
+
+    REQUIRE( matrix.nnz() == 12 );
+
+    REQUIRE( matrix(0, 0) == -1.7874030527951525 );
+    REQUIRE( matrix(2, 0) == -7.3458785314655870 );
+    REQUIRE( matrix(1, 2) == -3.7799237041860287 );
+    REQUIRE( matrix(2, 3) ==  5.7081113423916179 );
+}
+
+TEST_CASE("Ublas: Array integer symmetric as ublas::matrix<int>",
+    "[Ublas][Reader][Array][Integer][Symmetric]")
+{
+    using Matrix = boost::numeric::ublas::matrix<int>;
+    using Reader = MatrixMerchant::Reader;
+
+    Matrix matrix;
+
+    Reader::ReadFromFile(matrix, "./data/array_integer_symmetric_3_3.mtx");
+
+    REQUIRE( matrix.size1() == 3 );
+    REQUIRE( matrix.size2() == 3 );
+
+    REQUIRE( matrix(0, 0) == -7 );
+    REQUIRE( matrix(1, 0) ==  0 );
+    REQUIRE( matrix(2, 0) == -4 );
+    REQUIRE( matrix(0, 1) ==  0 );
+    REQUIRE( matrix(1, 1) ==  8 );
+    REQUIRE( matrix(2, 1) == -2 );
+    REQUIRE( matrix(0, 2) == -4 );
+    REQUIRE( matrix(1, 2) == -2 );
+    REQUIRE( matrix(2, 2) ==  7 );
+}
+
+TEST_CASE("Ublas: Coordinate real symmetric as compressed_matrix",
+    "[Ublas][Reader][Coordinate][Real][Symmetric]")
+{
+    using Matrix = boost::numeric::ublas::compressed_matrix<double>;
+    using Reader = MatrixMerchant::Reader;
+
+    Matrix matrix;
+
+    Reader::ReadFromFile(matrix, "./data/coordinate_real_symmetric_3_3_4.mtx");
+
+    REQUIRE( matrix.nnz() == 6 );
+
+    REQUIRE( matrix(0, 0) == 1.0 );
+    REQUIRE( matrix(1, 0) == 2.0 );
+    REQUIRE( matrix(0, 1) == 2.0 );
+    REQUIRE( matrix(2, 0) == 3.0 );
+    REQUIRE( matrix(0, 2) == 3.0 );
+    REQUIRE( matrix(2, 2) == 4.0 );
+}
+
+TEST_CASE("Ublas: Write compressed_matrix writes stored entries only",
+    "[Ublas][Writer][Coordinate][Real][General]")
+{
+    using Matrix = boost::numeric::ublas::compressed_matrix<double>;
+    using Reader = MatrixMerchant::Reader;
+    using Writer = MatrixMerchant::Writer;
+
+    Matrix matrix(3, 4);
+
+    matrix.push_back(0, 0, 1.5);
+    matrix.push_back(0, 3, 4.25);
+    matrix.push_back(1, 1, -2.0);
+
+    std::stringstream output;
+
+    Writer::WriteToStream(matrix, true, output);
+
+    const std::string expected =
+        "%%MatrixMarket matrix coordinate real general\n"
+        "%Created by the MatrixMerchant "
+        "https://github.com/oberbichler/MatrixMerchant\n"
+        "3 4 3\n"
+        "1 1 1.5\n"
+        "1 4 4.25\n"
+        "2 2 -2\n";
+
+    REQUIRE( output.str() == expected );
+
+    Matrix actual;
+
+    Reader::ReadFromStream(actual, output);
+
+    REQUIRE( actual.nnz() == 3 );
+    REQUIRE( actual(0, 3) == 4.25 );
+    REQUIRE( actual(1, 1) == -2.0 );
+}